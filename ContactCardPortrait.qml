@@ -21,6 +21,8 @@ Image {
     property PeopleModel dataPeople : theModel
     property ProxyModel sortPeople : sortModel
     property int sourceIndex: sortPeople.getSourceRow(index)
+    //All roles the card shows, fetched in one call and keyed by role
+    property variant card: sortPeople.cardData(index)
     property string stringTruncater: qsTr("...")
 
     function getTruncatedString(valueStr, stringLen) {
@@ -35,16 +37,16 @@ Image {
     }
 
     function getOnlineStatus() {
-        if ((dataPeople.data(sourceIndex, PeopleModel.OnlineAccountUriRole).length < 1)
-                || (dataPeople.data(sourceIndex, PeopleModel.OnlineServiceProviderRole).length < 1))
+        if ((card[PeopleModel.OnlineAccountUriRole].length < 1)
+                || (card[PeopleModel.OnlineServiceProviderRole].length < 1))
             return "";
 
-        var account = dataPeople.data(sourceIndex, PeopleModel.OnlineServiceProviderRole)[0].split("\n");
+        var account = card[PeopleModel.OnlineServiceProviderRole][0].split("\n");
         if (account.length != 2)
             return "";
         account = account[1];
 
-        var buddy = dataPeople.data(sourceIndex, PeopleModel.OnlineAccountUriRole)[0].split(") ");
+        var buddy = card[PeopleModel.OnlineAccountUriRole][0].split(") ");
         if (buddy.length != 2)
             return "";
         buddy = buddy[1];
@@ -55,14 +57,14 @@ Image {
         return presence;
     }
 
-    property string dataFirst: dataPeople.data(sourceIndex, PeopleModel.FirstNameRole)
-    property string dataUuid: dataPeople.data(sourceIndex, PeopleModel.UuidRole);
-    property string dataLast:  dataPeople.data(sourceIndex, PeopleModel.LastNameRole)
-    property bool dataFavorite: dataPeople.data(sourceIndex, PeopleModel.FavoriteRole)
-    property int dataStatus: dataPeople.data(sourceIndex, PeopleModel.PresenceRole)
-    property bool dataMeCard: dataPeople.data(sourceIndex, PeopleModel.IsSelfRole)
+    property string dataFirst: card[PeopleModel.FirstNameRole]
+    property string dataUuid: card[PeopleModel.UuidRole];
+    property string dataLast:  card[PeopleModel.LastNameRole]
+    property bool dataFavorite: card[PeopleModel.FavoriteRole]
+    property int dataStatus: card[PeopleModel.PresenceRole]
+    property bool dataMeCard: card[PeopleModel.IsSelfRole]
     //REVISIT: Instead of using the URI from AvatarRole, need to use thumbnail URI
-    property string dataAvatar: dataPeople.data(sourceIndex, PeopleModel.AvatarRole)
+    property string dataAvatar: card[PeopleModel.AvatarRole]
 
     property string unfavoriteTranslated: qsTr("Unfavorite")
     property string favoriteTranslated: qsTr("Favorite")
@@ -76,7 +78,7 @@ Image {
     signal pressAndHold(int mouseX, int mouseY, string uuid, string name)
 
     source: "image://theme/contacts/contact_bg_portrait";
-    opacity: (dataPeople.data(sourceIndex, PeopleModel.IsSelfRole) ? .3 : 1)
+    opacity: (card[PeopleModel.IsSelfRole] ? .3 : 1)
 
     Image{
         id: photo
@@ -102,16 +104,16 @@ Image {
                 else
                     return qsTr("%1  %2").arg(getTruncatedString(dataFirst, 25)).arg(getTruncatedString(dataLast, 25));
             }
-            else if(dataPeople.data(sourceIndex, PeopleModel.CompanyNameRole) != "")
-                return getTruncatedString(dataPeople.data(sourceIndex, PeopleModel.CompanyNameRole), 25);
-            else if(dataPeople.data(sourceIndex, PeopleModel.PhoneNumberRole) != "")
-                return getTruncatedString(dataPeople.data(sourceIndex, PeopleModel.PhoneNumberRole), 25)[0];
-            else if(dataPeople.data(sourceIndex, PeopleModel.OnlineAccountUriRole)!= "")
-                return getTruncatedString(dataPeople.data(sourceIndex, PeopleModel.OnlineAccountUriRole), 25)[0];
-            else if (dataPeople.data(sourceIndex, PeopleModel.EmailAddressRole) != "")
-                return getTruncatedString(dataPeople.data(sourceIndex, PeopleModel.EmailAddressRole), 25)[0];
-            else if (dataPeople.data(sourceIndex, PeopleModel.WebUrlRole) != "")
-                return getTruncatedString(dataPeople.data(sourceIndex, PeopleModel.WebUrlRole), 25)[0];
+            else if(card[PeopleModel.CompanyNameRole] != "")
+                return getTruncatedString(card[PeopleModel.CompanyNameRole], 25);
+            else if(card[PeopleModel.PhoneNumberRole] != "")
+                return getTruncatedString(card[PeopleModel.PhoneNumberRole], 25)[0];
+            else if(card[PeopleModel.OnlineAccountUriRole]!= "")
+                return getTruncatedString(card[PeopleModel.OnlineAccountUriRole], 25)[0];
+            else if (card[PeopleModel.EmailAddressRole] != "")
+                return getTruncatedString(card[PeopleModel.EmailAddressRole], 25)[0];
+            else if (card[PeopleModel.WebUrlRole] != "")
+                return getTruncatedString(card[PeopleModel.WebUrlRole], 25)[0];
             else
                 return ellipse;
         }
@@ -130,7 +132,7 @@ Image {
 
     Image {
         id: favorite
-        source: (dataPeople.data(sourceIndex, PeopleModel.FavoriteRole) ? "image://theme/contacts/icn_fav_star_dn" : "image://theme/contacts/icn_fav_star" )
+        source: (card[PeopleModel.FavoriteRole] ? "image://theme/contacts/icn_fav_star_dn" : "image://theme/contacts/icn_fav_star" )
         opacity: (dataMeCard ? 0 : 1)
         anchors {right: contactCardPortrait.right; top: nameFirst.top; rightMargin: photo.height/8;}
     }
@@ -25,6 +25,7 @@ Flickable {
 
     property PeopleModel detailModel: contactModel
     property int index: personRow
+    property int detailsRevision: 0
 
     property string statusIdle: qsTr("Idle")
     property string statusBusy: qsTr("Busy")
@@ -83,6 +84,28 @@ Flickable {
     property string viewUrl: qsTr("View")
     property string stringTruncater: qsTr("...")
 
+    //Notes are only loaded on demand; reading them through detailData()
+    //re-evaluates the bindings once they arrive
+    function detailData(role) {
+        return (detailsRevision >= 0 ? detailModel.data(index, role) : undefined);
+    }
+
+    function openDetails() {
+        detailModel.loadDetails(index);
+        detailModel.setCurrentUuid(detailModel.data(index, PeopleModel.UuidRole));
+    }
+
+    Component.onCompleted: openDetails()
+    onIndexChanged: openDetails()
+
+    Connections {
+        target: detailModel
+        onDetailsLoaded: {
+            if (row == index)
+                detailsRevision++;
+        }
+    }
+
     function getTruncatedString(valueStr, stringLen) {
         var MAX_STR_LEN = stringLen;
         var multiline = (valueStr.indexOf("\n") == -1 ? false : true);
@@ -349,6 +372,15 @@ Flickable {
                         anchors {verticalCenter: phoneBar.verticalCenter; left: phoneBar.left; leftMargin: 145}
                         opacity: 1
                     }
+
+                    MouseArea{
+                        id: mouseArea_phone
+                        anchors.fill: parent
+                        onClicked: {
+                            var cmd = "/usr/bin/meego-qml-launcher --app meego-app-dialer --fullscreen --cmd dial --cdata \"" + modelData + "\"";
+                            detailModel.launch(cmd, PeopleModel.CallInteraction);
+                        }
+                    }
                 }
             }
         }
@@ -477,6 +509,15 @@ Flickable {
                         anchors {verticalCenter: emailBar.verticalCenter; left: emailBar.left; leftMargin: 110 }
                         opacity: 1
                     }
+
+                    MouseArea{
+                        id: mouseArea_email
+                        anchors.fill: parent
+                        onClicked: {
+                            var cmd = "/usr/bin/meego-qml-launcher --app meego-app-email --fullscreen --cmd openComposer --cdata \"mailto:" + modelData + "\"";
+                            detailModel.launch(cmd, PeopleModel.EmailInteraction);
+                        }
+                    }
                 }
             }
         }
@@ -561,7 +602,7 @@ Flickable {
             id: addressHeader
             width: parent.width
             height: 70
-            opacity: (detailModel.data(index, PeopleModel.AddressRole).length > 0 ? 1: 0)
+            opacity: (detailData(PeopleModel.AddressRole).length > 0 ? 1: 0)
 
             Text{
                 id: label_address
@@ -577,8 +618,8 @@ Flickable {
             id: detailsAddress
             width: parent.width
             opacity: addressHeader.opacity
-            model: detailModel.data(index, PeopleModel.AddressRole)
-            property variant addressContexts: detailModel.data(index, PeopleModel.AddressContextRole)
+            model: detailData(PeopleModel.AddressRole)
+            property variant addressContexts: detailData(PeopleModel.AddressContextRole)
             Item{
                 id: delegateaddy
                 width: parent.width
@@ -639,7 +680,7 @@ Flickable {
             id: birthdayHeader
             width: parent.width
             height: 70
-            opacity: (detailModel.data(index, PeopleModel.BirthdayRole).length > 0 ? 1: 0)
+            opacity: (detailData(PeopleModel.BirthdayRole).length > 0 ? 1: 0)
 
             Text{
                 id: label_birthday
@@ -673,7 +714,7 @@ Flickable {
                 }
                 Text{
                     id: data_birthday
-                    text: detailModel.data(index, PeopleModel.BirthdayRole)
+                    text: detailData(PeopleModel.BirthdayRole)
                     color: theme_fontColorNormal
                     font.pixelSize: theme_fontPixelSizeLarge
                     smooth: true
@@ -688,7 +729,7 @@ Flickable {
             id: notesHeader
             width: parent.width
             height: 70
-            opacity: (detailModel.data(index, PeopleModel.NotesRole).length > 0 ? 1: 0)
+            opacity: (detailData(PeopleModel.NotesRole).length > 0 ? 1: 0)
 
             Text{
                 id: label_notes
@@ -712,7 +753,7 @@ Flickable {
 
                 Text{
                     id: data_notes
-                    text: getTruncatedString(detailModel.data(index, PeopleModel.NotesRole), 50)
+                    text: getTruncatedString(detailData(PeopleModel.NotesRole), 50)
                     color: theme_fontColorNormal
                     font.pixelSize: theme_fontPixelSizeLarge
                     smooth: true
@@ -27,6 +27,7 @@ Flickable {
 
     property PeopleModel dataModel: contactModel
     property int index: personRow
+    property int detailsRevision: 0
     property bool validInput: false
 
     property string contextHome: qsTr("Home")
@@ -46,6 +47,23 @@ Flickable {
     property string unfavoriteValue: "Unfavorite"
     property string unfavoriteTranslated: qsTr("Unfavorite")
 
+    //Notes are only loaded on demand; reading them through detailData()
+    //re-evaluates the bindings once they arrive
+    function detailData(role) {
+        return (detailsRevision >= 0 ? dataModel.data(index, role) : undefined);
+    }
+
+    Component.onCompleted: dataModel.loadDetails(index)
+    onIndexChanged: dataModel.loadDetails(index)
+
+    Connections {
+        target: dataModel
+        onDetailsLoaded: {
+            if (row == index)
+                detailsRevision++;
+        }
+    }
+
     function contactSave(contactId){
         var addresses = addys.getNewAddresses();
         var newPhones = phones.getNewPhones();
@@ -244,8 +262,8 @@ Flickable {
             id:addys
             width: parent.width
             height: childrenRect.height
-            addressModel: dataModel.data(index, PeopleModel.AddressRole)
-            contextModel: dataModel.data(index, PeopleModel.AddressContextRole)
+            addressModel: detailData(PeopleModel.AddressRole)
+            contextModel: detailData(PeopleModel.AddressContextRole)
             anchors { left: parent.left }
         }
 
@@ -272,7 +290,7 @@ Flickable {
             source: "image://theme/contacts/active_row"
             TextEntry{
                 id: data_birthday
-                text: dataModel.data(index, PeopleModel.BirthdayRole)
+                text: detailData(PeopleModel.BirthdayRole)
                 defaultText: defaultBirthday
                 anchors {verticalCenter: birthday.verticalCenter; left: parent.left; topMargin: 30; leftMargin: 30; right: parent.right; rightMargin: 30}
                 MouseArea{
@@ -323,7 +341,7 @@ Flickable {
             anchors.bottomMargin: 1
             TextEntry{
                 id: data_notes
-                text: dataModel.data(index, PeopleModel.NotesRole)
+                text: detailData(PeopleModel.NotesRole)
                 defaultText: defaultNote
                 height: 300
                 anchors {top: parent.top; left: parent.left; right: parent.right; rightMargin: 30; topMargin: 20; leftMargin: 30}
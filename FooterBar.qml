@@ -42,9 +42,7 @@ Item {
 
     function handleButtonClick(action) {
         if (action == scene.contextShare) {
-            peopleModel.exportContact(scene.currentContactId,  "/tmp/vcard.vcf");
-            var cmd = "/usr/bin/meego-qml-launcher --app meego-app-email --fullscreen --cmd openComposer --cdata \"file:///tmp/vcard.vcf\"";
-            appModel.launch(cmd);
+            scene.shareContact(scene.currentContactId, "/tmp/vcard.vcf");
         } else if (action == scene.contextEdit) {
             scene.addApplicationPage(pageToLoad);
         } else if (action == scene.contextSave) {
@@ -45,6 +45,18 @@ Item {
         model: sortModel
         opacity: 0
 
+        //Warm the cards of the rows coming into view, and the details of
+        //the rows just past them, once per newly reached first row
+        property int prefetchedRow: -1
+        onContentYChanged: {
+            var first = indexAt(0, contentY);
+            if (first < 0 || first == prefetchedRow)
+                return;
+            prefetchedRow = first;
+            var last = indexAt(0, contentY + height - 1);
+            sortModel.prefetch(first, (last < 0 ? count - 1 : last));
+        }
+
         delegate: ContactCardPortrait
         {
         id: card
@@ -117,10 +129,8 @@ Binding{target: cardListView; property: "opacity"; value: ((cardListView.count >
             onTriggered: {
                 if(index == 0) {
                     var filename = currentContactName.replace(" ", "_");
-                    peopleModel.exportContact(scene.currentContactId,  "/tmp/vcard_"+filename+".vcf");
+                    scene.shareContact(scene.currentContactId, "/tmp/vcard_"+filename+".vcf");
                     shareMenu.visible = false;
-                    var cmd = "/usr/bin/meego-qml-launcher --app meego-app-email --fullscreen --cmd openComposer --cdata \"file:///tmp/vcard_"+filename+".vcf\"";
-                    appModel.launch(cmd);
                 }
             }
         }
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QContactOnlineAccount>
+
+#include "accountindex.h"
+
+AccountIndex::AccountIndex()
+{
+}
+
+/*! Files \a contact under its accounts, replacing what was filed for
+ * \a id before.
+ */
+void AccountIndex::insert(QContactLocalId id, const QContact &contact)
+{
+    remove(id);
+
+    QStringList accounts;
+    foreach (const QContactOnlineAccount &detail, contact.details<QContactOnlineAccount>()) {
+        QString account = detail.serviceProvider();
+        if (account.isEmpty() || accounts.contains(account))
+            continue;
+
+        Account &entry = mAccounts[account];
+        if (entry.protocol.isEmpty())
+            entry.protocol = detail.protocol();
+        entry.contacts.insert(id);
+        accounts << account;
+    }
+
+    if (!accounts.isEmpty())
+        mAccountsOf.insert(id, accounts);
+}
+
+void AccountIndex::remove(QContactLocalId id)
+{
+    foreach (const QString &account, mAccountsOf.take(id)) {
+        QHash<QString, Account>::iterator it = mAccounts.find(account);
+        if (it == mAccounts.end())
+            continue;
+
+        it->contacts.remove(id);
+        if (it->contacts.isEmpty())
+            mAccounts.erase(it);
+    }
+}
+
+void AccountIndex::clear()
+{
+    mAccounts.clear();
+    mAccountsOf.clear();
+}
+
+/*! Returns the accounts at least one contact is reachable through.
+ */
+QStringList AccountIndex::accounts() const
+{
+    return mAccounts.keys();
+}
+
+/*! Returns the protocol of \a account, e.g. "jabber", as given by the
+ * first contact filed under it.
+ */
+QString AccountIndex::protocol(const QString &account) const
+{
+    return mAccounts.value(account).protocol;
+}
+
+QSet<QContactLocalId> AccountIndex::contacts(const QString &account) const
+{
+    QHash<QString, Account>::const_iterator it = mAccounts.constFind(account);
+    return it == mAccounts.constEnd() ? QSet<QContactLocalId>() : it->contacts;
+}
+
+bool AccountIndex::contains(const QString &account, QContactLocalId id) const
+{
+    QHash<QString, Account>::const_iterator it = mAccounts.constFind(account);
+    return it != mAccounts.constEnd() && it->contacts.contains(id);
+}
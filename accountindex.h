@@ -0,0 +1,52 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef ACCOUNTINDEX_H
+#define ACCOUNTINDEX_H
+
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QContact>
+
+QTM_USE_NAMESPACE
+
+/*! Maps the IM accounts contacts are reachable through to those contacts.
+ *
+ * An account is named by the service provider of a QContactOnlineAccount
+ * detail, e.g. the Telepathy account of a Jabber or MSN login. Each
+ * contact is filed under every account it has an online account detail
+ * for when it is stored, so listing the accounts or the contacts of one
+ * account never looks at the contacts themselves.
+ */
+class AccountIndex
+{
+public:
+    AccountIndex();
+
+    void insert(QContactLocalId id, const QContact &contact);
+    void remove(QContactLocalId id);
+    void clear();
+
+    QStringList accounts() const;
+    QString protocol(const QString &account) const;
+    QSet<QContactLocalId> contacts(const QString &account) const;
+    bool contains(const QString &account, QContactLocalId id) const;
+
+private:
+    struct Account {
+        QString protocol;
+        QSet<QContactLocalId> contacts;
+    };
+
+    QHash<QString, Account> mAccounts;
+    // the accounts each contact is filed under, to remove it again
+    QHash<QContactLocalId, QStringList> mAccountsOf;
+};
+
+#endif // ACCOUNTINDEX_H
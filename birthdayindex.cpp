@@ -0,0 +1,127 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QContactBirthday>
+
+#include "birthdayindex.h"
+
+BirthdayIndex::BirthdayIndex()
+    : mTextLocale(QLocale::system())
+{
+}
+
+void BirthdayIndex::insert(QContactLocalId id, const QContact &contact)
+{
+    QDate birthday = contact.detail<QContactBirthday>().date();
+    if (birthday == mDates.value(id))
+        return;
+
+    remove(id);
+    if (!birthday.isValid())
+        return;
+
+    mByDay.insert(dayKey(birthday), id);
+    mDates.insert(id, birthday);
+}
+
+void BirthdayIndex::remove(QContactLocalId id)
+{
+    QHash<QContactLocalId, QDate>::iterator it = mDates.find(id);
+    if (it == mDates.end())
+        return;
+
+    mByDay.remove(dayKey(it.value()), id);
+    mDates.erase(it);
+    mText.remove(id);
+}
+
+void BirthdayIndex::clear()
+{
+    mByDay.clear();
+    mDates.clear();
+    mText.clear();
+}
+
+bool BirthdayIndex::contains(QContactLocalId id) const
+{
+    return mDates.contains(id);
+}
+
+/*! Returns the day \a birthday is celebrated in \a year: February 28 for
+ * February 29 outside leap years.
+ */
+QDate BirthdayIndex::occurrence(const QDate &birthday, int year)
+{
+    if (birthday.month() == 2 && birthday.day() == 29 && !QDate::isLeapYear(year))
+        return QDate(year, 2, 28);
+    return QDate(year, birthday.month(), birthday.day());
+}
+
+/*! Returns the first birthday of contact \a id on or after \a from, or
+ * an invalid date if it has none.
+ */
+QDate BirthdayIndex::nextBirthday(QContactLocalId id, const QDate &from) const
+{
+    QHash<QContactLocalId, QDate>::const_iterator it = mDates.constFind(id);
+    if (it == mDates.constEnd())
+        return QDate();
+
+    QDate next = occurrence(it.value(), from.year());
+    if (next < from)
+        next = occurrence(it.value(), from.year() + 1);
+    return next;
+}
+
+/*! Returns at most \a count birthdays on or after \a from, soonest first.
+ */
+QList<BirthdayIndex::Upcoming> BirthdayIndex::upcoming(const QDate &from, int count) const
+{
+    QList<Upcoming> result;
+    if (mByDay.isEmpty() || count <= 0)
+        return result;
+
+    QMultiMap<int, QContactLocalId>::const_iterator start = mByDay.lowerBound(dayKey(from));
+    QMultiMap<int, QContactLocalId>::const_iterator it = start;
+    do {
+        if (it == mByDay.constEnd()) {
+            it = mByDay.constBegin();
+            if (it == start)
+                break;
+        }
+
+        Upcoming birthday = { it.value(), nextBirthday(it.value(), from) };
+        result.append(birthday);
+        ++it;
+    } while (it != start && result.size() < count);
+
+    return result;
+}
+
+/*! Returns the birthday of contact \a id formatted for the system
+ * locale, or an empty string if it has none.
+ */
+QString BirthdayIndex::text(QContactLocalId id) const
+{
+    QHash<QContactLocalId, QDate>::const_iterator date = mDates.constFind(id);
+    if (date == mDates.constEnd())
+        return QString();
+
+    QLocale locale = QLocale::system();
+    if (locale != mTextLocale) {
+        mText.clear();
+        mTextLocale = locale;
+    }
+
+    QHash<QContactLocalId, QString>::const_iterator it = mText.constFind(id);
+    if (it != mText.constEnd())
+        return it.value();
+
+    QString text = date.value().toString(Qt::SystemLocaleDate);
+    mText.insert(id, text);
+    return text;
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef BIRTHDAYINDEX_H
+#define BIRTHDAYINDEX_H
+
+#include <QDate>
+#include <QHash>
+#include <QList>
+#include <QLocale>
+#include <QMultiMap>
+#include <QContact>
+
+QTM_USE_NAMESPACE
+
+/*! Orders contacts by the day of the year of their birthday, to find the
+ * next birthdays from any date without looking at every contact.
+ *
+ * Contacts are keyed by month and day, so a query seeks to the day it
+ * starts from and walks forward, wrapping around at the end of the year:
+ * O(log n + N) for the next N birthdays. Birthdays on February 29 sort
+ * between February 28 and March 1, and fall on February 28 in years that
+ * are not leap years.
+ *
+ * The birthday as shown in the list, formatted for the system locale, is
+ * kept too, and formatted again when the locale changes.
+ */
+class BirthdayIndex
+{
+public:
+    struct Upcoming {
+        QContactLocalId id;
+        QDate date;
+    };
+
+    BirthdayIndex();
+
+    void insert(QContactLocalId id, const QContact &contact);
+    void remove(QContactLocalId id);
+    void clear();
+
+    bool contains(QContactLocalId id) const;
+    QDate nextBirthday(QContactLocalId id, const QDate &from) const;
+    QList<Upcoming> upcoming(const QDate &from, int count) const;
+    QString text(QContactLocalId id) const;
+
+    static QDate occurrence(const QDate &birthday, int year);
+
+private:
+    static int dayKey(const QDate &date) { return date.month() * 32 + date.day(); }
+
+    QMultiMap<int, QContactLocalId> mByDay;
+    QHash<QContactLocalId, QDate> mDates;
+
+    mutable QHash<QContactLocalId, QString> mText;
+    mutable QLocale mTextLocale;
+};
+
+#endif // BIRTHDAYINDEX_H
@@ -0,0 +1,638 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QDebug>
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QRegExp>
+#include <QtConcurrentRun>
+#include <QContactAvatar>
+#include <QContactDisplayLabel>
+#include <QContactGlobalPresence>
+#include <QContactGuid>
+#include <QContactLocalIdFilter>
+#include <QContactPresence>
+#include <QContactThumbnail>
+#include <QContactTimestamp>
+
+#include <string.h>
+
+#include "contactbackup.h"
+#include "contactstore.h"
+
+static const quint32 FileMagic = 0x4342414b; // "CBAK"
+static const quint16 FileVersion = 1;
+static const int HeaderSize = 32;
+static const int IndexEntrySize = 20;
+
+// avatar files larger than this are left out of the backup
+static const qint64 MaxAvatarFileSize = 4 * 1024 * 1024;
+
+// how each detail is stored
+enum DetailEncoding {
+    PlainDetail,
+    RawThumbnail,
+    RawAvatarFile
+};
+
+static quint32 crcTable[256];
+
+static void initCrcTable()
+{
+    for (quint32 i = 0; i < 256; i++) {
+        quint32 crc = i;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320u : crc >> 1;
+        crcTable[i] = crc;
+    }
+}
+
+static quint32 crc32(const char *data, int size)
+{
+    quint32 crc = 0xffffffffu;
+    for (int i = 0; i < size; i++)
+        crc = crcTable[(crc ^ quint8(data[i])) & 0xff] ^ (crc >> 8);
+    return crc ^ 0xffffffffu;
+}
+
+// details that the backend maintains itself; presence is transient, but
+// a trace needs it to reproduce presence changes
+static bool isWritten(const QContactDetail &detail, bool forTrace)
+{
+    QString name = detail.definitionName();
+    if (name == QContactPresence::DefinitionName)
+        return forTrace;
+    return name != QContactDisplayLabel::DefinitionName
+            && name != QContactGlobalPresence::DefinitionName
+            && name != QContactTimestamp::DefinitionName;
+}
+
+static QString localAvatarFile(const QVariantMap &values)
+{
+    QUrl url = values.value(QContactAvatar::FieldImageUrl).toUrl();
+    QString path = url.toLocalFile();
+    if (path.isEmpty() && url.scheme().isEmpty())
+        path = url.toString();
+    return path;
+}
+
+static void writeImage(QDataStream &out, QImage image)
+{
+    if (image.isNull()) {
+        out << qint32(-1);
+        return;
+    }
+
+    // pixels only; a color table would need storing too
+    if (image.colorCount() > 0)
+        image = image.convertToFormat(QImage::Format_ARGB32);
+
+    out << qint32(image.format()) << qint32(image.width()) << qint32(image.height())
+        << qint32(image.bytesPerLine());
+    out.writeBytes(reinterpret_cast<const char *>(image.constBits()), image.byteCount());
+}
+
+static QImage readImage(QDataStream &in)
+{
+    qint32 format;
+    in >> format;
+    if (format < 0)
+        return QImage();
+
+    qint32 width, height, bytesPerLine;
+    char *bits = 0;
+    uint size = 0;
+    in >> width >> height >> bytesPerLine;
+    in.readBytes(bits, size);
+
+    QImage image;
+    if (in.status() == QDataStream::Ok && width > 0 && height > 0
+        && size == uint(height) * uint(bytesPerLine)) {
+        image = QImage(width, height, QImage::Format(format));
+        int lineBytes = qMin(image.bytesPerLine(), int(bytesPerLine));
+        for (int y = 0; y < height && !image.isNull(); y++)
+            memcpy(image.scanLine(y), bits + y * bytesPerLine, lineBytes);
+    }
+    delete [] bits;
+    return image;
+}
+
+/*! Writes the details of \a contact to \a out. Backups embed local
+ * avatar files; a ContactTrace, \a forTrace, leaves them out but keeps
+ * presence.
+ */
+void ContactBackup::writeContact(QDataStream &out, const QContact &contact, bool forTrace)
+{
+    QList<QContactDetail> details;
+    foreach (const QContactDetail &detail, contact.details()) {
+        if (isWritten(detail, forTrace))
+            details << detail;
+    }
+
+    out << quint32(details.size());
+    foreach (const QContactDetail &detail, details) {
+        QVariantMap values = detail.variantValues();
+        out << detail.definitionName();
+
+        if (detail.definitionName() == QContactThumbnail::DefinitionName) {
+            QImage image = values.take(QContactThumbnail::FieldThumbnail).value<QImage>();
+            out << quint8(RawThumbnail) << values;
+            writeImage(out, image);
+            continue;
+        }
+
+        if (!forTrace && detail.definitionName() == QContactAvatar::DefinitionName) {
+            QFile file(localAvatarFile(values));
+            if (!file.fileName().isEmpty() && file.size() <= MaxAvatarFileSize
+                && file.open(QIODevice::ReadOnly)) {
+                out << quint8(RawAvatarFile) << values << file.readAll();
+                continue;
+            }
+        }
+
+        out << quint8(PlainDetail) << values;
+    }
+}
+
+/*! Reads a contact written by writeContact() from \a in into \a contact.
+ * Embedded avatar files are written to \a avatarDirectory, under a name
+ * derived from their content, and the avatar url pointed there; without
+ * a directory they are dropped. The name the file had when backed up is
+ * never written to, since the backup may not be ours.
+ */
+bool ContactBackup::readContact(QDataStream &in, QContact *contact,
+                                const QString &avatarDirectory)
+{
+    quint32 count;
+    in >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        QString definitionName;
+        quint8 encoding;
+        QVariantMap values;
+        in >> definitionName >> encoding >> values;
+
+        QContactDetail detail(definitionName);
+        for (QVariantMap::const_iterator it = values.constBegin(); it != values.constEnd(); ++it)
+            detail.setValue(it.key(), it.value());
+
+        if (encoding == RawThumbnail) {
+            detail.setValue(QContactThumbnail::FieldThumbnail, readImage(in));
+        } else if (encoding == RawAvatarFile) {
+            QByteArray bytes;
+            in >> bytes;
+
+            QString path = localAvatarFile(values);
+            if (in.status() != QDataStream::Ok || avatarDirectory.isEmpty()
+                || path.contains("..")) {
+                if (path.contains(".."))
+                    qWarning() << Q_FUNC_INFO << "ignoring avatar" << path;
+                continue;
+            }
+
+            QString suffix = QFileInfo(path).suffix();
+            if (suffix.contains(QRegExp("[^A-Za-z0-9]")))
+                suffix.clear();
+            QString restored = avatarDirectory + "/"
+                    + QCryptographicHash::hash(bytes, QCryptographicHash::Md5).toHex()
+                    + (suffix.isEmpty() ? QString() : "." + suffix);
+
+            // the same content restored twice lands on the same file
+            if (!QFile::exists(restored)) {
+                QDir().mkpath(avatarDirectory);
+                QFile file(restored);
+                if (!file.open(QIODevice::WriteOnly) || file.write(bytes) != bytes.size()) {
+                    qWarning() << Q_FUNC_INFO << "failed to restore avatar" << restored;
+                    continue;
+                }
+            }
+            detail.setValue(QContactAvatar::FieldImageUrl, QUrl::fromLocalFile(restored));
+        }
+
+        contact->saveDetail(&detail);
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+// runs in a worker thread
+static QList<QContact> decodeChunk(const char *data, ContactBackup::Chunk chunk,
+                                   QString avatarDirectory)
+{
+    QList<QContact> contacts;
+    if (crc32(data + chunk.offset, chunk.size) != chunk.checksum) {
+        qWarning() << Q_FUNC_INFO << "checksum mismatch in chunk at" << chunk.offset;
+        return contacts;
+    }
+
+    QByteArray payload = QByteArray::fromRawData(data + chunk.offset, chunk.size);
+    QDataStream in(payload);
+    in.setVersion(QDataStream::Qt_4_7);
+    for (quint32 i = 0; i < chunk.count; i++) {
+        QContact contact;
+        if (!ContactBackup::readContact(in, &contact, avatarDirectory)) {
+            qWarning() << Q_FUNC_INFO << "corrupt contact in chunk at" << chunk.offset;
+            return QList<QContact>();
+        }
+        contacts << contact;
+    }
+    return contacts;
+}
+
+ContactBackup::ContactBackup(ContactStore *store, QObject *parent)
+    : QObject(parent), mStore(store), mMode(Idle), mCancelled(false), mFailed(false),
+      mDone(0), mTotal(0), mData(0), mNextChunk(0), mDecoding(false), mDecodedReady(false)
+{
+    initCrcTable();
+    connect(&mDecoder, SIGNAL(finished()), this, SLOT(onChunkDecoded()));
+}
+
+ContactBackup::~ContactBackup()
+{
+    if (mMode != Idle)
+        finish(false);
+}
+
+bool ContactBackup::isBusy() const
+{
+    return mMode != Idle;
+}
+
+/*! Starts writing every contact of the store to \a fileName. Returns
+ * false if another backup or restore is running or the file cannot be
+ * written.
+ */
+bool ContactBackup::backup(const QString &fileName)
+{
+    if (mMode != Idle)
+        return false;
+
+    // written under another name until complete
+    mFileName = fileName;
+    mFile.setFileName(fileName + ".part");
+    if (!mFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << Q_FUNC_INFO << "failed to write" << mFile.fileName();
+        return false;
+    }
+    mFile.write(QByteArray(HeaderSize, 0));
+
+    mPendingIds.clear();
+    foreach (const QContactLocalId &id, mStore->contactIds()) {
+        if (!mStore->isProvisional(id))
+            mPendingIds << id;
+    }
+
+    mMode = BackingUp;
+    mCancelled = false;
+    mFailed = false;
+    mChunks.clear();
+    mDone = 0;
+    mTotal = mPendingIds.size();
+    emit progress(mDone, mTotal);
+
+    fetchNextChunk();
+    if (!mFetchRequest)
+        finish(!mFailed && writeIndex());
+    return true;
+}
+
+void ContactBackup::fetchNextChunk()
+{
+    mFetchRequest = 0;
+    if (mPendingIds.isEmpty())
+        return;
+
+    QContactLocalIdFilter filter;
+    filter.setIds(mPendingIds.mid(0, ChunkSize));
+    mPendingIds = mPendingIds.mid(ChunkSize);
+
+    QContactFetchRequest *fetchRequest = new QContactFetchRequest(this);
+    fetchRequest->setManager(mStore->manager());
+    fetchRequest->setFilter(filter);
+    connect(fetchRequest, SIGNAL(stateChanged(QContactAbstractRequest::State)),
+            this, SLOT(onFetchStateChanged(QContactAbstractRequest::State)));
+
+    if (!fetchRequest->start()) {
+        qWarning() << Q_FUNC_INFO << "Fetch request failed";
+        delete fetchRequest;
+        mFailed = true;
+        return;
+    }
+    mFetchRequest = fetchRequest;
+}
+
+void ContactBackup::onFetchStateChanged(QContactAbstractRequest::State requestState)
+{
+    QContactFetchRequest *fetchRequest = qobject_cast<QContactFetchRequest *>(sender());
+    if (!fetchRequest || (requestState != QContactAbstractRequest::FinishedState
+                          && requestState != QContactAbstractRequest::CanceledState))
+        return;
+
+    fetchRequest->deleteLater();
+    if (mMode != BackingUp || fetchRequest != mFetchRequest)
+        return;
+
+    if (fetchRequest->error() != QContactManager::NoError
+        || requestState == QContactAbstractRequest::CanceledState) {
+        qWarning() << Q_FUNC_INFO << "Error" << fetchRequest->error() << "fetching contacts";
+        finish(false);
+        return;
+    }
+
+    // the next chunk is fetched while this one is written
+    QList<QContact> contacts = fetchRequest->contacts();
+    fetchNextChunk();
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_7);
+    foreach (const QContact &contact, contacts)
+        writeContact(out, contact, false);
+
+    Chunk chunk;
+    chunk.offset = mFile.pos();
+    chunk.size = payload.size();
+    chunk.count = contacts.size();
+    chunk.checksum = crc32(payload.constData(), payload.size());
+    if (mFile.write(payload) != payload.size()) {
+        qWarning() << Q_FUNC_INFO << "failed to write" << mFile.fileName();
+        finish(false);
+        return;
+    }
+    mChunks.append(chunk);
+
+    mDone += contacts.size();
+    emit progress(mDone, mTotal);
+
+    if (!mFetchRequest)
+        finish(!mFailed && writeIndex());
+}
+
+/*! Appends the chunk index, fills in the header and gives the backup
+ * its final name.
+ */
+bool ContactBackup::writeIndex()
+{
+    QByteArray index;
+    QDataStream out(&index, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_7);
+    foreach (const Chunk &chunk, mChunks)
+        out << chunk.offset << chunk.size << chunk.count << chunk.checksum;
+
+    quint64 indexOffset = mFile.pos();
+    if (mFile.write(index) != index.size())
+        return false;
+
+    QByteArray header;
+    QDataStream headerOut(&header, QIODevice::WriteOnly);
+    headerOut.setVersion(QDataStream::Qt_4_7);
+    headerOut << FileMagic << FileVersion << quint16(0) << quint32(mDone)
+              << quint32(mChunks.size()) << indexOffset
+              << crc32(index.constData(), index.size()) << quint32(0);
+
+    if (!mFile.seek(0) || mFile.write(header) != HeaderSize || !mFile.flush())
+        return false;
+    mFile.close();
+
+    QFile::remove(mFileName);
+    if (!QFile::rename(mFile.fileName(), mFileName)) {
+        qWarning() << Q_FUNC_INFO << "failed to rename backup to" << mFileName;
+        return false;
+    }
+    return true;
+}
+
+/*! Starts restoring the contacts backed up in \a fileName. Returns false
+ * if another backup or restore is running or the file is not a backup.
+ */
+bool ContactBackup::restore(const QString &fileName)
+{
+    if (mMode != Idle)
+        return false;
+
+    // restored avatar files only ever go here
+    mAvatarDirectory = QFileInfo(mStore->settings()->fileName()).absolutePath()
+            + "/meego-app-contacts-avatars";
+
+    mFile.setFileName(fileName);
+    if (!mFile.open(QIODevice::ReadOnly)) {
+        qWarning() << Q_FUNC_INFO << "failed to read" << fileName;
+        return false;
+    }
+
+    qint64 size = mFile.size();
+    mData = size >= HeaderSize ? reinterpret_cast<const char *>(mFile.map(0, size)) : 0;
+    if (!mData) {
+        qWarning() << Q_FUNC_INFO << "failed to map" << fileName;
+        mFile.close();
+        return false;
+    }
+
+    QDataStream header(QByteArray::fromRawData(mData, HeaderSize));
+    header.setVersion(QDataStream::Qt_4_7);
+    quint32 magic, count, chunkCount, indexChecksum, reserved;
+    quint16 version, flags;
+    quint64 indexOffset;
+    header >> magic >> version >> flags >> count >> chunkCount >> indexOffset
+           >> indexChecksum >> reserved;
+
+    bool valid = magic == FileMagic && version == FileVersion
+            && indexOffset >= quint64(HeaderSize)
+            && indexOffset + quint64(chunkCount) * IndexEntrySize <= quint64(size)
+            && crc32(mData + indexOffset, chunkCount * IndexEntrySize) == indexChecksum;
+
+    mChunks.clear();
+    if (valid) {
+        QDataStream index(QByteArray::fromRawData(mData + indexOffset,
+                                                  chunkCount * IndexEntrySize));
+        index.setVersion(QDataStream::Qt_4_7);
+        for (quint32 i = 0; i < chunkCount && valid; i++) {
+            Chunk chunk;
+            index >> chunk.offset >> chunk.size >> chunk.count >> chunk.checksum;
+            valid = chunk.offset >= quint64(HeaderSize)
+                    && chunk.offset + chunk.size <= indexOffset;
+            mChunks.append(chunk);
+        }
+    }
+
+    if (!valid) {
+        qWarning() << Q_FUNC_INFO << fileName << "is not a contact backup";
+        mFile.unmap(reinterpret_cast<uchar *>(const_cast<char *>(mData)));
+        mData = 0;
+        mFile.close();
+        return false;
+    }
+
+    mMode = Restoring;
+    mCancelled = false;
+    mFailed = false;
+    mDone = 0;
+    mTotal = count;
+    mNextChunk = 0;
+    mDecoded.clear();
+    mDecodedReady = false;
+    emit progress(mDone, mTotal);
+
+    decodeNextChunk();
+    continueRestore();
+    return true;
+}
+
+void ContactBackup::decodeNextChunk()
+{
+    if (mNextChunk >= mChunks.size())
+        return;
+
+    mDecoding = true;
+    mDecoder.setFuture(QtConcurrent::run(decodeChunk, mData, mChunks.at(mNextChunk++),
+                                           mAvatarDirectory));
+}
+
+void ContactBackup::onChunkDecoded()
+{
+    if (mMode != Restoring)
+        return;
+
+    mDecoding = false;
+    mDecoded = mDecoder.result();
+    mDecodedReady = true;
+    if (uint(mDecoded.size()) != mChunks.at(mNextChunk - 1).count)
+        mFailed = true;
+    continueRestore();
+}
+
+/*! Saves the decoded chunk once the previous save is done, or finishes
+ * when there is nothing left to decode or save.
+ */
+void ContactBackup::continueRestore()
+{
+    if (mSaveRequest || mDecoding)
+        return;
+
+    if (mCancelled)
+        finish(false);
+    else if (mDecodedReady)
+        saveDecodedChunk();
+    else
+        finish(!mFailed);
+}
+
+void ContactBackup::saveDecodedChunk()
+{
+    QList<QContact> contacts = mDecoded;
+    mDecoded.clear();
+    mDecodedReady = false;
+
+    // the next chunk is decoded while this one is saved
+    decodeNextChunk();
+
+    // contacts still in the address book are overwritten
+    for (int i = 0; i < contacts.size(); i++) {
+        QString guid = contacts.at(i).detail<QContactGuid>().guid();
+        QContactLocalId id = guid.isEmpty() ? 0 : mStore->idForUuid(QUuid(guid));
+        if (!id || !mStore->contains(id) || mStore->isProvisional(id))
+            continue;
+
+        QContactId contactId;
+        contactId.setManagerUri(mStore->manager()->managerUri());
+        contactId.setLocalId(id);
+        contacts[i].setId(contactId);
+    }
+
+    if (contacts.isEmpty()) {
+        continueRestore();
+        return;
+    }
+
+    QContactSaveRequest *saveRequest = new QContactSaveRequest(this);
+    saveRequest->setManager(mStore->manager());
+    saveRequest->setContacts(contacts);
+    connect(saveRequest, SIGNAL(stateChanged(QContactAbstractRequest::State)),
+            this, SLOT(onSaveStateChanged(QContactAbstractRequest::State)));
+
+    if (!saveRequest->start()) {
+        qWarning() << Q_FUNC_INFO << "Save request failed: " << saveRequest->error();
+        delete saveRequest;
+        mFailed = true;
+        mDone += contacts.size();
+        emit progress(mDone, mTotal);
+        continueRestore();
+        return;
+    }
+    mSaveRequest = saveRequest;
+}
+
+void ContactBackup::onSaveStateChanged(QContactAbstractRequest::State requestState)
+{
+    QContactSaveRequest *saveRequest = qobject_cast<QContactSaveRequest *>(sender());
+    if (!saveRequest || (requestState != QContactAbstractRequest::FinishedState
+                         && requestState != QContactAbstractRequest::CanceledState))
+        return;
+
+    saveRequest->deleteLater();
+    if (mMode != Restoring || saveRequest != mSaveRequest)
+        return;
+
+    if (saveRequest->error() != QContactManager::NoError) {
+        qWarning() << Q_FUNC_INFO << "Error" << saveRequest->error() << "restoring"
+                   << saveRequest->errorMap().size() << "of"
+                   << saveRequest->contacts().size() << "contacts";
+        mFailed = true;
+    }
+
+    mSaveRequest = 0;
+    mDone += saveRequest->contacts().size();
+    emit progress(mDone, mTotal);
+    continueRestore();
+}
+
+/*! Stops the running backup or restore. A backup is discarded; contacts
+ * restored so far stay. finished() follows, possibly after the request
+ * in flight completes.
+ */
+void ContactBackup::cancel()
+{
+    if (mMode == BackingUp) {
+        if (mFetchRequest)
+            mFetchRequest->cancel();
+        finish(false);
+    } else if (mMode == Restoring) {
+        mCancelled = true;
+        continueRestore();
+    }
+}
+
+void ContactBackup::finish(bool success)
+{
+    if (mMode == BackingUp) {
+        mFetchRequest = 0;
+        mPendingIds.clear();
+        mFile.close();
+        if (!success)
+            mFile.remove();
+        qDebug() << Q_FUNC_INFO << "backed up" << mDone << "contacts to" << mFileName
+                 << (success ? "" : "(failed)");
+    } else if (mMode == Restoring) {
+        mDecoder.waitForFinished();
+        mDecoding = false;
+        mDecoded.clear();
+        mDecodedReady = false;
+        if (mData)
+            mFile.unmap(reinterpret_cast<uchar *>(const_cast<char *>(mData)));
+        mData = 0;
+        mFile.close();
+        qDebug() << Q_FUNC_INFO << "restored" << mDone << "contacts from" << mFile.fileName()
+                 << (success ? "" : "(failed)");
+    }
+
+    mMode = Idle;
+    mChunks.clear();
+    emit finished(success);
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef CONTACTBACKUP_H
+#define CONTACTBACKUP_H
+
+#include <QObject>
+#include <QDataStream>
+#include <QFile>
+#include <QFutureWatcher>
+#include <QList>
+#include <QPointer>
+#include <QVector>
+#include <QContact>
+#include <QContactFetchRequest>
+#include <QContactSaveRequest>
+
+QTM_USE_NAMESPACE
+
+class ContactStore;
+
+/*! Backs up the whole address book to a file and restores it.
+ *
+ * A backup is a header, a run of chunks of up to ChunkSize contacts and
+ * an index of the chunks at the end, each chunk with a CRC-32. Contacts
+ * are written detail by detail; thumbnails are stored as raw pixels and
+ * local avatar files as their raw bytes, rather than as base64 text the
+ * way a vCard would.
+ *
+ * Backing up fetches the complete contacts a chunk at a time, fetching
+ * the next chunk while the previous one is written. Restoring maps the
+ * file, decodes chunks in a worker thread and saves each one with a
+ * single QContactSaveRequest while the next is decoded. Contacts whose
+ * uuid is already known are overwritten rather than duplicated, so a
+ * restore can be run twice.
+ *
+ * Both report progress() per chunk and can be cancelled; a cancelled
+ * backup leaves no file behind.
+ */
+class ContactBackup: public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ContactBackup(ContactStore *store, QObject *parent = 0);
+    virtual ~ContactBackup();
+
+    bool backup(const QString &fileName);
+    bool restore(const QString &fileName);
+    void cancel();
+    bool isBusy() const;
+
+    static void writeContact(QDataStream &out, const QContact &contact, bool forTrace);
+    static bool readContact(QDataStream &in, QContact *contact,
+                            const QString &avatarDirectory = QString());
+
+    static const int ChunkSize = 500;
+
+    // one entry of the chunk index
+    struct Chunk {
+        quint64 offset;
+        quint32 size;
+        quint32 count;
+        quint32 checksum;
+    };
+
+signals:
+    void progress(int done, int total);
+    void finished(bool success);
+
+private slots:
+    void onFetchStateChanged(QContactAbstractRequest::State requestState);
+    void onChunkDecoded();
+    void onSaveStateChanged(QContactAbstractRequest::State requestState);
+
+private:
+    enum Mode {
+        Idle,
+        BackingUp,
+        Restoring
+    };
+
+    void fetchNextChunk();
+    bool writeIndex();
+    void decodeNextChunk();
+    void continueRestore();
+    void saveDecodedChunk();
+    void finish(bool success);
+
+    ContactStore *mStore;
+    Mode mMode;
+    bool mCancelled;
+    bool mFailed;
+    int mDone;
+    int mTotal;
+
+    QFile mFile;
+    QString mFileName;
+    QVector<Chunk> mChunks;
+
+    // backup: the contacts left to fetch, and the fetch in flight
+    QList<QContactLocalId> mPendingIds;
+    QPointer<QContactFetchRequest> mFetchRequest;
+
+    // restore: the mapped file, the chunk being decoded and the save in
+    // flight
+    QString mAvatarDirectory;
+    const char *mData;
+    int mNextChunk;
+    QFutureWatcher<QList<QContact> > mDecoder;
+    bool mDecoding;
+    QList<QContact> mDecoded;
+    bool mDecodedReady;
+    QPointer<QContactSaveRequest> mSaveRequest;
+
+    Q_DISABLE_COPY(ContactBackup);
+};
+
+#endif // CONTACTBACKUP_H
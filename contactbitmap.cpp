@@ -0,0 +1,324 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QtAlgorithms>
+
+#include "contactbitmap.h"
+
+static const int BitmapWords = 65536 / 32;
+
+static inline int bitCount(quint32 word)
+{
+    word = word - ((word >> 1) & 0x55555555);
+    word = (word & 0x33333333) + ((word >> 2) & 0x33333333);
+    return (((word + (word >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+}
+
+static inline bool testBit(const QVector<quint32> &words, quint16 value)
+{
+    return words.at(value >> 5) & (1u << (value & 31));
+}
+
+ContactBitmap::ContactBitmap()
+    : mCount(0)
+{
+}
+
+bool ContactBitmap::Chunk::contains(quint16 value) const
+{
+    if (isBitmap())
+        return testBit(words, value);
+    return qBinaryFind(values.constBegin(), values.constEnd(), value) != values.constEnd();
+}
+
+/*! Returns the index of the chunk with \a key, or -1 - the index it
+ * would be inserted at.
+ */
+int ContactBitmap::findChunk(quint16 key) const
+{
+    int low = 0;
+    int high = mChunks.size();
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (mChunks.at(middle).key < key)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if (low < mChunks.size() && mChunks.at(low).key == key)
+        return low;
+    return -1 - low;
+}
+
+void ContactBitmap::toBitmap(Chunk &chunk)
+{
+    chunk.words.fill(0, BitmapWords);
+    foreach (quint16 value, chunk.values)
+        chunk.words[value >> 5] |= 1u << (value & 31);
+    chunk.values.clear();
+}
+
+void ContactBitmap::toArray(Chunk &chunk)
+{
+    chunk.values.clear();
+    chunk.values.reserve(chunk.count);
+    for (int word = 0; word < BitmapWords; word++) {
+        quint32 bits = chunk.words.at(word);
+        for (int bit = 0; bits; bit++, bits >>= 1) {
+            if (bits & 1)
+                chunk.values.append((word << 5) + bit);
+        }
+    }
+    chunk.words.clear();
+}
+
+bool ContactBitmap::contains(QContactLocalId id) const
+{
+    int index = findChunk(id >> 16);
+    return index >= 0 && mChunks.at(index).contains(id & 0xffff);
+}
+
+/*! Adds \a id; returns false if it was already there.
+ */
+bool ContactBitmap::insert(QContactLocalId id)
+{
+    quint16 value = id & 0xffff;
+    int index = findChunk(id >> 16);
+    if (index < 0) {
+        Chunk chunk;
+        chunk.key = id >> 16;
+        chunk.count = 1;
+        chunk.values.append(value);
+        mChunks.insert(-1 - index, chunk);
+        mCount++;
+        return true;
+    }
+
+    Chunk &chunk = mChunks[index];
+    if (chunk.isBitmap()) {
+        quint32 &word = chunk.words[value >> 5];
+        if (word & (1u << (value & 31)))
+            return false;
+        word |= 1u << (value & 31);
+    } else {
+        QVector<quint16>::iterator it = qLowerBound(chunk.values.begin(), chunk.values.end(), value);
+        if (it != chunk.values.end() && *it == value)
+            return false;
+        chunk.values.insert(it, value);
+        if (chunk.values.size() > ArrayLimit)
+            toBitmap(chunk);
+    }
+
+    chunk.count++;
+    mCount++;
+    return true;
+}
+
+/*! Removes \a id; returns false if it was not there.
+ */
+bool ContactBitmap::remove(QContactLocalId id)
+{
+    quint16 value = id & 0xffff;
+    int index = findChunk(id >> 16);
+    if (index < 0)
+        return false;
+
+    Chunk &chunk = mChunks[index];
+    if (chunk.isBitmap()) {
+        quint32 &word = chunk.words[value >> 5];
+        if (!(word & (1u << (value & 31))))
+            return false;
+        word &= ~(1u << (value & 31));
+        // shrink with some slack, so that a chunk at the limit does not
+        // flip back and forth
+        if (chunk.count - 1 <= ArrayLimit / 2)
+            toArray(chunk);
+    } else {
+        QVector<quint16>::iterator it = qBinaryFind(chunk.values.begin(), chunk.values.end(), value);
+        if (it == chunk.values.end())
+            return false;
+        chunk.values.erase(it);
+    }
+
+    mCount--;
+    if (--chunk.count == 0)
+        mChunks.remove(index);
+    return true;
+}
+
+void ContactBitmap::clear()
+{
+    mChunks.clear();
+    mCount = 0;
+}
+
+/*! Returns the ids in ascending order.
+ */
+QList<QContactLocalId> ContactBitmap::toList() const
+{
+    QList<QContactLocalId> ids;
+    ids.reserve(mCount);
+    foreach (const Chunk &chunk, mChunks) {
+        QContactLocalId high = QContactLocalId(chunk.key) << 16;
+        if (!chunk.isBitmap()) {
+            foreach (quint16 value, chunk.values)
+                ids.append(high | value);
+            continue;
+        }
+
+        for (int word = 0; word < BitmapWords; word++) {
+            quint32 bits = chunk.words.at(word);
+            for (int bit = 0; bits; bit++, bits >>= 1) {
+                if (bits & 1)
+                    ids.append(high | ((word << 5) + bit));
+            }
+        }
+    }
+    return ids;
+}
+
+int ContactBitmap::bytes() const
+{
+    int bytes = sizeof(ContactBitmap);
+    foreach (const Chunk &chunk, mChunks)
+        bytes += sizeof(Chunk) + chunk.values.size() * 2 + chunk.words.size() * 4;
+    return bytes;
+}
+
+ContactBitmap ContactBitmap::operator&(const ContactBitmap &other) const
+{
+    return combine(*this, other, And);
+}
+
+ContactBitmap ContactBitmap::operator|(const ContactBitmap &other) const
+{
+    return combine(*this, other, Or);
+}
+
+ContactBitmap ContactBitmap::operator-(const ContactBitmap &other) const
+{
+    return combine(*this, other, AndNot);
+}
+
+bool ContactBitmap::operator==(const ContactBitmap &other) const
+{
+    if (mCount != other.mCount || mChunks.size() != other.mChunks.size())
+        return false;
+    return (*this - other).isEmpty();
+}
+
+/*! Combines two chunks with the same key; the result may be empty.
+ */
+ContactBitmap::Chunk ContactBitmap::combine(const Chunk &a, const Chunk &b, Operation operation)
+{
+    Chunk result;
+    result.key = a.key;
+    result.count = 0;
+
+    // arrays are merged, or filtered by the other chunk
+    if (!a.isBitmap() && !b.isBitmap()) {
+        QVector<quint16>::const_iterator i = a.values.constBegin();
+        QVector<quint16>::const_iterator j = b.values.constBegin();
+        while (i != a.values.constEnd() || j != b.values.constEnd()) {
+            if (j == b.values.constEnd() || (i != a.values.constEnd() && *i < *j)) {
+                if (operation != And)
+                    result.values.append(*i);
+                ++i;
+            } else if (i == a.values.constEnd() || *j < *i) {
+                if (operation == Or)
+                    result.values.append(*j);
+                ++j;
+            } else {
+                if (operation != AndNot)
+                    result.values.append(*i);
+                ++i;
+                ++j;
+            }
+        }
+        result.count = result.values.size();
+        if (result.count > ArrayLimit)
+            toBitmap(result);
+        return result;
+    }
+
+    if (!a.isBitmap() && operation != Or) {
+        foreach (quint16 value, a.values) {
+            if (testBit(b.words, value) == (operation == And))
+                result.values.append(value);
+        }
+        result.count = result.values.size();
+        return result;
+    }
+    if (!b.isBitmap() && operation == And) {
+        foreach (quint16 value, b.values) {
+            if (testBit(a.words, value))
+                result.values.append(value);
+        }
+        result.count = result.values.size();
+        return result;
+    }
+
+    // at least one bitmap: go word by word
+    Chunk left = a;
+    Chunk right = b;
+    if (!left.isBitmap())
+        toBitmap(left);
+    if (!right.isBitmap())
+        toBitmap(right);
+
+    result.words.resize(BitmapWords);
+    quint32 *words = result.words.data();
+    const quint32 *x = left.words.constData();
+    const quint32 *y = right.words.constData();
+    for (int word = 0; word < BitmapWords; word++) {
+        if (operation == And)
+            words[word] = x[word] & y[word];
+        else if (operation == Or)
+            words[word] = x[word] | y[word];
+        else
+            words[word] = x[word] & ~y[word];
+        result.count += bitCount(words[word]);
+    }
+
+    if (result.count <= ArrayLimit)
+        toArray(result);
+    return result;
+}
+
+ContactBitmap ContactBitmap::combine(const ContactBitmap &a, const ContactBitmap &b,
+                                     Operation operation)
+{
+    ContactBitmap result;
+    int i = 0;
+    int j = 0;
+    while (i < a.mChunks.size() || j < b.mChunks.size()) {
+        if (j == b.mChunks.size()
+            || (i < a.mChunks.size() && a.mChunks.at(i).key < b.mChunks.at(j).key)) {
+            if (operation != And) {
+                result.mChunks.append(a.mChunks.at(i));
+                result.mCount += a.mChunks.at(i).count;
+            }
+            i++;
+        } else if (i == a.mChunks.size() || b.mChunks.at(j).key < a.mChunks.at(i).key) {
+            if (operation == Or) {
+                result.mChunks.append(b.mChunks.at(j));
+                result.mCount += b.mChunks.at(j).count;
+            }
+            j++;
+        } else {
+            Chunk chunk = combine(a.mChunks.at(i), b.mChunks.at(j), operation);
+            if (chunk.count > 0) {
+                result.mChunks.append(chunk);
+                result.mCount += chunk.count;
+            }
+            i++;
+            j++;
+        }
+    }
+    return result;
+}
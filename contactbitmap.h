@@ -0,0 +1,86 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef CONTACTBITMAP_H
+#define CONTACTBITMAP_H
+
+#include <QList>
+#include <QVector>
+#include <QContact>
+
+QTM_USE_NAMESPACE
+
+/*! A compressed set of contact ids, for group membership.
+ *
+ * Ids are split by their upper 16 bits into chunks, as in a roaring
+ * bitmap. A chunk holding few ids keeps them as a sorted array of their
+ * lower 16 bits; past ArrayLimit ids it turns into a bitmap of 65536
+ * bits, which is smaller from that point on. Intersections, unions and
+ * differences combine two sets chunk by chunk, and bitmap chunks word
+ * by word, so filtering 50k contacts down to a group costs a few
+ * thousand operations rather than a lookup per contact.
+ *
+ * ContactBitmap is a value type and cheap to copy: the chunks are
+ * implicitly shared.
+ */
+class ContactBitmap
+{
+public:
+    ContactBitmap();
+
+    bool isEmpty() const { return mCount == 0; }
+    int count() const { return mCount; }
+    bool contains(QContactLocalId id) const;
+
+    bool insert(QContactLocalId id);
+    bool remove(QContactLocalId id);
+    void clear();
+
+    QList<QContactLocalId> toList() const;
+    int bytes() const;
+
+    ContactBitmap operator&(const ContactBitmap &other) const;
+    ContactBitmap operator|(const ContactBitmap &other) const;
+    ContactBitmap operator-(const ContactBitmap &other) const;
+    bool operator==(const ContactBitmap &other) const;
+    bool operator!=(const ContactBitmap &other) const { return !(*this == other); }
+
+    static const int ArrayLimit = 4096;
+
+private:
+    enum Operation {
+        And,
+        Or,
+        AndNot
+    };
+
+    struct Chunk {
+        quint16 key;
+        int count;
+        // the lower 16 bits of the ids, sorted, in an array chunk
+        QVector<quint16> values;
+        // BitmapWords words of 32 bits in a bitmap chunk
+        QVector<quint32> words;
+
+        bool isBitmap() const { return !words.isEmpty(); }
+        bool contains(quint16 value) const;
+    };
+
+    int findChunk(quint16 key) const;
+    static void toBitmap(Chunk &chunk);
+    static void toArray(Chunk &chunk);
+    static Chunk combine(const Chunk &a, const Chunk &b, Operation operation);
+    static ContactBitmap combine(const ContactBitmap &a, const ContactBitmap &b,
+                                 Operation operation);
+
+    // chunks sorted by key; none is empty
+    QVector<Chunk> mChunks;
+    int mCount;
+};
+
+#endif // CONTACTBITMAP_H
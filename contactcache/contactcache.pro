@@ -0,0 +1,64 @@
+PROJECT_NAME = meego-contact-cache
+
+TEMPLATE = app
+TARGET = meego-contact-cache
+QT += dbus
+CONFIG += qt \
+        mobility \
+        link_pkgconfig
+
+PKGCONFIG += QtVersit
+
+MOBILITY = contacts versit
+
+OBJECTS_DIR = .obj
+MOC_DIR = .moc
+
+# the contact store and its indexes are shared with the application
+INCLUDEPATH += ..
+DEPENDPATH += ..
+
+HEADERS += \
+    contactcachelayout.h \
+    contactcacheservice.h \
+    ../accountindex.h \
+    ../birthdayindex.h \
+    ../contactbackup.h \
+    ../contactbitmap.h \
+    ../contactstore.h \
+    ../contacttrace.h \
+    ../dialpadindex.h \
+    ../fieldindex.h \
+    ../groupindex.h \
+    ../frecencyindex.h \
+    ../searchindex.h \
+    ../startuptimeline.h \
+    ../stringpool.h \
+    ../vcardimporter.h
+
+SOURCES += \
+    main.cpp \
+    contactcacheservice.cpp \
+    ../accountindex.cpp \
+    ../birthdayindex.cpp \
+    ../contactbackup.cpp \
+    ../contactbitmap.cpp \
+    ../contactstore.cpp \
+    ../contacttrace.cpp \
+    ../dialpadindex.cpp \
+    ../fieldindex.cpp \
+    ../groupindex.cpp \
+    ../frecencyindex.cpp \
+    ../searchindex.cpp \
+    ../startuptimeline.cpp \
+    ../stringpool.cpp \
+    ../vcardimporter.cpp
+
+target.path += $$INSTALL_ROOT/usr/bin
+
+dbusservice.files += com.meego.ContactCache.service
+dbusservice.path += $$INSTALL_ROOT/usr/share/dbus-1/services
+
+INSTALLS += target dbusservice
+
+OTHER_FILES += contactcacheclient.pri
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QDebug>
+
+#include <QSet>
+#include <QDBusMessage>
+#include <QDBusReply>
+
+#include "contactcacheclient.h"
+#include "contactcachelayout.h"
+#include "searchindex.h"
+
+using namespace ContactCacheLayout;
+
+// first key in [begin, end) not less than target
+static const Key *lowerBound(const Key *begin, const Key *end, const char *pool,
+                             const QString &target)
+{
+    while (begin < end) {
+        const Key *middle = begin + (end - begin) / 2;
+        if (readString(pool, middle->key) < target)
+            begin = middle + 1;
+        else
+            end = middle;
+    }
+    return begin;
+}
+
+ContactCacheClient::ContactCacheClient(const QDBusConnection &connection, QObject *parent)
+    : QObject(parent), mConnection(connection), mData(0)
+{
+    mConnection.connect(ServiceName, ObjectPath, InterfaceName, "Changed",
+                        this, SLOT(onChanged(uint, QString)));
+    mConnection.connect(ServiceName, ObjectPath, InterfaceName, "ImportQueueAvailable",
+                        this, SIGNAL(importQueueAvailable()));
+
+    // the only blocking call; afterwards the daemon tells us about changes
+    QDBusMessage call = QDBusMessage::createMethodCall(ServiceName, ObjectPath,
+                                                       InterfaceName, "SegmentKey");
+    QDBusReply<QString> reply = mConnection.call(call);
+    if (reply.isValid())
+        attach(reply.value());
+    else
+        qWarning() << Q_FUNC_INFO << "contact cache not available:" << reply.error().message();
+}
+
+ContactCacheClient::~ContactCacheClient()
+{
+    mSegment.detach();
+}
+
+bool ContactCacheClient::isAvailable() const
+{
+    return mData != 0;
+}
+
+uint ContactCacheClient::generation() const
+{
+    if (!mData)
+        return 0;
+    return reinterpret_cast<const Header *>(mData)->generation;
+}
+
+void ContactCacheClient::onChanged(uint generation, const QString &segmentKey)
+{
+    qDebug() << Q_FUNC_INFO << "moving to generation" << generation;
+    attach(segmentKey);
+    emit changed();
+}
+
+/*! Moves to the segment \a segmentKey, releasing the previous one.
+ */
+bool ContactCacheClient::attach(const QString &segmentKey)
+{
+    if (mSegment.isAttached())
+        mSegment.detach();
+    mData = 0;
+
+    if (segmentKey.isEmpty())
+        return false;
+
+    mSegment.setKey(segmentKey);
+    if (!mSegment.attach(QSharedMemory::ReadOnly)) {
+        qWarning() << Q_FUNC_INFO << "failed to attach to" << segmentKey
+                   << mSegment.errorString();
+        return false;
+    }
+
+    const char *data = static_cast<const char *>(mSegment.constData());
+    const Header *header = reinterpret_cast<const Header *>(data);
+    if (mSegment.size() < int(sizeof(Header)) || header->magic != Magic
+        || header->version != Version || int(header->size) > mSegment.size()) {
+        qWarning() << Q_FUNC_INFO << "segment" << segmentKey << "is not a contact cache";
+        mSegment.detach();
+        return false;
+    }
+
+    mData = data;
+    return true;
+}
+
+QVariantMap ContactCacheClient::record(quint32 index) const
+{
+    const Header *header = reinterpret_cast<const Header *>(mData);
+    const Record *record = reinterpret_cast<const Record *>(mData + header->recordsOffset) + index;
+    const char *pool = mData + header->stringsOffset;
+
+    QVariantMap map;
+    map.insert("uuid", readString(pool, record->uuid));
+    map.insert("firstname", readString(pool, record->firstName));
+    map.insert("lastname", readString(pool, record->lastName));
+    map.insert("company", readString(pool, record->company));
+    map.insert("favorite", bool(record->flags & Favorite));
+    map.insert("self", bool(record->flags & Self));
+    return map;
+}
+
+/*! Returns the contact owning \a number. Numbers match when one ends
+ * with the other, so a caller id carrying a country code finds a number
+ * saved without one and vice versa.
+ */
+QVariantMap ContactCacheClient::lookupPhoneNumber(const QString &number) const
+{
+    QString digits = phoneDigits(number);
+    if (!mData || digits.isEmpty())
+        return QVariantMap();
+
+    const Header *header = reinterpret_cast<const Header *>(mData);
+    const Key *begin = reinterpret_cast<const Key *>(mData + header->phonesOffset);
+    const Key *end = begin + header->phoneCount;
+    const char *pool = mData + header->stringsOffset;
+
+    QString key = phoneKey(digits);
+    for (const Key *it = lowerBound(begin, end, pool, key); it != end; ++it) {
+        if (readString(pool, it->key) != key)
+            break;
+
+        QString value = readString(pool, it->value);
+        if (value.endsWith(digits) || digits.endsWith(value))
+            return record(it->record);
+    }
+    return QVariantMap();
+}
+
+QVariantMap ContactCacheClient::lookupEmailAddress(const QString &address) const
+{
+    if (!mData || address.isEmpty())
+        return QVariantMap();
+
+    const Header *header = reinterpret_cast<const Header *>(mData);
+    const Key *begin = reinterpret_cast<const Key *>(mData + header->emailsOffset);
+    const Key *end = begin + header->emailCount;
+    const char *pool = mData + header->stringsOffset;
+
+    QString key = address.toCaseFolded();
+    const Key *it = lowerBound(begin, end, pool, key);
+    if (it != end && readString(pool, it->key) == key)
+        return record(it->record);
+    return QVariantMap();
+}
+
+/*! Returns at most \a limit contacts whose first name, last name or
+ * company starts with \a prefix, ignoring case and accents.
+ */
+QVariantList ContactCacheClient::complete(const QString &prefix, int limit) const
+{
+    QVariantList matches;
+    QString key = SearchIndex::fold(prefix);
+    if (!mData || key.isEmpty())
+        return matches;
+
+    const Header *header = reinterpret_cast<const Header *>(mData);
+    const Key *begin = reinterpret_cast<const Key *>(mData + header->namesOffset);
+    const Key *end = begin + header->nameCount;
+    const char *pool = mData + header->stringsOffset;
+
+    QSet<quint32> seen;
+    for (const Key *it = lowerBound(begin, end, pool, key);
+         it != end && matches.size() < limit; ++it) {
+        if (!readString(pool, it->key).startsWith(key))
+            break;
+        if (seen.contains(it->record))
+            continue;
+
+        seen.insert(it->record);
+        matches << record(it->record);
+    }
+    return matches;
+}
+
+void ContactCacheClient::setFavorite(const QString &uuid, bool favorite)
+{
+    QDBusMessage call = QDBusMessage::createMethodCall(ServiceName, ObjectPath,
+                                                       InterfaceName, "SetFavorite");
+    call << uuid << favorite;
+    mConnection.asyncCall(call);
+}
+
+void ContactCacheClient::deleteContact(const QString &uuid)
+{
+    QDBusMessage call = QDBusMessage::createMethodCall(ServiceName, ObjectPath,
+                                                       InterfaceName, "DeleteContact");
+    call << uuid;
+    mConnection.asyncCall(call);
+}
+
+/*! Hands the vCard file \a fileName to the cache for import. Returns
+ * false if the cache refused it because its queue is full; try again
+ * after importQueueAvailable(). The call only waits for the file to be
+ * queued, not for the import.
+ */
+bool ContactCacheClient::importFile(const QString &fileName)
+{
+    QDBusMessage call = QDBusMessage::createMethodCall(ServiceName, ObjectPath,
+                                                       InterfaceName, "ImportFile");
+    call << fileName;
+    QDBusReply<bool> reply = mConnection.call(call);
+    return reply.isValid() && reply.value();
+}
+
+/*! Like importFile(), for vCards received in memory.
+ */
+bool ContactCacheClient::importData(const QByteArray &data)
+{
+    QDBusMessage call = QDBusMessage::createMethodCall(ServiceName, ObjectPath,
+                                                       InterfaceName, "ImportData");
+    call << data;
+    QDBusReply<bool> reply = mConnection.call(call);
+    return reply.isValid() && reply.value();
+}
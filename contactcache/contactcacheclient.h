@@ -0,0 +1,64 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef CONTACTCACHECLIENT_H
+#define CONTACTCACHECLIENT_H
+
+#include <QObject>
+#include <QSharedMemory>
+#include <QVariantMap>
+#include <QDBusConnection>
+
+/*! Looks up contacts in the segment published by the contact cache.
+ *
+ * Meant to be compiled into the dialer, SMS, email and MMS applications.
+ * Lookups read the shared memory segment directly; only following the
+ * cache to a new segment and writes go over D-Bus. Every lookup returns
+ * a map with uuid, firstname, lastname, company, favorite and self keys,
+ * or an empty map if nothing matches.
+ */
+class ContactCacheClient: public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ContactCacheClient(const QDBusConnection &connection = QDBusConnection::sessionBus(),
+                                QObject *parent = 0);
+    virtual ~ContactCacheClient();
+
+    bool isAvailable() const;
+    uint generation() const;
+
+    Q_INVOKABLE QVariantMap lookupPhoneNumber(const QString &number) const;
+    Q_INVOKABLE QVariantMap lookupEmailAddress(const QString &address) const;
+    Q_INVOKABLE QVariantList complete(const QString &prefix, int limit = 10) const;
+
+    Q_INVOKABLE void setFavorite(const QString &uuid, bool favorite);
+    Q_INVOKABLE void deleteContact(const QString &uuid);
+    Q_INVOKABLE bool importFile(const QString &fileName);
+    Q_INVOKABLE bool importData(const QByteArray &data);
+
+signals:
+    void changed();
+    void importQueueAvailable();
+
+private slots:
+    void onChanged(uint generation, const QString &segmentKey);
+
+private:
+    bool attach(const QString &segmentKey);
+    QVariantMap record(quint32 index) const;
+
+    QDBusConnection mConnection;
+    QSharedMemory mSegment;
+    const char *mData;
+
+    Q_DISABLE_COPY(ContactCacheClient);
+};
+
+#endif // CONTACTCACHECLIENT_H
@@ -0,0 +1,18 @@
+# Include from the .pro of an application looking up contacts in the cache:
+#     include(/path/to/contactcache/contactcacheclient.pri)
+
+QT += dbus
+CONFIG += mobility
+MOBILITY += contacts
+
+INCLUDEPATH += $$PWD $$PWD/..
+DEPENDPATH += $$PWD $$PWD/..
+
+HEADERS += \
+    $$PWD/contactcacheclient.h \
+    $$PWD/contactcachelayout.h \
+    $$PWD/../searchindex.h
+
+SOURCES += \
+    $$PWD/contactcacheclient.cpp \
+    $$PWD/../searchindex.cpp
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef CONTACTCACHELAYOUT_H
+#define CONTACTCACHELAYOUT_H
+
+#include <QtGlobal>
+#include <QString>
+
+/*! Layout of the shared memory segment published by the contact cache.
+ *
+ * A segment is written once and never modified; every change to the
+ * contacts produces a new segment under a new key, announced over D-Bus.
+ * Readers therefore need no locking.
+ *
+ * The segment starts with a Header, followed by the record table, the
+ * phone, email and name key tables and the string pool. Offsets in the
+ * header are bytes from the start of the segment; string references are
+ * bytes from the start of the pool, where each string is stored as its
+ * length in UTF-16 code units followed by the code units, padded to four
+ * bytes. Key tables are sorted by key, so lookups are binary searches.
+ */
+namespace ContactCacheLayout
+{
+    const quint32 Magic = 0x43434d53; // "SMCC"
+    const quint32 Version = 1;
+
+    // where the daemon is found on the bus
+    const char * const ServiceName = "com.meego.ContactCache";
+    const char * const ObjectPath = "/ContactCache";
+    const char * const InterfaceName = "com.meego.ContactCache";
+
+    // phone numbers are matched on at most this many trailing digits,
+    // so that a caller id with or without a country code matches
+    const int PhoneKeyDigits = 7;
+
+    struct Header
+    {
+        quint32 magic;
+        quint32 version;
+        quint32 generation;
+        quint32 size;
+        quint32 recordCount;
+        quint32 recordsOffset;
+        quint32 phoneCount;
+        quint32 phonesOffset;
+        quint32 emailCount;
+        quint32 emailsOffset;
+        quint32 nameCount;
+        quint32 namesOffset;
+        quint32 stringsOffset;
+    };
+
+    enum RecordFlag {
+        Favorite = 0x1,
+        Self = 0x2
+    };
+
+    struct Record
+    {
+        quint32 localId;
+        quint32 uuid;
+        quint32 firstName;
+        quint32 lastName;
+        quint32 company;
+        quint32 flags;
+    };
+
+    // key is what the table is sorted and searched by; value is the
+    // complete phone number, address or name it was derived from
+    struct Key
+    {
+        quint32 key;
+        quint32 value;
+        quint32 record;
+    };
+
+    inline QString readString(const char *pool, quint32 ref)
+    {
+        const quint32 length = *reinterpret_cast<const quint32 *>(pool + ref);
+        return QString(reinterpret_cast<const QChar *>(pool + ref + sizeof(quint32)), length);
+    }
+
+    // the digits of a phone number, without spaces, dashes or a leading +
+    inline QString phoneDigits(const QString &number)
+    {
+        QString digits;
+        for (int i = 0; i < number.size(); i++) {
+            if (number.at(i).isDigit())
+                digits += number.at(i);
+        }
+        return digits;
+    }
+
+    inline QString phoneKey(const QString &digits)
+    {
+        return digits.right(PhoneKeyDigits);
+    }
+}
+
+#endif // CONTACTCACHELAYOUT_H
@@ -0,0 +1,330 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QDebug>
+
+#include <QCoreApplication>
+#include <QHash>
+#include <QContactEmailAddress>
+#include <QContactFavorite>
+#include <QContactName>
+#include <QContactOrganization>
+#include <QContactPhoneNumber>
+
+#include "contactcacheservice.h"
+#include "contactcachelayout.h"
+#include "contactstore.h"
+#include "searchindex.h"
+#include "vcardimporter.h"
+
+using namespace ContactCacheLayout;
+
+// store notifications are gathered for this long before a new segment
+// is written, so a sync burst does not produce a segment per batch
+static const int PublishDelayMs = 100;
+
+// a key table entry before it is written out
+struct PendingKey
+{
+    QString key;
+    QString value;
+    quint32 record;
+
+    bool operator<(const PendingKey &other) const { return key < other.key; }
+};
+
+// strings written to the pool, each stored once
+class ImageStrings
+{
+public:
+    quint32 add(const QString &str)
+    {
+        QHash<QString, quint32>::const_iterator it = mRefs.constFind(str);
+        if (it != mRefs.constEnd())
+            return it.value();
+
+        quint32 ref = mData.size();
+        quint32 length = str.size();
+        mData.append(reinterpret_cast<const char *>(&length), sizeof(length));
+        mData.append(reinterpret_cast<const char *>(str.constData()), length * sizeof(QChar));
+        while (mData.size() % sizeof(quint32))
+            mData.append('\0');
+
+        mRefs.insert(str, ref);
+        return ref;
+    }
+
+    const QByteArray &data() const { return mData; }
+
+private:
+    QByteArray mData;
+    QHash<QString, quint32> mRefs;
+};
+
+static void appendKeys(QByteArray &image, QList<PendingKey> &keys, ImageStrings &pool)
+{
+    qSort(keys);
+    foreach (const PendingKey &pending, keys) {
+        Key key;
+        key.key = pool.add(pending.key);
+        key.value = pool.add(pending.value);
+        key.record = pending.record;
+        image.append(reinterpret_cast<const char *>(&key), sizeof(key));
+    }
+}
+
+ContactCacheService::ContactCacheService(QObject *parent)
+    : QObject(parent), mSegment(0), mGeneration(0)
+{
+    mStore = ContactStore::acquire();
+    mImporter = new VCardImporter(mStore, this);
+    connect(mImporter, SIGNAL(queueAvailable()), this, SIGNAL(ImportQueueAvailable()));
+
+    mPublishTimer.setSingleShot(true);
+    mPublishTimer.setInterval(PublishDelayMs);
+    connect(&mPublishTimer, SIGNAL(timeout()), this, SLOT(publish()));
+
+    connect(mStore, SIGNAL(contactsReset()), this, SLOT(schedulePublish()));
+    connect(mStore, SIGNAL(contactsInserted(QList<QContactLocalId>)),
+            this, SLOT(schedulePublish()));
+    connect(mStore, SIGNAL(contactsUpdated(QList<QContactLocalId>)),
+            this, SLOT(schedulePublish()));
+    // the contacts are still in the store when this is emitted; the
+    // delay makes sure the segment is written once they are gone
+    connect(mStore, SIGNAL(contactsAboutToBeRemoved(QList<QContactLocalId>)),
+            this, SLOT(schedulePublish()));
+
+    if (mStore->isLoaded())
+        publish();
+}
+
+ContactCacheService::~ContactCacheService()
+{
+    // saves what has been imported while the store is still there
+    delete mImporter;
+    delete mSegment;
+    mStore->release();
+}
+
+QString ContactCacheService::serviceName()
+{
+    return QString::fromLatin1(ServiceName);
+}
+
+QString ContactCacheService::objectPath()
+{
+    return QString::fromLatin1(ObjectPath);
+}
+
+/*! Returns the key of the current shared memory segment, or an empty
+ * string before the contacts are loaded.
+ */
+QString ContactCacheService::SegmentKey() const
+{
+    return mSegment ? mSegment->key() : QString();
+}
+
+uint ContactCacheService::Generation() const
+{
+    return mGeneration;
+}
+
+bool ContactCacheService::SetFavorite(const QString &uuid, bool favorite)
+{
+    QContactLocalId id = mStore->idForUuid(uuid);
+    if (!mStore->contains(id)) {
+        qWarning() << Q_FUNC_INFO << "no contact with uuid" << uuid;
+        return false;
+    }
+
+    bool partial;
+    QContact contact = mStore->editableContact(id, &partial);
+
+    QContactFavorite fav = contact.detail<QContactFavorite>();
+    fav.setFavorite(favorite);
+    if (!contact.saveDetail(&fav)) {
+        qWarning() << Q_FUNC_INFO << "failed to save favorite";
+        return false;
+    }
+
+    if (partial)
+        mStore->saveContactPartially(contact);
+    else
+        mStore->saveContact(contact);
+    return true;
+}
+
+bool ContactCacheService::DeleteContact(const QString &uuid)
+{
+    QContactLocalId id = mStore->idForUuid(uuid);
+    if (!mStore->contains(id)) {
+        qWarning() << Q_FUNC_INFO << "no contact with uuid" << uuid;
+        return false;
+    }
+
+    if (mStore->isSelf(id)) {
+        qWarning() << Q_FUNC_INFO << "attempted to remove MeCard";
+        return false;
+    }
+
+    mStore->removeContact(id);
+    return true;
+}
+
+/*! Queues the vCard file \a fileName for import. Returns false if the
+ * file cannot be read or the queue is full.
+ */
+bool ContactCacheService::ImportFile(const QString &fileName)
+{
+    return mImporter->importFile(fileName);
+}
+
+/*! Queues the vCards in \a data for import. Returns false if the queue
+ * is full.
+ */
+bool ContactCacheService::ImportData(const QByteArray &data)
+{
+    return mImporter->importData(data);
+}
+
+void ContactCacheService::schedulePublish()
+{
+    if (!mPublishTimer.isActive())
+        mPublishTimer.start();
+}
+
+/*! Writes the contacts to a new segment and announces it. The previous
+ * segment is released; clients still attached to it keep it alive until
+ * they move on to the new one.
+ */
+void ContactCacheService::publish()
+{
+    mPublishTimer.stop();
+
+    mGeneration++;
+    QByteArray image = buildImage();
+
+    QString key = QString("meego-contact-cache-%1-%2")
+            .arg(QCoreApplication::applicationPid()).arg(mGeneration);
+    QSharedMemory *segment = new QSharedMemory(key, this);
+    if (!segment->create(image.size())) {
+        qWarning() << Q_FUNC_INFO << "failed to create segment" << key
+                   << segment->errorString();
+        delete segment;
+        return;
+    }
+
+    segment->lock();
+    memcpy(segment->data(), image.constData(), image.size());
+    segment->unlock();
+
+    delete mSegment;
+    mSegment = segment;
+
+    qDebug() << Q_FUNC_INFO << "published" << mStore->contactIds().size()
+             << "contacts in" << image.size() << "bytes as" << key;
+    emit Changed(mGeneration, key);
+}
+
+/*! Lays out the contacts of the store as described in ContactCacheLayout.
+ */
+QByteArray ContactCacheService::buildImage() const
+{
+    ImageStrings pool;
+    QByteArray records;
+    QList<PendingKey> phones;
+    QList<PendingKey> emails;
+    QList<PendingKey> names;
+
+    const QContactLocalId selfId = mStore->selfId();
+
+    quint32 index = 0;
+    foreach (const QContactLocalId &id, mStore->contactIds()) {
+        const QContact *contact = mStore->contact(id, false);
+        if (!contact)
+            continue;
+
+        QContactName name = contact->detail<QContactName>();
+        QString company = contact->detail<QContactOrganization>().name();
+
+        Record record;
+        record.localId = id;
+        record.uuid = pool.add(mStore->uuidForId(id).toString());
+        record.firstName = pool.add(name.firstName());
+        record.lastName = pool.add(name.lastName());
+        record.company = pool.add(company);
+        record.flags = 0;
+        if (mStore->isFavorite(id))
+            record.flags |= Favorite;
+        if (id == selfId)
+            record.flags |= Self;
+        records.append(reinterpret_cast<const char *>(&record), sizeof(record));
+
+        foreach (const QContactPhoneNumber &phone, contact->details<QContactPhoneNumber>()) {
+            PendingKey pending;
+            pending.value = phoneDigits(phone.number());
+            pending.key = phoneKey(pending.value);
+            pending.record = index;
+            if (!pending.key.isEmpty())
+                phones << pending;
+        }
+
+        foreach (const QContactEmailAddress &email, contact->details<QContactEmailAddress>()) {
+            PendingKey pending;
+            pending.value = email.emailAddress();
+            pending.key = pending.value.toCaseFolded();
+            pending.record = index;
+            if (!pending.key.isEmpty())
+                emails << pending;
+        }
+
+        // names are completed from the start of either name or the company
+        QStringList nameKeys;
+        nameKeys << (name.firstName() + " " + name.lastName()).trimmed()
+                 << (name.lastName() + " " + name.firstName()).trimmed()
+                 << company;
+        nameKeys.removeDuplicates();
+        foreach (const QString &nameKey, nameKeys) {
+            PendingKey pending;
+            pending.value = nameKey;
+            pending.key = SearchIndex::fold(nameKey);
+            pending.record = index;
+            if (!pending.key.isEmpty())
+                names << pending;
+        }
+
+        index++;
+    }
+
+    Header header;
+    header.magic = Magic;
+    header.version = Version;
+    header.generation = mGeneration;
+    header.size = 0;
+    header.recordCount = index;
+    header.recordsOffset = sizeof(Header);
+    header.phoneCount = phones.size();
+    header.phonesOffset = header.recordsOffset + records.size();
+    header.emailCount = emails.size();
+    header.emailsOffset = header.phonesOffset + phones.size() * sizeof(Key);
+    header.nameCount = names.size();
+    header.namesOffset = header.emailsOffset + emails.size() * sizeof(Key);
+    header.stringsOffset = header.namesOffset + names.size() * sizeof(Key);
+
+    QByteArray image;
+    image.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    image.append(records);
+    appendKeys(image, phones, pool);
+    appendKeys(image, emails, pool);
+    appendKeys(image, names, pool);
+    image.append(pool.data());
+
+    // the size is only known once the pool is complete
+    reinterpret_cast<Header *>(image.data())->size = image.size();
+    return image;
+}
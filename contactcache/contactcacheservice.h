@@ -0,0 +1,72 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef CONTACTCACHESERVICE_H
+#define CONTACTCACHESERVICE_H
+
+#include <QObject>
+#include <QSharedMemory>
+#include <QTimer>
+
+class ContactStore;
+class VCardImporter;
+
+/*! Publishes the contacts of a ContactStore for other processes.
+ *
+ * The list projection of every contact, with lookup tables by phone
+ * number, email address and name, is written to a read-only shared
+ * memory segment (see ContactCacheLayout), so that the dialer, SMS, email
+ * and MMS applications resolve caller ids and complete addresses without
+ * a D-Bus round trip per query. D-Bus only carries the Changed signal,
+ * sent whenever a new segment replaces the old one, and writes.
+ *
+ * Email and MMS hand received vCards to ImportFile() and ImportData().
+ * Both return false while the import queue is full; ImportQueueAvailable
+ * tells callers when to retry.
+ */
+class ContactCacheService: public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "com.meego.ContactCache")
+
+public:
+    explicit ContactCacheService(QObject *parent = 0);
+    virtual ~ContactCacheService();
+
+    static QString serviceName();
+    static QString objectPath();
+
+public slots:
+    Q_SCRIPTABLE QString SegmentKey() const;
+    Q_SCRIPTABLE uint Generation() const;
+    Q_SCRIPTABLE bool SetFavorite(const QString &uuid, bool favorite);
+    Q_SCRIPTABLE bool DeleteContact(const QString &uuid);
+    Q_SCRIPTABLE bool ImportFile(const QString &fileName);
+    Q_SCRIPTABLE bool ImportData(const QByteArray &data);
+
+signals:
+    Q_SCRIPTABLE void Changed(uint generation, const QString &segmentKey);
+    Q_SCRIPTABLE void ImportQueueAvailable();
+
+private slots:
+    void schedulePublish();
+    void publish();
+
+private:
+    QByteArray buildImage() const;
+
+    ContactStore *mStore;
+    VCardImporter *mImporter;
+    QSharedMemory *mSegment;
+    quint32 mGeneration;
+    QTimer mPublishTimer;
+
+    Q_DISABLE_COPY(ContactCacheService);
+};
+
+#endif // CONTACTCACHESERVICE_H
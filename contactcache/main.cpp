@@ -0,0 +1,66 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QDebug>
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QDBusConnection>
+
+#include "contactcacheservice.h"
+#include "contactstore.h"
+
+/*
+ * meego-contact-cache [--manager <name>] [--system]
+ *
+ * Serves the contact cache on the session bus, or with --system on the
+ * system bus. --manager picks the contact manager instead of tracker; to
+ * try the cache locally, run it with "--manager memory" on a session bus.
+ */
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    bool systemBus = false;
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); i++) {
+        if (args.at(i) == "--manager" && i + 1 < args.size()) {
+            ContactStore::setManagerName(args.at(++i));
+        } else if (args.at(i) == "--system") {
+            systemBus = true;
+        } else {
+            qWarning() << "usage:" << args.at(0) << "[--manager <name>] [--system]";
+            return 1;
+        }
+    }
+
+    // the ranking belongs to the application; the cache never writes it
+    ContactStore::setFrecencyPersistent(false);
+
+    QDBusConnection bus = systemBus ? QDBusConnection::systemBus()
+                                    : QDBusConnection::sessionBus();
+    if (!bus.isConnected()) {
+        qWarning() << "[ContactCache] cannot connect to the D-Bus daemon";
+        return 1;
+    }
+
+    ContactCacheService service;
+    if (!bus.registerObject(ContactCacheService::objectPath(), &service,
+                            QDBusConnection::ExportScriptableContents)) {
+        qWarning() << "[ContactCache] failed to register" << ContactCacheService::objectPath();
+        return 1;
+    }
+
+    if (!bus.registerService(ContactCacheService::serviceName())) {
+        qWarning() << "[ContactCache] failed to register" << ContactCacheService::serviceName()
+                   << bus.lastError().message();
+        return 1;
+    }
+
+    return app.exec();
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QStringList>
+
+#include "contactquery.h"
+#include "contactstore.h"
+#include "searchindex.h"
+
+// the words of text; quoted parts, as in city:"new york", are kept whole
+static QStringList splitWords(const QString &text)
+{
+    QStringList words;
+    QString word;
+    bool quoted = false;
+    foreach (const QChar &c, text) {
+        if (c == '"') {
+            quoted = !quoted;
+        } else if (c.isSpace() && !quoted) {
+            if (!word.isEmpty())
+                words << word;
+            word.clear();
+        } else {
+            word += c;
+        }
+    }
+    if (!word.isEmpty())
+        words << word;
+    return words;
+}
+
+// the field named before the colon of word, if any
+static bool fieldOf(const QString &word, FieldIndex::Field *field, QString *value)
+{
+    int colon = word.indexOf(':');
+    if (colon <= 0)
+        return false;
+
+    bool ok;
+    *field = FieldIndex::field(word.left(colon), &ok);
+    if (ok)
+        *value = word.mid(colon + 1);
+    return ok;
+}
+
+// fields whose tokens are single words
+static bool isWordField(FieldIndex::Field field)
+{
+    return field == FieldIndex::Name || field == FieldIndex::Company
+            || field == FieldIndex::City || field == FieldIndex::Country;
+}
+
+ContactQuery::ContactQuery()
+{
+}
+
+/*! Returns true if \a text uses field:value terms or OR, and should be
+ * parsed as a query rather than searched as it is.
+ */
+bool ContactQuery::isStructured(const QString &text)
+{
+    foreach (const QString &word, splitWords(text)) {
+        if (word == "OR" || word == "AND")
+            return true;
+
+        FieldIndex::Field field;
+        QString value;
+        if (fieldOf(word, &field, &value))
+            return true;
+    }
+    return false;
+}
+
+ContactQuery ContactQuery::parse(const QString &text, const SearchIndex &searchIndex)
+{
+    ContactQuery query;
+    Group group;
+
+    foreach (const QString &word, splitWords(text)) {
+        if (word == "AND")
+            continue;
+
+        if (word == "OR") {
+            if (!group.isEmpty())
+                query.mGroups << group;
+            group.clear();
+            continue;
+        }
+
+        FieldIndex::Field field;
+        QString value;
+        if (!fieldOf(word, &field, &value)) {
+            Term term = { -1, searchIndex.prepareQuery(word) };
+            if (!term.value.isEmpty())
+                group << term;
+            continue;
+        }
+
+        // city:"new york" needs both words, each a token of its own
+        QStringList values;
+        value = FieldIndex::prepareValue(field, value);
+        if (isWordField(field))
+            values = value.split(' ', QString::SkipEmptyParts);
+        else
+            values << value;
+
+        foreach (const QString &part, values) {
+            if (part.isEmpty())
+                continue;
+            Term term = { field, part };
+            group << term;
+        }
+    }
+
+    if (!group.isEmpty())
+        query.mGroups << group;
+    return query;
+}
+
+bool ContactQuery::isEmpty() const
+{
+    return mGroups.isEmpty();
+}
+
+/*! Returns the contacts of \a store matching the query. An alternative
+ * made only of plain words has nothing to look up and checks every
+ * contact, like the ordinary search does.
+ */
+QSet<QContactLocalId> ContactQuery::evaluate(const ContactStore &store) const
+{
+    QSet<QContactLocalId> result;
+    const FieldIndex &index = store.fieldIndex();
+
+    foreach (const Group &group, mGroups) {
+        // start from the field term matching the fewest contacts
+        int driver = -1;
+        int driverCount = 0;
+        for (int i = 0; i < group.size(); i++) {
+            if (group.at(i).field < 0)
+                continue;
+
+            int count = index.count(FieldIndex::Field(group.at(i).field), group.at(i).value);
+            if (driver < 0 || count < driverCount) {
+                driver = i;
+                driverCount = count;
+            }
+        }
+
+        QList<QContactLocalId> candidates;
+        if (driver >= 0)
+            candidates = index.lookup(FieldIndex::Field(group.at(driver).field),
+                                      group.at(driver).value);
+        else
+            candidates = store.contactIds();
+
+        foreach (const QContactLocalId &id, candidates) {
+            if (result.contains(id))
+                continue;
+
+            bool matched = true;
+            for (int i = 0; i < group.size() && matched; i++) {
+                if (i != driver)
+                    matched = termMatches(store, group.at(i), id);
+            }
+            if (matched)
+                result.insert(id);
+        }
+    }
+
+    return result;
+}
+
+bool ContactQuery::matches(const ContactStore &store, QContactLocalId id) const
+{
+    foreach (const Group &group, mGroups) {
+        bool matched = true;
+        foreach (const Term &term, group) {
+            if (!termMatches(store, term, id)) {
+                matched = false;
+                break;
+            }
+        }
+        if (matched)
+            return true;
+    }
+    return false;
+}
+
+bool ContactQuery::termMatches(const ContactStore &store, const Term &term,
+                               QContactLocalId id) const
+{
+    if (term.field < 0)
+        return store.searchIndex().matches(id, term.value);
+    return store.fieldIndex().matches(FieldIndex::Field(term.field), id, term.value);
+}
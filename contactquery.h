@@ -0,0 +1,61 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef CONTACTQUERY_H
+#define CONTACTQUERY_H
+
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QContact>
+
+#include "fieldindex.h"
+
+QTM_USE_NAMESPACE
+
+class ContactStore;
+class SearchIndex;
+
+/*! A search such as
+ *
+ *     company:acme city:"new york" OR is:favorite has:birthday
+ *
+ * Terms are field:value pairs or plain words, which match like the
+ * ordinary search. Adjacent terms must all match; OR separates
+ * alternatives. Queries are answered from the indexes of the store:
+ * each alternative starts from its rarest field term, counted in the
+ * FieldIndex, and only checks the other terms against the contacts
+ * found.
+ */
+class ContactQuery
+{
+public:
+    ContactQuery();
+
+    static bool isStructured(const QString &text);
+    static ContactQuery parse(const QString &text, const SearchIndex &searchIndex);
+
+    bool isEmpty() const;
+
+    QSet<QContactLocalId> evaluate(const ContactStore &store) const;
+    bool matches(const ContactStore &store, QContactLocalId id) const;
+
+private:
+    struct Term {
+        // a FieldIndex::Field, or -1 for a plain word
+        int field;
+        QString value;
+    };
+    typedef QList<Term> Group;
+
+    bool termMatches(const ContactStore &store, const Term &term, QContactLocalId id) const;
+
+    QList<Group> mGroups;
+};
+
+#endif // CONTACTQUERY_H
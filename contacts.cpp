@@ -12,9 +12,11 @@
 #include "peoplemodel.h"
 #include "proxymodel.h"
 #include "settingsdatastore.h"
+#include "startuptimeline.h"
 
 void contacts::registerTypes(const char *uri)
 {
+    StartupTimeline::begin("plugin");
     qmlRegisterType<PeopleModel>(uri, 0, 0, "PeopleModel");
     qmlRegisterType<ProxyModel>(uri, 0, 0, "ProxyModel");
 }
@@ -29,6 +31,7 @@ void contacts::initializeEngine(QDeclarativeEngine *engine, const char *uri)
 
     mRootContext->setContextProperty(QString::fromLatin1("settingsDataStore"),
                                       SettingsDataStore::self());
+    StartupTimeline::end("plugin");
 }
 
 Q_EXPORT_PLUGIN(contacts);
@@ -0,0 +1,1698 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QDebug>
+
+#include <QFileInfo>
+#include <QtConcurrentRun>
+#include <QImage>
+#include <QContactAddress>
+#include <QContactAvatar>
+#include <QContactBirthday>
+#include <QContactEmailAddress>
+#include <QContactFavorite>
+#include <QContactGuid>
+#include <QContactLocalIdFilter>
+#include <QContactName>
+#include <QContactOnlineAccount>
+#include <QContactOrganization>
+#include <QContactPhoneNumber>
+#include <QContactPresence>
+#include <QContactRemoveRequest>
+#include <QContactSaveRequest>
+#include <QContactUrl>
+
+#include "contactstore.h"
+#include "startuptimeline.h"
+
+// how long manager notifications are gathered before they are acted upon
+static const int NotificationWindowMs = 200;
+// upper bound on the number of ids fetched by a single request
+static const int MaxFetchBatchSize = 250;
+// default number of bytes spent on complete contacts kept for the detail view
+static const int DefaultMemoryBudget = 2 * 1024 * 1024;
+// number of contact cards kept ready for the list delegate
+static const int CardCacheSize = 512;
+// number of top ranked contacts shown by the Recent filter
+static const int RecentContactsCount = 20;
+// interactions are written out once they stop coming for this long
+static const int FrecencySaveDelayMs = 5000;
+// a failed load is retried this many times, after this long
+static const int MaxLoadRetries = 3;
+static const int LoadRetryDelayMs = 2000;
+
+ContactStore *ContactStore::mSelf = 0;
+QString ContactStore::mManagerName;
+bool ContactStore::mFrecencyPersistent = true;
+
+/*! Returns the details shown by the contact list; everything else is
+ * only needed by the detail and edit views and is fetched on demand.
+ */
+QStringList ContactStore::listDetailDefinitions()
+{
+    static QStringList definitions;
+    if (definitions.isEmpty()) {
+        definitions << QContactName::DefinitionName
+                    << QContactOrganization::DefinitionName
+                    << QContactFavorite::DefinitionName
+                    << QContactGuid::DefinitionName
+                    << QContactPresence::DefinitionName
+                    << QContactAvatar::DefinitionName
+                    << QContactBirthday::DefinitionName
+                    << QContactAddress::DefinitionName
+                    << QContactPhoneNumber::DefinitionName
+                    << QContactOnlineAccount::DefinitionName
+                    << QContactEmailAddress::DefinitionName
+                    << QContactUrl::DefinitionName;
+    }
+    return definitions;
+}
+
+// rough number of bytes held by a contact, used to charge the detail cache;
+// strings shared through the pool are charged to the pool instead
+static int estimatedContactSize(const QContact &contact, const StringPool &pool)
+{
+    int size = sizeof(QContact);
+    foreach (const QContactDetail &detail, contact.details()) {
+        size += 64;
+        QVariantMap values = detail.variantValues();
+        for (QVariantMap::const_iterator it = values.constBegin();
+             it != values.constEnd(); ++it) {
+            const QVariant &value = it.value();
+            size += 32;
+            switch (value.type()) {
+            case QVariant::String:
+                if (!pool.isInterned(value.toString()))
+                    size += 2 * value.toString().size();
+                break;
+            case QVariant::StringList:
+                foreach (const QString &str, value.toStringList())
+                    size += pool.isInterned(str) ? 8 : 16 + 2 * str.size();
+                break;
+            case QVariant::ByteArray:
+                size += value.toByteArray().size();
+                break;
+            case QVariant::Image:
+                size += value.value<QImage>().byteCount();
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    return size;
+}
+
+// detail fields taking few distinct values across the address book
+static const QSet<QString>& internedFields()
+{
+    static QSet<QString> fields;
+    if (fields.isEmpty()) {
+        fields << QContactDetail::FieldContext
+               << QContactPhoneNumber::FieldSubTypes
+               << QContactOnlineAccount::FieldServiceProvider
+               << QContactOnlineAccount::FieldProtocol
+               << QContactOrganization::FieldName
+               << QContactAddress::FieldLocality
+               << QContactAddress::FieldRegion
+               << QContactAddress::FieldCountry
+               << QContactAvatar::FieldImageUrl;
+    }
+    return fields;
+}
+
+// available beats busy; any other state is reported as unknown
+static int aggregatePresence(const QContact &contact)
+{
+    bool busy = false;
+    foreach (const QContactPresence& qp,
+             contact.details<QContactPresence>()) {
+        if (qp.presenceState() == QContactPresence::PresenceAvailable)
+            return QContactPresence::PresenceAvailable;
+        if (qp.presenceState() == QContactPresence::PresenceBusy)
+            busy = true;
+    }
+    return busy ? QContactPresence::PresenceBusy : QContactPresence::PresenceUnknown;
+}
+
+static QContact listProjection(const QContact &contact)
+{
+    QContact projection(contact);
+    const QStringList &definitions = ContactStore::listDetailDefinitions();
+    foreach (QContactDetail detail, contact.details()) {
+        if (!definitions.contains(detail.definitionName()))
+            projection.removeDetail(&detail);
+    }
+    return projection;
+}
+
+// runs on a pool thread during startup
+static FrecencyIndex loadFrecency(const QString &fileName)
+{
+    FrecencyIndex frecency;
+    frecency.load(fileName);
+    return frecency;
+}
+
+// helper function to check validity of sender and stuff.
+template<typename T> inline T *checkRequest(QObject *sender, QContactAbstractRequest::State requestState)
+{
+    qDebug() << Q_FUNC_INFO << "Request state: " << requestState;
+    T *request = qobject_cast<T *>(sender);
+    if (!request) {
+        qWarning() << Q_FUNC_INFO << "NULL request pointer";
+        return 0;
+    }
+
+    if (request->error() != QContactManager::NoError) {
+        qDebug() << Q_FUNC_INFO << "Error" << request->error()
+                 << "occurred during request!";
+        request->deleteLater();
+        return 0;
+    }
+
+    if (requestState != QContactAbstractRequest::FinishedState &&
+        requestState != QContactAbstractRequest::CanceledState)
+    {
+        // ignore
+        return 0;
+    }
+
+    return request;
+}
+
+/*! Returns the store, creating and loading it if this is the first user.
+ * Every call must be matched by a call to release().
+ */
+ContactStore *ContactStore::acquire()
+{
+    if (!mSelf)
+        mSelf = new ContactStore;
+    mSelf->mRefCount++;
+    return mSelf;
+}
+
+/*! Makes the store use the contact manager \a name instead of picking
+ * one. Only affects a store created after the call.
+ */
+void ContactStore::setManagerName(const QString& name)
+{
+    mManagerName = name;
+}
+
+/*! Sets whether the frecency ranking and the contact groups are loaded
+ * from and saved to disk. A process other than the application, such as
+ * the cache daemon, turns it off so it does not overwrite the
+ * application's ranking with its own.
+ * Only affects a store created after the call.
+ */
+void ContactStore::setFrecencyPersistent(bool persistent)
+{
+    mFrecencyPersistent = persistent;
+}
+
+void ContactStore::release()
+{
+    if (--mRefCount > 0)
+        return;
+
+    if (mFrecencySaveTimer.isActive())
+        saveFrecency();
+
+    if (mSelf == this)
+        mSelf = 0;
+    deleteLater();
+}
+
+ContactStore::ContactStore()
+    : mRefCount(0), mLoaded(false), mProjectionBytes(0), mNextProvisionalId(0xffffffffu),
+      mSelfId(0), mFetchGeneration(0),
+      mFetchesStarted(0), mFetchesSuperseded(0), mFetchesDiscarded(0), mLoadRetries(0)
+{
+    mListFetchHint.setDetailDefinitionsHint(listDetailDefinitions());
+    mCardCache.setMaxCost(CardCacheSize);
+
+    mSettings = new QSettings("MeeGo", "meego-app-contacts");
+    mFullContacts.setMaxCost(mSettings->value("MemoryBudget",
+                                              DefaultMemoryBudget).toInt());
+
+    // the ranking is read in the background while the manager, which
+    // connects to the backend, is created
+    QFuture<FrecencyIndex> frecency;
+    if (mFrecencyPersistent) {
+        mFrecencyFileName = QFileInfo(mSettings->fileName()).absolutePath()
+                + "/meego-app-contacts-recent.dat";
+        StartupTimeline::begin("frecency");
+        frecency = QtConcurrent::run(loadFrecency, mFrecencyFileName);
+    }
+
+    StartupTimeline::begin("manager");
+    QStringList managers = QContactManager::availableManagers();
+    qDebug() << Q_FUNC_INFO << managers;
+    if (!mManagerName.isEmpty()) {
+        mManager = new QContactManager(mManagerName);
+        qDebug() << "[ContactStore] Manager is" << mManagerName;
+    }
+    else if (managers.contains("tracker")) {
+        mManager = new QContactManager("tracker");
+        qDebug() << "[ContactStore] Manager is tracker";
+    }
+    else if (managers.contains("memory")) {
+        mManager = new QContactManager("memory");
+        qDebug() << "[ContactStore] Manager is memory";
+
+        qWarning() << Q_FUNC_INFO << "Only recognised tracker engine available is 'memory'";
+        qWarning() << Q_FUNC_INFO << "Changes to contacts WILL NOT be persistent!";
+
+    }else{
+        mManager = new QContactManager("default");
+        qDebug() << "[ContactStore] Manager is empty";
+    }
+
+    qDebug() << Q_FUNC_INFO << "Manager is " << mManager->managerName();
+    StartupTimeline::end("manager");
+
+    mDetailsTimer.setSingleShot(true);
+    mDetailsTimer.setInterval(0);
+    connect(&mDetailsTimer, SIGNAL(timeout()),
+            this, SLOT(fetchWantedDetails()));
+
+    mFrecencySaveTimer.setSingleShot(true);
+    mFrecencySaveTimer.setInterval(FrecencySaveDelayMs);
+    connect(&mFrecencySaveTimer, SIGNAL(timeout()),
+            this, SLOT(saveFrecency()));
+
+    mNotifyTimer.setSingleShot(true);
+    mNotifyTimer.setInterval(NotificationWindowMs);
+    connect(&mNotifyTimer, SIGNAL(timeout()),
+            this, SLOT(flushPendingNotifications()));
+
+    connect(mManager, SIGNAL(contactsAdded(QList<QContactLocalId>)),
+            this, SLOT(contactsAdded(QList<QContactLocalId>)));
+    connect(mManager, SIGNAL(contactsChanged(QList<QContactLocalId>)),
+            this, SLOT(contactsChanged(QList<QContactLocalId>)));
+    connect(mManager, SIGNAL(contactsRemoved(QList<QContactLocalId>)),
+            this, SLOT(contactsRemoved(QList<QContactLocalId>)));
+    connect(mManager, SIGNAL(dataChanged()), this, SLOT(dataReset()));
+    connect(mManager, SIGNAL(selfContactIdChanged(QContactLocalId, QContactLocalId)),
+            this, SLOT(setSelfId(QContactLocalId, QContactLocalId)));
+
+    // a trace requested through the environment covers startup as well
+    QByteArray traceFile = qgetenv("MEEGO_CONTACTS_TRACE");
+    if (!traceFile.isEmpty())
+        startTrace(QString::fromLocal8Bit(traceFile));
+
+    // the backend starts on the contacts first; everything else happens
+    // while they are being fetched
+    StartupTimeline::begin("listFetch");
+    dataReset();
+
+    if (mFrecencyPersistent) {
+        mFrecency = frecency.result();
+        StartupTimeline::end("frecency");
+
+        // the groups must be known before the first contacts arrive to
+        // bind to them
+        mGroupsFileName = QFileInfo(mSettings->fileName()).absolutePath()
+                + "/meego-app-contacts-groups.dat";
+        mGroupIndex.load(mGroupsFileName);
+    }
+    mRecentContacts = mFrecency.top(RecentContactsCount);
+
+    // asking for the self contact id is a synchronous backend call, so
+    // it waits for the event loop rather than holding up the caller
+    StartupTimeline::begin("meCard");
+    QTimer::singleShot(0, this, SLOT(checkMeCard()));
+}
+
+/*! Makes sure the self contact exists, creating it if the manager
+ * supports one.
+ */
+void ContactStore::checkMeCard()
+{
+    //MeCard feature not added yet
+    if (mManager->hasFeature(QContactManager::SelfContact, QContactType::TypeContact)) {
+        // self contact supported by manager - let's try fetch the me card
+        QContactManager::Error error(QContactManager::NoError);
+        const QContactLocalId meCardId(mManager->selfContactId());
+        setSelfId(mSelfId, meCardId);
+
+        //if we have a valid selfId
+        if ((error == QContactManager::NoError) && (meCardId != 0)) {
+            qDebug() << Q_FUNC_INFO << "valid selfId, error" << error << "id " << meCardId;
+            //check if contact with selfId exists
+            QContactLocalIdFilter idListFilter;
+            idListFilter.setIds(QList<QContactLocalId>() << meCardId);
+
+            QContactFetchRequest *meFetchRequest = new QContactFetchRequest(this);
+            connect(meFetchRequest,
+                    SIGNAL(stateChanged(QContactAbstractRequest::State)),
+                    SLOT(onMeFetchRequestStateChanged(QContactAbstractRequest::State)));
+            meFetchRequest->setFilter(idListFilter);
+            meFetchRequest->setManager(mManager);
+            if (meFetchRequest->start())
+                return;
+
+            qWarning() << Q_FUNC_INFO << "me card fetch failed";
+            delete meFetchRequest;
+        } else {
+            qWarning() << Q_FUNC_INFO << "no valid meCard Id provided";
+        }
+    } else {
+        qWarning() << Q_FUNC_INFO << "MeCard Not supported";
+    }
+
+    StartupTimeline::end("meCard");
+}
+
+ContactStore::~ContactStore()
+{
+    // requests still running are children of the store and go with it
+    qDeleteAll(findChildren<QContactAbstractRequest *>());
+    delete mManager;
+    delete mSettings;
+}
+
+QContactManager *ContactStore::manager() const
+{
+    return mManager;
+}
+
+QSettings *ContactStore::settings() const
+{
+    return mSettings;
+}
+
+/*! Returns true once the first complete load has finished.
+ */
+bool ContactStore::isLoaded() const
+{
+    return mLoaded;
+}
+
+const QList<QContactLocalId>& ContactStore::contactIds() const
+{
+    return mContactIds;
+}
+
+bool ContactStore::contains(QContactLocalId id) const
+{
+    return mContacts.contains(id);
+}
+
+/*! Returns the contact with \a id, or 0 if there is none. With
+ * \a needsDetails the complete contact is returned if cached; if not,
+ * it is requested and the list projection is returned meanwhile.
+ */
+const QContact *ContactStore::contact(QContactLocalId id, bool needsDetails) const
+{
+    const QContact *contact = 0;
+    if (needsDetails) {
+        contact = mFullContacts.object(id);
+        if (!contact)
+            requestDetails(id);
+    }
+
+    if (!contact) {
+        QMap<QContactLocalId, QContact>::const_iterator it = mContacts.constFind(id);
+        if (it != mContacts.constEnd())
+            contact = &it.value();
+    }
+
+    if (!contact || contact->isEmpty())
+        return 0;
+    return contact;
+}
+
+bool ContactStore::hasDetails(QContactLocalId id) const
+{
+    return mFullContacts.contains(id);
+}
+
+/*! Fetches the complete contact with \a id in the background, unless it
+ * is on its way already; detailsLoaded() is emitted once it is cached.
+ */
+void ContactStore::requestDetails(QContactLocalId id) const
+{
+    if (mDetailsInFlight.contains(id))
+        return;
+
+    mDetailsWanted.insert(id);
+    if (!mDetailsTimer.isActive())
+        mDetailsTimer.start();
+}
+
+/*! Returns the contact with \a id for modification: the complete contact
+ * when cached, else the list projection, in which case \a partial is set
+ * and the contact must only be saved through saveContactPartially().
+ */
+QContact ContactStore::editableContact(QContactLocalId id, bool *partial) const
+{
+    const QContact *full = mFullContacts.object(id);
+    *partial = (full == 0);
+    return full ? *full : mContacts.value(id);
+}
+
+QContactLocalId ContactStore::idForUuid(const QUuid& uuid) const
+{
+    return mUuidToId.value(uuid);
+}
+
+QUuid ContactStore::uuidForId(QContactLocalId id) const
+{
+    return mIdToUuid.value(id);
+}
+
+bool ContactStore::isSelf(QContactLocalId id) const
+{
+    return id != 0 && id == mSelfId;
+}
+
+/*! Returns the id of the self contact as last told by the manager, or 0
+ * if there is none or it is not known yet.
+ */
+QContactLocalId ContactStore::selfId() const
+{
+    return mSelfId;
+}
+
+/*! Moves the self contact from \a oldId to \a newId; both contacts are
+ * reported as updated, since they sort differently now.
+ */
+void ContactStore::setSelfId(QContactLocalId oldId, QContactLocalId newId)
+{
+    Q_UNUSED(oldId);
+    if (newId == mSelfId)
+        return;
+
+    // the cards of both show whether they are the self contact
+    QList<QContactLocalId> updated;
+    if (mContacts.contains(mSelfId))
+        updated << mSelfId;
+    if (mContacts.contains(newId))
+        updated << newId;
+    mCardCache.remove(mSelfId);
+    mCardCache.remove(newId);
+    mSelfId = newId;
+
+    if (!updated.isEmpty())
+        emit contactsUpdated(updated);
+}
+
+bool ContactStore::isFavorite(QContactLocalId id) const
+{
+    return mContacts.value(id).detail<QContactFavorite>().isFavorite();
+}
+
+int ContactStore::presence(QContactLocalId id) const
+{
+    return mPresence.value(id, QContactPresence::PresenceUnknown);
+}
+
+bool ContactStore::isOnline(QContactLocalId id) const
+{
+    return mPresence.contains(id);
+}
+
+const SearchIndex& ContactStore::searchIndex() const
+{
+    return mSearchIndex;
+}
+
+DialpadIndex& ContactStore::dialpadIndex()
+{
+    return mDialpadIndex;
+}
+
+const AccountIndex& ContactStore::accountIndex() const
+{
+    return mAccountIndex;
+}
+
+const BirthdayIndex& ContactStore::birthdayIndex() const
+{
+    return mBirthdayIndex;
+}
+
+const FieldIndex& ContactStore::fieldIndex() const
+{
+    return mFieldIndex;
+}
+
+const GroupIndex& ContactStore::groupIndex() const
+{
+    return mGroupIndex;
+}
+
+bool ContactStore::addGroup(const QString& group)
+{
+    if (!mGroupIndex.addGroup(group))
+        return false;
+
+    saveGroups();
+    emit groupsChanged();
+    return true;
+}
+
+bool ContactStore::removeGroup(const QString& group)
+{
+    if (!mGroupIndex.removeGroup(group))
+        return false;
+
+    saveGroups();
+    emit groupsChanged();
+    return true;
+}
+
+/*! Adds \a contactIds to \a group, creating it if needed. Contacts
+ * without a uuid cannot be remembered and are left out.
+ */
+void ContactStore::addToGroup(const QString& group, const QList<QContactLocalId>& contactIds)
+{
+    if (group.isEmpty())
+        return;
+
+    mGroupIndex.addGroup(group);
+    foreach (const QContactLocalId& id, contactIds) {
+        QUuid uuid = mIdToUuid.value(id);
+        if (uuid.isNull())
+            qWarning() << Q_FUNC_INFO << "contact" << id << "has no uuid";
+        else
+            mGroupIndex.addMember(group, uuid, id);
+    }
+
+    saveGroups();
+    emit groupsChanged();
+}
+
+void ContactStore::removeFromGroup(const QString& group, const QList<QContactLocalId>& contactIds)
+{
+    foreach (const QContactLocalId& id, contactIds)
+        mGroupIndex.removeMember(group, mIdToUuid.value(id), id);
+
+    saveGroups();
+    emit groupsChanged();
+}
+
+const FrecencyIndex& ContactStore::frecency() const
+{
+    return mFrecency;
+}
+
+bool ContactStore::isRecent(QContactLocalId id) const
+{
+    return mRecentContacts.contains(mIdToUuid.value(id));
+}
+
+const QVariantMap *ContactStore::card(QContactLocalId id) const
+{
+    return mCardCache.object(id);
+}
+
+void ContactStore::cacheCard(QContactLocalId id, const QVariantMap& card) const
+{
+    mCardCache.insert(id, new QVariantMap(card));
+}
+
+void ContactStore::recordInteraction(const QUuid& uuid, int interaction)
+{
+    if (uuid.isNull())
+        return;
+
+    mFrecency.record(uuid, FrecencyIndex::Interaction(interaction));
+    mFrecencySaveTimer.start();
+    updateRecentContacts(uuid);
+}
+
+/*! Refreshes the cached top contacts after an interaction with \a uuid,
+ * announcing every contact whose score or membership changed.
+ */
+void ContactStore::updateRecentContacts(const QUuid& uuid)
+{
+    QList<QUuid> recent = mFrecency.top(RecentContactsCount);
+
+    QList<QUuid> changed;
+    changed << uuid;
+    foreach (const QUuid& other, recent) {
+        if (!mRecentContacts.contains(other) && !changed.contains(other))
+            changed << other;
+    }
+    foreach (const QUuid& other, mRecentContacts) {
+        if (!recent.contains(other) && !changed.contains(other))
+            changed << other;
+    }
+
+    mRecentContacts = recent;
+
+    QList<QContactLocalId> updated;
+    foreach (const QUuid& other, changed) {
+        QMap<QUuid, QContactLocalId>::const_iterator id = mUuidToId.constFind(other);
+        if (id != mUuidToId.constEnd())
+            updated << id.value();
+    }
+
+    if (!updated.isEmpty())
+        emit contactsUpdated(updated);
+}
+
+void ContactStore::saveFrecency()
+{
+    mFrecencySaveTimer.stop();
+    if (!mFrecencyFileName.isEmpty())
+        mFrecency.save(mFrecencyFileName);
+}
+
+/*! Starts recording manager notifications and the contacts fetched in
+ * response to \a fileName, beginning with the contacts held now; see
+ * ContactTrace. Setting MEEGO_CONTACTS_TRACE to a file name records
+ * from startup.
+ */
+bool ContactStore::startTrace(const QString& fileName)
+{
+    if (!mTrace.start(fileName))
+        return false;
+
+    if (mLoaded) {
+        QList<QContact> contacts;
+        foreach (const QContactLocalId& id, mContactIds)
+            contacts << mContacts.value(id);
+        mTrace.record(ContactTrace::Snapshot, contacts);
+    }
+    return true;
+}
+
+void ContactStore::stopTrace()
+{
+    mTrace.stop();
+}
+
+void ContactStore::saveGroups()
+{
+    if (!mGroupsFileName.isEmpty())
+        mGroupIndex.save(mGroupsFileName);
+}
+
+/*! Keeps the list projection of \a contact resident and indexed. If
+ * \a contact is \a complete, as fetched without a hint or saved without a
+ * definition mask, it also replaces the cached complete contact. A list
+ * hint fetch may bring details beyond the hint, but never all of them, so
+ * it is not cached; any cached copy is then stale and dropped.
+ */
+void ContactStore::storeContact(const QContact &fetched, bool complete)
+{
+    QContact contact(fetched);
+    internStrings(contact);
+
+    QContactLocalId id = contact.localId();
+    QContact projection = listProjection(contact);
+
+    QMap<QContactLocalId, QContact>::iterator it = mContacts.find(id);
+    if (it != mContacts.end()) {
+        mProjectionBytes -= estimatedContactSize(it.value(), mStrings);
+        it.value() = projection;
+    } else {
+        mContacts.insert(id, projection);
+    }
+    mProjectionBytes += estimatedContactSize(projection, mStrings);
+    mCardCache.remove(id);
+
+    QContactGuid guid = projection.detail<QContactGuid>();
+    if (!guid.isEmpty()) {
+        QUuid uuid(guid.guid());
+        QUuid previous = mIdToUuid.value(id);
+        if (previous != uuid) {
+            mUuidToId.remove(previous);
+            // the contact was given a new guid; what was kept under the
+            // old one follows it
+            if (!previous.isNull() && mGroupIndex.rename(previous, uuid)) {
+                saveGroups();
+                emit groupsChanged();
+            }
+            if (!previous.isNull() && mFrecency.rename(previous, uuid)) {
+                mFrecencySaveTimer.start();
+                mRecentContacts = mFrecency.top(RecentContactsCount);
+            }
+        }
+        mUuidToId.insert(uuid, id);
+        mIdToUuid.insert(id, uuid);
+        mGroupIndex.bind(uuid, id);
+    }
+    mGroupIndex.setFavorite(id, projection.detail<QContactFavorite>().isFavorite());
+
+    int presence = aggregatePresence(projection);
+    if (presence == QContactPresence::PresenceUnknown)
+        mPresence.remove(id);
+    else
+        mPresence.insert(id, presence);
+
+    mSearchIndex.insert(id, projection);
+    mDialpadIndex.insert(id, projection);
+    mAccountIndex.insert(id, projection);
+    mBirthdayIndex.insert(id, projection);
+    mFieldIndex.insert(id, projection, mPresence.contains(id));
+
+    if (complete)
+        mFullContacts.insert(id, new QContact(contact), estimatedContactSize(contact, mStrings));
+    else
+        mFullContacts.remove(id);
+}
+
+/*! Makes the repetitive detail values of \a contact share the copies
+ * held by the string pool.
+ */
+void ContactStore::internStrings(QContact &contact)
+{
+    const QSet<QString> &fields = internedFields();
+    foreach (QContactDetail detail, contact.details()) {
+        bool changed = false;
+        QVariantMap values = detail.variantValues();
+        for (QVariantMap::const_iterator it = values.constBegin();
+             it != values.constEnd(); ++it) {
+            if (!fields.contains(it.key()))
+                continue;
+
+            const QVariant &value = it.value();
+            switch (value.type()) {
+            case QVariant::String:
+                if (!mStrings.isInterned(value.toString())) {
+                    detail.setValue(it.key(), mStrings.intern(value.toString()));
+                    changed = true;
+                }
+                break;
+            case QVariant::StringList:
+                detail.setValue(it.key(), mStrings.intern(value.toStringList()));
+                changed = true;
+                break;
+            case QVariant::Url:
+                detail.setValue(it.key(), mStrings.intern(value.toUrl()));
+                changed = true;
+                break;
+            default:
+                break;
+            }
+        }
+
+        if (changed)
+            contact.saveDetail(&detail);
+    }
+}
+
+/*! Returns how much the string pool saves: the number of pooled strings
+ * and the bytes they take, the number of detail values sharing them, and
+ * the bytes and percentage of memoryUsage() saved by the sharing.
+ */
+QVariantMap ContactStore::internStatistics() const
+{
+    const QSet<QString> &fields = internedFields();
+    int references = 0;
+    int sharedBytes = 0;
+
+    QList<const QContact *> contacts;
+    for (QMap<QContactLocalId, QContact>::const_iterator it = mContacts.constBegin();
+         it != mContacts.constEnd(); ++it)
+        contacts << &it.value();
+    foreach (const QContactLocalId &id, mFullContacts.keys())
+        contacts << mFullContacts.object(id);
+
+    foreach (const QContact *contact, contacts) {
+        foreach (const QContactDetail &detail, contact->details()) {
+            QVariantMap values = detail.variantValues();
+            for (QVariantMap::const_iterator it = values.constBegin();
+                 it != values.constEnd(); ++it) {
+                if (!fields.contains(it.key()))
+                    continue;
+
+                QStringList strings;
+                if (it.value().type() == QVariant::StringList)
+                    strings = it.value().toStringList();
+                else if (it.value().type() == QVariant::String)
+                    strings << it.value().toString();
+
+                foreach (const QString &str, strings) {
+                    if (mStrings.isInterned(str)) {
+                        references++;
+                        sharedBytes += StringPool::stringBytes(str);
+                    }
+                }
+            }
+        }
+    }
+
+    int saved = qMax(0, sharedBytes - mStrings.bytes());
+    int unshared = memoryUsage() + saved;
+
+    QVariantMap stats;
+    stats.insert("strings", mStrings.size());
+    stats.insert("poolBytes", mStrings.bytes());
+    stats.insert("references", references);
+    stats.insert("bytesSaved", saved);
+    stats.insert("percentSaved", unshared > 0 ? 100.0 * saved / unshared : 0.0);
+    return stats;
+}
+
+void ContactStore::addContacts(const QList<QContact>& contacts)
+{
+    foreach (const QContact &contact, contacts) {
+        qDebug() << Q_FUNC_INFO << "Adding contact " << contact.id() << " local " << contact.localId();
+        mContactIds.append(contact.localId());
+        storeContact(contact, false);
+    }
+}
+
+/*! Drops the data kept for \a id, except its place in mContactIds, and
+ * returns its uuid.
+ */
+QUuid ContactStore::forgetContact(QContactLocalId id)
+{
+    mProjectionBytes -= estimatedContactSize(mContacts.take(id), mStrings);
+    mFullContacts.remove(id);
+    mCardCache.remove(id);
+    mPresence.remove(id);
+    mSearchIndex.remove(id);
+    mDialpadIndex.remove(id);
+    mAccountIndex.remove(id);
+    mBirthdayIndex.remove(id);
+    mFieldIndex.remove(id);
+    mProvisional.remove(id);
+
+    // a provisional contact shares its uuid with the real one
+    QUuid uuid = mIdToUuid.take(id);
+    if (!uuid.isNull() && mUuidToId.value(uuid) == id)
+        mUuidToId.remove(uuid);
+    mGroupIndex.unbind(uuid, id);
+    return uuid;
+}
+
+/*! Drops \a contactIds and everything known about them, after telling
+ * the models.
+ */
+void ContactStore::dropContacts(const QList<QContactLocalId>& contactIds)
+{
+    QList<QContactLocalId> removed;
+    foreach (const QContactLocalId& id, contactIds) {
+        if (mContacts.contains(id))
+            removed << id;
+    }
+
+    if (removed.isEmpty())
+        return;
+
+    emit contactsAboutToBeRemoved(removed);
+
+    QSet<QContactLocalId> removedSet;
+    bool groupsChanged = false;
+    foreach (const QContactLocalId& id, removed) {
+        removedSet.insert(id);
+
+        QUuid uuid = forgetContact(id);
+        if (uuid.isNull() || mUuidToId.contains(uuid))
+            continue;
+
+        if (mFrecency.contains(uuid)) {
+            mFrecency.remove(uuid);
+            mFrecencySaveTimer.start();
+        }
+        if (!mGroupIndex.groupsOf(uuid).isEmpty()) {
+            mGroupIndex.forget(uuid, id);
+            groupsChanged = true;
+        }
+    }
+    if (groupsChanged)
+        saveGroups();
+
+    QList<QContactLocalId> remaining;
+    foreach (const QContactLocalId& id, mContactIds) {
+        if (!removedSet.contains(id))
+            remaining << id;
+    }
+    mContactIds = remaining;
+
+    emit memoryUsageChanged();
+}
+
+void ContactStore::fetchWantedDetails()
+{
+    QList<QContactLocalId> ids = mDetailsWanted.toList();
+    mDetailsWanted.clear();
+    mDetailsInFlight.unite(ids.toSet());
+
+    fetchContactBatches(ids, SLOT(onDetailsFetchChanged(QContactAbstractRequest::State)),
+                        QContactFetchHint());
+}
+
+void ContactStore::onDetailsFetchChanged(QContactAbstractRequest::State requestState)
+{
+    // the details of a failed fetch may be asked for again
+    if (QContactFetchRequest *failed = failedFetch(sender(), requestState)) {
+        QContactLocalIdFilter filter(failed->filter());
+        foreach (const QContactLocalId& id, filter.ids())
+            mDetailsInFlight.remove(id);
+    }
+
+    QContactFetchRequest *fetchRequest = checkRequest<QContactFetchRequest>(sender(), requestState);
+    if (!fetchRequest || !isCurrentFetch(fetchRequest, requestState))
+        return;
+
+    QContactLocalIdFilter filter(fetchRequest->filter());
+    foreach (const QContactLocalId& id, filter.ids())
+        mDetailsInFlight.remove(id);
+
+    foreach (QContact contact, fetchRequest->contacts()) {
+        if (!mContacts.contains(contact.localId()))
+            continue;
+
+        internStrings(contact);
+        mFullContacts.insert(contact.localId(), new QContact(contact),
+                             estimatedContactSize(contact, mStrings));
+        emit detailsLoaded(contact.localId());
+    }
+
+    emit memoryUsageChanged();
+    fetchRequest->deleteLater();
+}
+
+int ContactStore::memoryBudget() const
+{
+    return mFullContacts.maxCost();
+}
+
+void ContactStore::setMemoryBudget(int bytes)
+{
+    if (bytes == mFullContacts.maxCost())
+        return;
+
+    mFullContacts.setMaxCost(bytes);
+    mSettings->setValue("MemoryBudget", bytes);
+    emit memoryBudgetChanged();
+    emit memoryUsageChanged();
+}
+
+/*! Returns an estimate of the bytes held by the list projections of all
+ * contacts plus the cached complete contacts and the string pool.
+ */
+int ContactStore::memoryUsage() const
+{
+    return mProjectionBytes + mFullContacts.totalCost() + mStrings.bytes();
+}
+
+void ContactStore::contactsAdded(const QList<QContactLocalId>& contactIds)
+{
+    mTrace.record(ContactTrace::ContactsAdded, contactIds);
+    if (contactIds.size() == 0)
+        return;
+
+    foreach (const QContactLocalId& id, contactIds) {
+        if (mReconciled.remove(id))
+            continue;
+        if (mPendingRemoved.remove(id) || mContacts.contains(id)) {
+            // removed and re-added within the window, or already in the
+            // store: either way the contact just needs refreshing
+            mPendingChanged.insert(id);
+        } else {
+            mPendingAdded.insert(id);
+        }
+    }
+
+    if (!mNotifyTimer.isActive())
+        mNotifyTimer.start();
+}
+
+void ContactStore::contactsChanged(const QList<QContactLocalId>& contactIds)
+{
+    mTrace.record(ContactTrace::ContactsChanged, contactIds);
+    if (contactIds.size() == 0)
+        return;
+
+    foreach (const QContactLocalId& id, contactIds) {
+        // a created contact is up to date already, a pending add fetches
+        // the latest data anyway, and a pending removal makes the change
+        // irrelevant
+        if (mReconciled.remove(id))
+            continue;
+        if (mPendingAdded.contains(id) || mPendingRemoved.contains(id))
+            continue;
+        mPendingChanged.insert(id);
+    }
+
+    if (!mNotifyTimer.isActive())
+        mNotifyTimer.start();
+}
+
+void ContactStore::contactsRemoved(const QList<QContactLocalId>& contactIds)
+{
+    mTrace.record(ContactTrace::ContactsRemoved, contactIds);
+    qDebug() << Q_FUNC_INFO << "contacts removed:" << contactIds;
+
+    foreach (const QContactLocalId& id, contactIds) {
+        mPendingChanged.remove(id);
+        mReconciled.remove(id);
+
+        // added and removed within the same window: the two cancel out
+        if (mPendingAdded.remove(id))
+            continue;
+
+        // an add fetch still in flight must not resurrect the contact
+        mAddsInFlight.remove(id);
+        mPendingRemoved.insert(id);
+    }
+
+    if (!mNotifyTimer.isActive())
+        mNotifyTimer.start();
+}
+
+void ContactStore::flushPendingNotifications()
+{
+    qDebug() << Q_FUNC_INFO << "added" << mPendingAdded.size()
+             << "changed" << mPendingChanged.size()
+             << "removed" << mPendingRemoved.size();
+
+    if (!mPendingRemoved.isEmpty()) {
+        dropContacts(mPendingRemoved.toList());
+        mPendingRemoved.clear();
+    }
+
+    if (!mPendingAdded.isEmpty()) {
+        mAddsInFlight.unite(mPendingAdded);
+        fetchContactBatches(mPendingAdded.toList(),
+                            SLOT(onAddedFetchChanged(QContactAbstractRequest::State)),
+                            mListFetchHint);
+        mPendingAdded.clear();
+    }
+
+    if (!mPendingChanged.isEmpty()) {
+        fetchContactBatches(mPendingChanged.toList(),
+                            SLOT(onChangedFetchChanged(QContactAbstractRequest::State)),
+                            mListFetchHint);
+        mPendingChanged.clear();
+    }
+}
+
+/*! Fetches \a contactIds in requests of at most MaxFetchBatchSize ids,
+ * restricted by \a fetchHint, reporting each request's state changes
+ * to \a slot.
+ */
+void ContactStore::fetchContactBatches(const QList<QContactLocalId>& contactIds,
+                                       const char *slot,
+                                       const QContactFetchHint& fetchHint)
+{
+    for (int i = 0; i < contactIds.size(); i += MaxFetchBatchSize) {
+        QContactLocalIdFilter filter;
+        filter.setIds(contactIds.mid(i, MaxFetchBatchSize));
+
+        QContactFetchRequest *fetchRequest = new QContactFetchRequest(this);
+        fetchRequest->setManager(mManager);
+        connect(fetchRequest,
+                SIGNAL(stateChanged(QContactAbstractRequest::State)),
+                slot);
+        fetchRequest->setFilter(filter);
+        fetchRequest->setFetchHint(fetchHint);
+        qDebug() << Q_FUNC_INFO << "Fetching" << filter.ids().size() << "contacts";
+
+        if (!fetchRequest->start()) {
+            qWarning() << Q_FUNC_INFO << "Fetch request failed";
+            delete fetchRequest;
+            continue;
+        }
+        trackFetch(fetchRequest);
+    }
+}
+
+void ContactStore::onAddedFetchChanged(QContactAbstractRequest::State requestState)
+{
+    if (QContactFetchRequest *failed = failedFetch(sender(), requestState)) {
+        qWarning() << Q_FUNC_INFO << "cannot fetch added contacts:" << failed->error();
+        QContactLocalIdFilter filter(failed->filter());
+        foreach (const QContactLocalId& id, filter.ids())
+            mAddsInFlight.remove(id);
+    }
+
+    QContactFetchRequest *fetchRequest = checkRequest<QContactFetchRequest>(sender(), requestState);
+    if (!fetchRequest || !isCurrentFetch(fetchRequest, requestState))
+        return;
+
+    mTrace.record(ContactTrace::FetchResult, fetchRequest->contacts());
+
+    QList<QContact> addedContactsList;
+    QList<QContactLocalId> addedIds;
+    foreach (const QContact &contact, fetchRequest->contacts()) {
+        // skip contacts removed while the fetch was running, or that
+        // another batch already brought into the store
+        if (mAddsInFlight.remove(contact.localId())
+            && !mContacts.contains(contact.localId())) {
+            addedContactsList.append(contact);
+            addedIds.append(contact.localId());
+        }
+    }
+
+    // forget ids the backend did not return
+    QContactLocalIdFilter filter(fetchRequest->filter());
+    foreach (const QContactLocalId& id, filter.ids())
+        mAddsInFlight.remove(id);
+
+    if (!addedContactsList.isEmpty()) {
+        addContacts(addedContactsList);
+        emit contactsInserted(addedIds);
+    }
+
+    qDebug() << Q_FUNC_INFO << "Done updating store after adding"
+        << addedIds.size() << "contacts";
+    emit memoryUsageChanged();
+    fetchRequest->deleteLater();
+}
+
+void ContactStore::onChangedFetchChanged(QContactAbstractRequest::State requestState)
+{
+    QContactFetchRequest *fetchRequest = checkRequest<QContactFetchRequest>(sender(), requestState);
+    if (!fetchRequest || !isCurrentFetch(fetchRequest, requestState))
+        return;
+
+    mTrace.record(ContactTrace::FetchResult, fetchRequest->contacts());
+
+    QList<QContactLocalId> changedIds;
+    foreach (const QContact &changedContact, fetchRequest->contacts()) {
+        qDebug() << Q_FUNC_INFO << "Fetched changed contact " << changedContact.id();
+
+        // removed from the store while the fetch was running
+        if (!mContacts.contains(changedContact.localId()))
+            continue;
+
+        storeContact(changedContact, false);
+        changedIds.append(changedContact.localId());
+    }
+
+    if (!changedIds.isEmpty())
+        emit contactsUpdated(changedIds);
+
+    qDebug() << Q_FUNC_INFO << "Done updating store after contacts update";
+    emit memoryUsageChanged();
+    fetchRequest->deleteLater();
+}
+
+void ContactStore::dataReset()
+{
+    qDebug() << Q_FUNC_INFO << "data reset";
+    if (sender() == mManager)
+        mTrace.record(ContactTrace::DataChanged, QList<QContactLocalId>());
+
+    // everything still in flight is superseded by the full fetch below,
+    // as are notifications that have not been acted upon yet
+    mFetchGeneration++;
+    foreach (const QPointer<QContactFetchRequest>& request, mActiveFetches) {
+        if (request && request->isActive()) {
+            request->cancel();
+            mFetchesSuperseded++;
+        }
+    }
+    mActiveFetches.clear();
+
+    mNotifyTimer.stop();
+    mPendingAdded.clear();
+    mPendingChanged.clear();
+    mPendingRemoved.clear();
+    mAddsInFlight.clear();
+    mReconciled.clear();
+    mDetailsWanted.clear();
+    mDetailsInFlight.clear();
+
+    QContactFetchRequest *fetchRequest = new QContactFetchRequest(this);
+    fetchRequest->setManager(mManager);
+    connect(fetchRequest,
+            SIGNAL(stateChanged(QContactAbstractRequest::State)),
+            SLOT(onDataResetFetchChanged(QContactAbstractRequest::State)));
+    fetchRequest->setFetchHint(mListFetchHint);
+
+    if (!fetchRequest->start()) {
+        qWarning() << Q_FUNC_INFO << "Fetch request failed";
+        delete fetchRequest;
+        return;
+    }
+    trackFetch(fetchRequest);
+}
+
+/*! Stamps \a fetchRequest with the current generation so that a later
+ * reset can supersede it.
+ */
+void ContactStore::trackFetch(QContactFetchRequest *fetchRequest)
+{
+    fetchRequest->setProperty("generation", mFetchGeneration);
+    mActiveFetches.append(fetchRequest);
+    mFetchesStarted++;
+}
+
+/*! Returns true if the results of \a fetchRequest may be applied to
+ * the store; cancelled and superseded requests are disposed of here.
+ */
+bool ContactStore::isCurrentFetch(QContactFetchRequest *fetchRequest,
+                                  QContactAbstractRequest::State requestState)
+{
+    mActiveFetches.removeAll(fetchRequest);
+
+    if (requestState == QContactAbstractRequest::CanceledState) {
+        fetchRequest->deleteLater();
+        return false;
+    }
+
+    if (fetchRequest->property("generation").toInt() != mFetchGeneration) {
+        qDebug() << Q_FUNC_INFO << "Dropping results of a superseded fetch";
+        mFetchesDiscarded++;
+        fetchRequest->deleteLater();
+        return false;
+    }
+
+    return true;
+}
+
+/*! Returns the request behind \a sender if it is a fetch of the current
+ * generation that finished with an error. checkRequest() disposes of
+ * such a request, so this is asked first to let go of what it was for.
+ */
+QContactFetchRequest *ContactStore::failedFetch(QObject *sender,
+                                                QContactAbstractRequest::State requestState) const
+{
+    QContactFetchRequest *fetchRequest = qobject_cast<QContactFetchRequest *>(sender);
+    if (!fetchRequest || requestState != QContactAbstractRequest::FinishedState
+        || fetchRequest->error() == QContactManager::NoError
+        || fetchRequest->property("generation").toInt() != mFetchGeneration)
+        return 0;
+    return fetchRequest;
+}
+
+QVariantMap ContactStore::fetchStatistics() const
+{
+    QVariantMap stats;
+    stats.insert("started", mFetchesStarted);
+    stats.insert("superseded", mFetchesSuperseded);
+    stats.insert("discarded", mFetchesDiscarded);
+    stats.insert("wasted", mFetchesSuperseded + mFetchesDiscarded);
+    return stats;
+}
+
+void ContactStore::onDataResetFetchChanged(QContactAbstractRequest::State requestState)
+{
+    // the store is not marked loaded with no contacts, which the cache
+    // daemon would publish; the load is retried instead
+    if (QContactFetchRequest *failed = failedFetch(sender(), requestState)) {
+        qWarning() << Q_FUNC_INFO << "cannot load contacts:" << failed->error();
+        if (!mLoaded) {
+            StartupTimeline::end("listFetch");
+            StartupTimeline::finish();
+        }
+        if (mLoadRetries++ < MaxLoadRetries)
+            QTimer::singleShot(LoadRetryDelayMs, this, SLOT(dataReset()));
+    }
+
+    QContactFetchRequest *fetchRequest = checkRequest<QContactFetchRequest>(sender(), requestState);
+    if (!fetchRequest || !isCurrentFetch(fetchRequest, requestState))
+        return;
+
+    qDebug() << Q_FUNC_INFO << "Starting store reset";
+    mTrace.record(ContactTrace::Snapshot, fetchRequest->contacts());
+
+    mContactIds.clear();
+    mContacts.clear();
+    mProvisional.clear();
+    mUuidToId.clear();
+    mIdToUuid.clear();
+    mFullContacts.clear();
+    mCardCache.clear();
+    mPresence.clear();
+    mSearchIndex.clear();
+    mDialpadIndex.clear();
+    mAccountIndex.clear();
+    mBirthdayIndex.clear();
+    mFieldIndex.clear();
+    mGroupIndex.clearIds();
+    mProjectionBytes = 0;
+
+    addContacts(fetchRequest->contacts());
+    bool firstLoad = !mLoaded;
+    mLoaded = true;
+    mLoadRetries = 0;
+
+    if (firstLoad) {
+        StartupTimeline::end("listFetch");
+        StartupTimeline::begin("modelReset");
+    }
+
+    emit contactsReset();
+    emit memoryUsageChanged();
+    qDebug() << Q_FUNC_INFO << "Done with store reset";
+
+    if (firstLoad) {
+        StartupTimeline::end("modelReset");
+        StartupTimeline::finish();
+    }
+    fetchRequest->deleteLater();
+}
+
+/*! Saves \a contact. A contact already in the store is updated right
+ * away rather than when the manager reports the change.
+ */
+void ContactStore::saveContact(const QContact& contact)
+{
+    // this covers our QContactManager being slow at informing us about saves
+    // with the slight problem that our data may be a little inconsistent if
+    // the QContactManager decides to save differently from what we asked
+    // it to - but this is ok, because the save request finishing will fix that.
+    if (isProvisional(contact.localId())) {
+        qWarning() << Q_FUNC_INFO << "contact" << contact.localId() << "is still being created";
+        return;
+    }
+
+    if (contact.localId() && mContacts.contains(contact.localId())) {
+        qDebug() << Q_FUNC_INFO << "Faked save for " << contact.localId();
+        storeContact(contact, true);
+        emit contactsUpdated(QList<QContactLocalId>() << contact.localId());
+    } else if (!contact.localId()) {
+        insertProvisional(contact);
+    }
+
+    startSaveRequest(QList<QContact>() << contact, QStringList());
+}
+
+/*! Shows the new \a contact right away, under a provisional id from the
+ * top of the id range, until its save request tells the real one. The
+ * contact is found again by its guid; without one it only appears once
+ * the backend reports it.
+ */
+void ContactStore::insertProvisional(const QContact& contact)
+{
+    QContactGuid guid = contact.detail<QContactGuid>();
+    if (guid.isEmpty())
+        return;
+
+    QContactId contactId;
+    contactId.setManagerUri(mManager->managerUri());
+    contactId.setLocalId(mNextProvisionalId--);
+
+    QContact provisional(contact);
+    provisional.setId(contactId);
+    mProvisional.insert(contactId.localId());
+    mContactIds.append(contactId.localId());
+    storeContact(provisional, true);
+
+    qDebug() << Q_FUNC_INFO << "Provisional" << contactId.localId() << "for" << guid.guid();
+    emit contactsInserted(QList<QContactLocalId>() << contactId.localId());
+    emit memoryUsageChanged();
+}
+
+/*! Returns true if \a id is the provisional id of a contact still being
+ * created.
+ */
+bool ContactStore::isProvisional(QContactLocalId id) const
+{
+    return mProvisional.contains(id);
+}
+
+/*! Gives the provisional contacts of the finished \a saveRequest their
+ * real ids, or drops them if they could not be saved. Returns the real
+ * ids of those reconciled, which need no further update.
+ */
+QSet<QContactLocalId> ContactStore::resolveProvisional(QContactSaveRequest *saveRequest)
+{
+    QSet<QContactLocalId> reconciled;
+    if (mProvisional.isEmpty())
+        return reconciled;
+
+    QMap<int, QContactManager::Error> errors = saveRequest->errorMap();
+    QList<QContact> contacts = saveRequest->contacts();
+    QList<QContactLocalId> failed;
+    for (int i = 0; i < contacts.size(); i++) {
+        const QContact &saved = contacts.at(i);
+        QContactLocalId provisionalId = mUuidToId.value(QUuid(saved.detail<QContactGuid>().guid()));
+        if (!mProvisional.contains(provisionalId))
+            continue;
+
+        if (errors.contains(i) || !saved.localId()) {
+            qWarning() << Q_FUNC_INFO << "failed to create contact, dropping" << provisionalId;
+            failed << provisionalId;
+            continue;
+        }
+
+        QContactLocalId id = saved.localId();
+        qDebug() << Q_FUNC_INFO << "Provisional" << provisionalId << "is" << id;
+
+        // its data is right here, so there is no need to fetch it: drop the
+        // backend's notification if it came already, else skip it when it
+        // comes; a contact already in the store had its notification
+        // acted upon
+        bool notified = mPendingAdded.remove(id);
+        notified |= mAddsInFlight.remove(id);
+        if (!notified && !mContacts.contains(id))
+            mReconciled.insert(id);
+
+        if (mContacts.contains(id)) {
+            // the real contact made it into the store first
+            failed << provisionalId;
+        } else {
+            forgetContact(provisionalId);
+            mContactIds[mContactIds.indexOf(provisionalId)] = id;
+            emit contactIdChanged(provisionalId, id);
+        }
+
+        // new contacts are saved whole
+        storeContact(saved, true);
+        reconciled.insert(id);
+    }
+
+    dropContacts(failed);
+
+    if (!reconciled.isEmpty())
+        emit contactsUpdated(reconciled.toList());
+    return reconciled;
+}
+
+/*! Saves \a contact, which was modified starting from its list
+ * projection, without touching the details that were never loaded.
+ */
+void ContactStore::saveContactPartially(const QContact& contact)
+{
+    QStringList definitionMask = listDetailDefinitions();
+    foreach (const QContactDetail &detail, contact.details()) {
+        if (!definitionMask.contains(detail.definitionName()))
+            definitionMask << detail.definitionName();
+    }
+
+    saveContactDetails(QList<QContact>() << contact, definitionMask);
+}
+
+/*! Saves only the details named in \a definitionMask of existing
+ * \a contacts, with a single request. The contacts may be list
+ * projections. The models are updated at once, with one notification
+ * for all of them, rather than after the save.
+ */
+void ContactStore::saveContactDetails(const QList<QContact>& contacts,
+                                      const QStringList& definitionMask)
+{
+    if (contacts.isEmpty())
+        return;
+
+    QList<QContact> saved;
+    QList<QContactLocalId> updated;
+    foreach (const QContact &contact, contacts) {
+        if (isProvisional(contact.localId())) {
+            qWarning() << Q_FUNC_INFO << "contact" << contact.localId() << "is still being created";
+            continue;
+        }
+
+        saved << contact;
+        if (mContacts.contains(contact.localId())) {
+            qDebug() << Q_FUNC_INFO << "Faked save for " << contact.localId();
+            storeContact(contact, false);
+            updated << contact.localId();
+        }
+    }
+
+    if (!updated.isEmpty())
+        emit contactsUpdated(updated);
+
+    if (!saved.isEmpty())
+        startSaveRequest(saved, definitionMask);
+}
+
+/*! Saves new \a contacts with a single request.
+ */
+void ContactStore::saveContacts(const QList<QContact>& contacts)
+{
+    if (!contacts.isEmpty())
+        startSaveRequest(contacts, QStringList());
+}
+
+void ContactStore::startSaveRequest(const QList<QContact>& contacts,
+                                    const QStringList& definitionMask)
+{
+    QContactSaveRequest *saveRequest = new QContactSaveRequest(this);
+    connect(saveRequest,
+            SIGNAL(stateChanged(QContactAbstractRequest::State)),
+            SLOT(onSaveStateChanged(QContactAbstractRequest::State)));
+    saveRequest->setContacts(contacts);
+    saveRequest->setDefinitionMask(definitionMask);
+    saveRequest->setManager(mManager);
+
+    foreach (const QContact &contact, contacts)
+        qDebug() << Q_FUNC_INFO << "Saving " << contact.id();
+
+    if (!saveRequest->start()) {
+        qWarning() << Q_FUNC_INFO << "Save request failed: " << saveRequest->error();
+        delete saveRequest;
+    }
+}
+
+void ContactStore::onSaveStateChanged(QContactAbstractRequest::State requestState)
+{
+    // provisional contacts are settled whether the save worked or not
+    QSet<QContactLocalId> reconciled;
+    QContactSaveRequest *finished = qobject_cast<QContactSaveRequest *>(sender());
+    if (finished && (requestState == QContactAbstractRequest::FinishedState ||
+                     requestState == QContactAbstractRequest::CanceledState))
+        reconciled = resolveProvisional(finished);
+
+    QContactSaveRequest *saveRequest = checkRequest<QContactSaveRequest>(sender(), requestState);
+    if (!saveRequest)
+        return;
+
+    // only a save without a definition mask leaves the backend holding
+    // exactly the contact we gave it
+    bool complete = saveRequest->definitionMask().isEmpty();
+    QList<QContactLocalId> updated;
+    foreach (const QContact &new_contact, saveRequest->contacts()) {
+        qDebug() << Q_FUNC_INFO << "Successfully saved " << new_contact.id();
+
+        // make sure data shown to user matches what is
+        // really in the database
+        QContactLocalId id = new_contact.localId();
+        if (mContacts.contains(id) && !reconciled.contains(id)) {
+            storeContact(new_contact, complete);
+            updated << id;
+        }
+    }
+
+    if (!updated.isEmpty())
+        emit contactsUpdated(updated);
+
+    saveRequest->deleteLater();
+}
+
+/*! Removes the contact with \a id asynchronously.
+ */
+void ContactStore::removeContact(QContactLocalId id)
+{
+    removeContacts(QList<QContactLocalId>() << id);
+}
+
+/*! Removes \a contactIds asynchronously with a single request. The
+ * models drop their rows together once the backend reports the removal.
+ */
+void ContactStore::removeContacts(const QList<QContactLocalId>& ids)
+{
+    QList<QContactLocalId> contactIds;
+    foreach (const QContactLocalId& id, ids) {
+        if (isProvisional(id))
+            qWarning() << Q_FUNC_INFO << "contact" << id << "is still being created";
+        else
+            contactIds << id;
+    }
+
+    if (contactIds.isEmpty())
+        return;
+
+    QContactRemoveRequest *removeRequest = new QContactRemoveRequest(this);
+    removeRequest->setManager(mManager);
+    connect(removeRequest,
+            SIGNAL(stateChanged(QContactAbstractRequest::State)),
+            SLOT(onRemoveStateChanged(QContactAbstractRequest::State)));
+    removeRequest->setContactIds(contactIds);
+    qDebug() << Q_FUNC_INFO << "Removing " << contactIds;
+
+    if (!removeRequest->start()) {
+        qWarning() << Q_FUNC_INFO << "Remove request failed";
+        delete removeRequest;
+    }
+}
+
+void ContactStore::onRemoveStateChanged(QContactAbstractRequest::State requestState)
+{
+    QContactRemoveRequest *removeRequest = checkRequest<QContactRemoveRequest>(sender(), requestState);
+    if (!removeRequest)
+        return;
+
+    qDebug() << Q_FUNC_INFO << "Removed" << removeRequest->contactIds();
+    removeRequest->deleteLater();
+}
+
+// for Me card support
+void ContactStore::createMeCard()
+{
+  QContact contact;
+  QContactId contactId;
+  contactId.setLocalId(mSelfId);
+
+  qDebug() << Q_FUNC_INFO << "self contact does not exist, creating";
+  contact.setId(contactId);
+
+  QContactGuid guid;
+  guid.setGuid(QUuid::createUuid().toString());
+  if (!contact.saveDetail(&guid))
+    qWarning() << Q_FUNC_INFO << "failed to save guid in mecard contact";
+
+  QContactAvatar avatar;
+  avatar.setImageUrl(QUrl("image://theme/contacts/img_blankavatar"));
+  if (!contact.saveDetail(&avatar))
+      qWarning() << Q_FUNC_INFO << "failed to save avatar in mecard contact";
+
+  QContactName name;
+  name.setFirstName(QObject::tr(" Me","Default string to describe self if no self contact information found, default created with [Me] as firstname"));
+  name.setLastName("");
+  if (!contact.saveDetail(&name))
+    qWarning() << Q_FUNC_INFO << "failed to save mecard name";
+
+    QContactFavorite fav;
+    fav.setFavorite(false);
+    if (!contact.saveDetail(&fav))
+        qWarning() << "[ContactStore] failed to save mecard favorite to " << fav.isFavorite();
+
+  bool isSelf = true;
+  if (mSettings) {
+    QString key = guid.guid();
+    key += "/self";
+    mSettings->setValue(key, isSelf);
+  }
+
+  saveContact(contact);
+}
+
+// For Me card support
+void ContactStore::onMeFetchRequestStateChanged(QContactAbstractRequest::State requestState)
+{
+    if (requestState == QContactAbstractRequest::FinishedState ||
+        requestState == QContactAbstractRequest::CanceledState)
+        StartupTimeline::end("meCard");
+
+    QContactFetchRequest *fetchRequest = checkRequest<QContactFetchRequest>(sender(), requestState);
+    if (!fetchRequest)
+        return;
+
+    // Check if we need to save Me contact again
+    bool saveMe = false;
+
+    if (fetchRequest->contacts().size() == 0) {
+        qDebug() << Q_FUNC_INFO << "No Me contact, saving one";
+        saveMe = true;
+    } else {
+        const QContactName &name = fetchRequest->contacts()[0].detail<QContactName>();
+        if (name.firstName().isEmpty() || name.firstName().isNull()) {
+            qDebug() << Q_FUNC_INFO << "Empty value for Me contact; saving again";
+            saveMe = true;
+        }
+    }
+
+    if (saveMe)
+        createMeCard();
+
+    fetchRequest->deleteLater();
+}
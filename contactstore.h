@@ -0,0 +1,252 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef CONTACTSTORE_H
+#define CONTACTSTORE_H
+
+#include <QObject>
+#include <QList>
+#include <QMap>
+#include <QHash>
+#include <QSet>
+#include <QCache>
+#include <QPointer>
+#include <QSettings>
+#include <QTimer>
+#include <QUuid>
+#include <QVariantMap>
+#include <QContactManager>
+#include <QContactFetchRequest>
+#include <QContactSaveRequest>
+
+#include "accountindex.h"
+#include "birthdayindex.h"
+#include "contacttrace.h"
+#include "fieldindex.h"
+#include "groupindex.h"
+#include "frecencyindex.h"
+#include "searchindex.h"
+#include "dialpadindex.h"
+#include "stringpool.h"
+
+QTM_USE_NAMESPACE
+
+/*! Holds the contacts of the process, shared by every PeopleModel.
+ *
+ * The store owns the contact manager and its change notifications, the
+ * list projection of every contact, the cache of complete contacts and
+ * the lookup indexes. It is created by the first acquire() and destroyed
+ * by the last release(), so a model created while another exists starts
+ * out with all contacts loaded.
+ *
+ * Changes reach the models through the contacts* signals; contacts are
+ * still readable while contactsAboutToBeRemoved() is being emitted.
+ */
+class ContactStore: public QObject
+{
+    Q_OBJECT
+
+public:
+    static ContactStore *acquire();
+    void release();
+
+    static void setManagerName(const QString& name);
+    static void setFrecencyPersistent(bool persistent);
+
+    QContactManager *manager() const;
+    QSettings *settings() const;
+    bool isLoaded() const;
+
+    const QList<QContactLocalId>& contactIds() const;
+    bool contains(QContactLocalId id) const;
+    const QContact *contact(QContactLocalId id, bool needsDetails) const;
+    bool hasDetails(QContactLocalId id) const;
+    void requestDetails(QContactLocalId id) const;
+    QContact editableContact(QContactLocalId id, bool *partial) const;
+
+    QContactLocalId idForUuid(const QUuid& uuid) const;
+    QUuid uuidForId(QContactLocalId id) const;
+    bool isSelf(QContactLocalId id) const;
+    QContactLocalId selfId() const;
+    bool isFavorite(QContactLocalId id) const;
+    bool isProvisional(QContactLocalId id) const;
+    int presence(QContactLocalId id) const;
+    bool isOnline(QContactLocalId id) const;
+
+    const SearchIndex& searchIndex() const;
+    DialpadIndex& dialpadIndex();
+    const AccountIndex& accountIndex() const;
+    const BirthdayIndex& birthdayIndex() const;
+    const FieldIndex& fieldIndex() const;
+    const GroupIndex& groupIndex() const;
+
+    bool addGroup(const QString& group);
+    bool removeGroup(const QString& group);
+    void addToGroup(const QString& group, const QList<QContactLocalId>& contactIds);
+    void removeFromGroup(const QString& group, const QList<QContactLocalId>& contactIds);
+
+    const FrecencyIndex& frecency() const;
+    bool isRecent(QContactLocalId id) const;
+    void recordInteraction(const QUuid& uuid, int interaction);
+
+    const QVariantMap *card(QContactLocalId id) const;
+    void cacheCard(QContactLocalId id, const QVariantMap& card) const;
+
+    void saveContact(const QContact& contact);
+    void saveContactPartially(const QContact& contact);
+    void saveContacts(const QList<QContact>& contacts);
+    void saveContactDetails(const QList<QContact>& contacts, const QStringList& definitionMask);
+    void removeContact(QContactLocalId id);
+    void removeContacts(const QList<QContactLocalId>& contactIds);
+
+    int memoryBudget() const;
+    void setMemoryBudget(int bytes);
+    int memoryUsage() const;
+    QVariantMap fetchStatistics() const;
+    QVariantMap internStatistics() const;
+
+    bool startTrace(const QString& fileName);
+    void stopTrace();
+
+    static QStringList listDetailDefinitions();
+
+signals:
+    void contactsReset();
+    void contactsInserted(const QList<QContactLocalId>& contactIds);
+    void contactsUpdated(const QList<QContactLocalId>& contactIds);
+    void contactsAboutToBeRemoved(const QList<QContactLocalId>& contactIds);
+    void contactIdChanged(QContactLocalId oldId, QContactLocalId newId);
+    void groupsChanged();
+    void detailsLoaded(QContactLocalId id);
+    void memoryBudgetChanged();
+    void memoryUsageChanged();
+
+private slots:
+    void onSaveStateChanged(QContactAbstractRequest::State requestState);
+    void onRemoveStateChanged(QContactAbstractRequest::State requestState);
+    void onDataResetFetchChanged(QContactAbstractRequest::State requestState);
+    void onAddedFetchChanged(QContactAbstractRequest::State requestState);
+    void onChangedFetchChanged(QContactAbstractRequest::State requestState);
+    void onDetailsFetchChanged(QContactAbstractRequest::State requestState);
+    void onMeFetchRequestStateChanged(QContactAbstractRequest::State requestState);
+
+    void contactsAdded(const QList<QContactLocalId>& contactIds);
+    void contactsChanged(const QList<QContactLocalId>& contactIds);
+    void contactsRemoved(const QList<QContactLocalId>& contactIds);
+    void dataReset();
+    void flushPendingNotifications();
+    void fetchWantedDetails();
+    void saveFrecency();
+    void saveGroups();
+    void checkMeCard();
+    void createMeCard();
+    void setSelfId(QContactLocalId oldId, QContactLocalId newId);
+
+private:
+    ContactStore();
+    virtual ~ContactStore();
+
+    void fetchContactBatches(const QList<QContactLocalId>& contactIds, const char *slot,
+                             const QContactFetchHint& fetchHint);
+    void addContacts(const QList<QContact>& contacts);
+    void storeContact(const QContact& contact, bool complete);
+    void internStrings(QContact& contact);
+    void dropContacts(const QList<QContactLocalId>& contactIds);
+    QUuid forgetContact(QContactLocalId id);
+    void insertProvisional(const QContact& contact);
+    QSet<QContactLocalId> resolveProvisional(QContactSaveRequest *saveRequest);
+    void startSaveRequest(const QList<QContact>& contacts, const QStringList& definitionMask);
+    void trackFetch(QContactFetchRequest *fetchRequest);
+    bool isCurrentFetch(QContactFetchRequest *fetchRequest,
+                        QContactAbstractRequest::State requestState);
+    QContactFetchRequest *failedFetch(QObject *sender,
+                                      QContactAbstractRequest::State requestState) const;
+    void updateRecentContacts(const QUuid& uuid);
+
+    static ContactStore *mSelf;
+    static QString mManagerName;
+    static bool mFrecencyPersistent;
+    int mRefCount;
+
+    QContactManager *mManager;
+    QSettings *mSettings;
+    bool mLoaded;
+
+    // every contact in load order, and the list projection of each
+    QList<QContactLocalId> mContactIds;
+    QMap<QContactLocalId, QContact> mContacts;
+    QMap<QUuid, QContactLocalId> mUuidToId;
+    QMap<QContactLocalId, QUuid> mIdToUuid;
+    int mProjectionBytes;
+
+    // new contacts shown before their save finished, under ids counting
+    // down from the top of the range
+    QSet<QContactLocalId> mProvisional;
+    QContactLocalId mNextProvisionalId;
+    // asking the manager is a backend call, and sorting asks constantly
+    QContactLocalId mSelfId;
+    // created contacts whose data came with their save; the backend's
+    // notification for them, still to come, is ignored once
+    QSet<QContactLocalId> mReconciled;
+
+    // repetitive detail values of all contacts, stored once
+    StringPool mStrings;
+
+    // complete contacts live in an LRU cache bounded by a byte budget
+    QContactFetchHint mListFetchHint;
+    mutable QCache<QContactLocalId, QContact> mFullContacts;
+    mutable QSet<QContactLocalId> mDetailsWanted;
+    QSet<QContactLocalId> mDetailsInFlight;
+    mutable QTimer mDetailsTimer;
+
+    // roles of the list delegate, gathered per contact
+    mutable QCache<QContactLocalId, QVariantMap> mCardCache;
+
+    // aggregated presence of every contact that is not offline
+    QHash<QContactLocalId, int> mPresence;
+    SearchIndex mSearchIndex;
+    DialpadIndex mDialpadIndex;
+    AccountIndex mAccountIndex;
+    BirthdayIndex mBirthdayIndex;
+    FieldIndex mFieldIndex;
+
+    // named groups of contacts, saved next to the ranking
+    GroupIndex mGroupIndex;
+    QString mGroupsFileName;
+
+    // notifications recorded for replay, when asked for
+    ContactTrace mTrace;
+
+    // interactions with each contact, and the top ones for the Recent filter
+    FrecencyIndex mFrecency;
+    QList<QUuid> mRecentContacts;
+    QString mFrecencyFileName;
+    QTimer mFrecencySaveTimer;
+
+    // manager notifications gathered over a short window, so that a burst
+    // of small notifications during sync turns into a few batched fetches
+    QSet<QContactLocalId> mPendingAdded;
+    QSet<QContactLocalId> mPendingChanged;
+    QSet<QContactLocalId> mPendingRemoved;
+    QSet<QContactLocalId> mAddsInFlight;
+    QTimer mNotifyTimer;
+
+    // every fetch is stamped with the generation it was issued in; a
+    // reset bumps the generation, cancelling and discarding older fetches
+    int mFetchGeneration;
+    QList<QPointer<QContactFetchRequest> > mActiveFetches;
+    int mFetchesStarted;
+    int mFetchesSuperseded;
+    int mFetchesDiscarded;
+    // failed loads retried in a row
+    int mLoadRetries;
+
+    Q_DISABLE_COPY(ContactStore);
+};
+
+#endif // CONTACTSTORE_H
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QDebug>
+
+#include "contactbackup.h"
+#include "contacttrace.h"
+
+static const quint32 FileMagic = 0x43545243; // "CTRC"
+static const quint16 FileVersion = 1;
+
+ContactTrace::ContactTrace()
+{
+}
+
+ContactTrace::~ContactTrace()
+{
+    stop();
+}
+
+/*! Starts recording to \a fileName, replacing any trace there.
+ */
+bool ContactTrace::start(const QString &fileName)
+{
+    stop();
+
+    mFile.setFileName(fileName);
+    if (!mFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << Q_FUNC_INFO << "failed to write" << fileName;
+        return false;
+    }
+
+    mOut.setDevice(&mFile);
+    mOut.setVersion(QDataStream::Qt_4_7);
+    mOut << FileMagic << FileVersion;
+    mClock.start();
+    qDebug() << Q_FUNC_INFO << "recording notifications to" << fileName;
+    return true;
+}
+
+void ContactTrace::stop()
+{
+    if (!mFile.isOpen())
+        return;
+
+    mOut.setDevice(0);
+    mFile.close();
+}
+
+bool ContactTrace::isRecording() const
+{
+    return mFile.isOpen();
+}
+
+void ContactTrace::writeEventHeader(EventType type)
+{
+    mOut << qint64(mClock.nsecsElapsed() / 1000) << quint8(type);
+}
+
+void ContactTrace::record(EventType type, const QList<QContactLocalId> &ids)
+{
+    if (!mFile.isOpen())
+        return;
+
+    writeEventHeader(type);
+    mOut << ids;
+}
+
+/*! Records the \a contacts of a Snapshot or a FetchResult, without
+ * their avatar files.
+ */
+void ContactTrace::record(EventType type, const QList<QContact> &contacts)
+{
+    if (!mFile.isOpen())
+        return;
+
+    writeEventHeader(type);
+    mOut << quint32(contacts.size());
+    foreach (const QContact &contact, contacts) {
+        mOut << contact.localId();
+        ContactBackup::writeContact(mOut, contact, true);
+    }
+    mFile.flush();
+}
+
+/*! Returns the events of the trace \a fileName, in the order they were
+ * recorded. \a ok is set to false if the file is not a trace; a trace
+ * cut short, by a crash for instance, yields the events before the cut.
+ */
+QList<ContactTrace::Event> ContactTrace::load(const QString &fileName, bool *ok)
+{
+    QList<Event> events;
+    *ok = false;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << Q_FUNC_INFO << "failed to read" << fileName;
+        return events;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_4_7);
+
+    quint32 magic;
+    quint16 version;
+    in >> magic >> version;
+    if (magic != FileMagic || version != FileVersion) {
+        qWarning() << Q_FUNC_INFO << fileName << "is not a notification trace";
+        return events;
+    }
+
+    while (!in.atEnd() && in.status() == QDataStream::Ok) {
+        Event event;
+        quint8 type;
+        in >> event.time >> type;
+        event.type = EventType(type);
+
+        if (event.type == Snapshot || event.type == FetchResult) {
+            quint32 count;
+            in >> count;
+            for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+                QContactLocalId id;
+                QContact contact;
+                in >> id;
+                ContactBackup::readContact(in, &contact);
+                event.ids << id;
+                event.contacts << contact;
+            }
+        } else {
+            in >> event.ids;
+        }
+
+        if (in.status() != QDataStream::Ok) {
+            qWarning() << Q_FUNC_INFO << "truncated trace" << fileName;
+            break;
+        }
+        events << event;
+    }
+
+    *ok = true;
+    return events;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef CONTACTTRACE_H
+#define CONTACTTRACE_H
+
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+#include <QContact>
+
+QTM_USE_NAMESPACE
+
+/*! A recording of what a contact manager told a ContactStore: its
+ * notifications, with their timing, and the contacts the store fetched
+ * in response.
+ *
+ * Sync bursts that stall the application cannot be reproduced by hand;
+ * a trace recorded on the device can be replayed into the memory
+ * backend with meego-contacts-replay, as often as needed, to measure a
+ * fix against the same traffic.
+ *
+ * A trace starts with a Snapshot of the contacts held by the store, or
+ * of the first full fetch when recording from startup. Every event is
+ * stamped with the microseconds since recording started.
+ */
+class ContactTrace
+{
+public:
+    enum EventType {
+        Snapshot,
+        ContactsAdded,
+        ContactsChanged,
+        ContactsRemoved,
+        DataChanged,
+        FetchResult
+    };
+
+    struct Event {
+        qint64 time;
+        EventType type;
+        QList<QContactLocalId> ids;
+        QList<QContact> contacts;
+    };
+
+    ContactTrace();
+    ~ContactTrace();
+
+    bool start(const QString &fileName);
+    void stop();
+    bool isRecording() const;
+
+    void record(EventType type, const QList<QContactLocalId> &ids);
+    void record(EventType type, const QList<QContact> &contacts);
+
+    static QList<Event> load(const QString &fileName, bool *ok);
+
+private:
+    void writeEventHeader(EventType type);
+
+    QFile mFile;
+    QDataStream mOut;
+    QElapsedTimer mClock;
+
+    Q_DISABLE_COPY(ContactTrace);
+};
+
+#endif // CONTACTTRACE_H
@@ -0,0 +1,232 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QDebug>
+
+#include <QContactName>
+#include <QContactOrganization>
+#include <QContactPhoneNumber>
+#include <QContactFavorite>
+
+#include <string.h>
+
+#include "dialpadindex.h"
+#include "searchindex.h"
+
+// ITU E.161 letters for a - z
+static const char LatinKeys[] = "22233344455566677778889999";
+// the common Cyrillic layout for а - я
+static const char CyrillicKeys[] = "22223333444455556666777788889999";
+static const ushort CyrillicIo = 0x0451;
+
+// number matches rank after any name match
+static const int NumberPosition = 1 << 16;
+
+static char keyFor(QChar c)
+{
+    ushort u = c.unicode();
+    if (u >= '0' && u <= '9')
+        return char(u);
+    if (u >= 'a' && u <= 'z')
+        return LatinKeys[u - 'a'];
+    if (u >= 0x0430 && u <= 0x044F)
+        return CyrillicKeys[u - 0x0430];
+    if (u == CyrillicIo)
+        return '3';
+    return 0;
+}
+
+static void appendWord(QByteArray &words, const QByteArray &word)
+{
+    if (word.isEmpty())
+        return;
+    if (!words.isEmpty())
+        words += ' ';
+    words += word;
+}
+
+static bool hitLessThan(const DialpadIndex::Hit &left, const DialpadIndex::Hit &right)
+{
+    if (left.position != right.position)
+        return left.position < right.position;
+    return left.favorite && !right.favorite;
+}
+
+DialpadIndex::DialpadIndex()
+{
+}
+
+/*! Returns the keys spelling \a text, one space separated word for each
+ * word of it. Characters without a key are left out.
+ */
+QByteArray DialpadIndex::encode(const QString &text)
+{
+    QByteArray words;
+    bool inWord = false;
+
+    foreach (const QChar &c, SearchIndex::fold(text)) {
+        char key = keyFor(c);
+        if (key) {
+            if (!inWord && !words.isEmpty())
+                words += ' ';
+            words += key;
+            inWord = true;
+        } else if (!c.isLetter()) {
+            inWord = false;
+        }
+    }
+
+    return words;
+}
+
+void DialpadIndex::insert(QContactLocalId id, const QContact &contact)
+{
+    Entry entry;
+    entry.id = id;
+    entry.favorite = contact.detail<QContactFavorite>().isFavorite();
+
+    QContactName name = contact.detail<QContactName>();
+    QString first = name.firstName();
+    QString last = name.lastName();
+    QString company = contact.detail<QContactOrganization>().name();
+
+    entry.names = encode(first + " " + last + " " + company);
+
+    // "57" for John Smith
+    QByteArray initials;
+    foreach (const QByteArray &word, encode(first + " " + last).split(' ')) {
+        if (!word.isEmpty())
+            initials += word.at(0);
+    }
+    if (initials.size() > 1)
+        appendWord(entry.names, initials);
+
+    // Chinese and Japanese names are dialled by their readings
+    QString folded = SearchIndex::fold(last + first);
+    appendWord(entry.names, encode(SearchIndex::pinyinInitials(folded)));
+    QString reading = SearchIndex::romaji(folded);
+    if (reading != folded)
+        appendWord(entry.names, encode(reading));
+
+    foreach (const QContactPhoneNumber &phone, contact.details<QContactPhoneNumber>()) {
+        QByteArray digits;
+        foreach (const QChar &c, phone.number()) {
+            if (c.isDigit())
+                digits += char('0' + c.digitValue());
+        }
+        appendWord(entry.numbers, digits);
+    }
+
+    QHash<QContactLocalId, int>::const_iterator it = mPosition.constFind(id);
+    if (it != mPosition.constEnd()) {
+        mEntries[it.value()] = entry;
+    } else {
+        mEntries.append(entry);
+        mPosition.insert(id, mEntries.size() - 1);
+    }
+
+    invalidateResults();
+}
+
+void DialpadIndex::remove(QContactLocalId id)
+{
+    QHash<QContactLocalId, int>::iterator it = mPosition.find(id);
+    if (it == mPosition.end())
+        return;
+
+    int i = it.value();
+    mPosition.erase(it);
+
+    int last = mEntries.size() - 1;
+    if (i != last) {
+        mEntries[i] = mEntries.at(last);
+        mPosition[mEntries.at(i).id] = i;
+    }
+    mEntries.resize(last);
+
+    invalidateResults();
+}
+
+void DialpadIndex::clear()
+{
+    mEntries.clear();
+    mPosition.clear();
+    invalidateResults();
+}
+
+void DialpadIndex::invalidateResults()
+{
+    mLastKeys.clear();
+    mLastMatches.clear();
+}
+
+/*! Returns the contacts matching the dial pad \a keys, best first.
+ * Anything but digits in \a keys is ignored.
+ */
+QVector<DialpadIndex::Hit> DialpadIndex::search(const QString &keys)
+{
+    QByteArray digits;
+    foreach (const QChar &c, keys) {
+        if (c.isDigit())
+            digits += char('0' + c.digitValue());
+    }
+
+    QVector<Hit> hits;
+    if (digits.isEmpty()) {
+        invalidateResults();
+        return hits;
+    }
+
+    // a longer sequence can only match contacts the shorter one matched
+    bool narrowing = !mLastKeys.isEmpty() && digits.startsWith(mLastKeys);
+    int candidates = narrowing ? mLastMatches.size() : mEntries.size();
+    const char *wanted = digits.constData();
+    int length = digits.size();
+
+    QVector<int> matches;
+    for (int c = 0; c < candidates; c++) {
+        int i = narrowing ? mLastMatches.at(c) : c;
+        const Entry &entry = mEntries.at(i);
+
+        int position = -1;
+        const char *names = entry.names.constData();
+        int size = entry.names.size();
+        for (int start = 0; start + length <= size; ) {
+            if (memcmp(names + start, wanted, length) == 0) {
+                position = start;
+                break;
+            }
+            const char *space = static_cast<const char *>(memchr(names + start, ' ', size - start));
+            if (!space)
+                break;
+            start = space - names + 1;
+        }
+
+        if (position < 0) {
+            int at = entry.numbers.indexOf(digits);
+            if (at >= 0)
+                position = NumberPosition + at;
+        }
+
+        if (position < 0)
+            continue;
+
+        matches.append(i);
+        Hit hit;
+        hit.id = entry.id;
+        hit.position = position;
+        hit.favorite = entry.favorite;
+        hits.append(hit);
+    }
+
+    mLastKeys = digits;
+    mLastMatches = matches;
+
+    qStableSort(hits.begin(), hits.end(), hitLessThan);
+    return hits;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef DIALPADINDEX_H
+#define DIALPADINDEX_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QVector>
+#include <QContact>
+
+QTM_USE_NAMESPACE
+
+/*! Matches dial pad key sequences against contacts, e.g. "5646" against
+ * John.
+ *
+ * Names are stored as the keys that spell them, one word at a time, next
+ * to the digits of every phone number. A sequence matches a contact if it
+ * starts one of its name words or occurs in one of its numbers. Hits are
+ * ranked by where they match, names before numbers, favorites first.
+ * Typing one more key only searches the hits of the shorter sequence.
+ */
+class DialpadIndex
+{
+public:
+    struct Hit {
+        QContactLocalId id;
+        int position;
+        bool favorite;
+    };
+
+    DialpadIndex();
+
+    void insert(QContactLocalId id, const QContact &contact);
+    void remove(QContactLocalId id);
+    void clear();
+
+    QVector<Hit> search(const QString &keys);
+
+    static QByteArray encode(const QString &text);
+
+private:
+    struct Entry {
+        QContactLocalId id;
+        // keys of each name word, space separated
+        QByteArray names;
+        // digits of each phone number, space separated
+        QByteArray numbers;
+        bool favorite;
+    };
+
+    void invalidateResults();
+
+    QVector<Entry> mEntries;
+    QHash<QContactLocalId, int> mPosition;
+
+    // the previous search, narrowed further while keys are appended
+    QByteArray mLastKeys;
+    QVector<int> mLastMatches;
+};
+
+#endif // DIALPADINDEX_H
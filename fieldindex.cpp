@@ -0,0 +1,316 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QRegExp>
+#include <QSet>
+#include <QtAlgorithms>
+#include <QContactAddress>
+#include <QContactBirthday>
+#include <QContactEmailAddress>
+#include <QContactFavorite>
+#include <QContactName>
+#include <QContactOnlineAccount>
+#include <QContactOrganization>
+#include <QContactPhoneNumber>
+#include <QContactUrl>
+
+#include "fieldindex.h"
+#include "searchindex.h"
+
+// phone numbers are also found by their local part, without the prefixes
+static const int LocalPhoneDigits = 7;
+
+static void appendUnique(QStringList &tokens, const QString &token)
+{
+    if (!token.isEmpty() && !tokens.contains(token))
+        tokens << token;
+}
+
+// the folded words of text
+static void appendWords(QStringList &tokens, const QString &text)
+{
+    QString word;
+    foreach (const QChar &c, SearchIndex::fold(text)) {
+        if (c.isLetterOrNumber()) {
+            word += c;
+        } else {
+            appendUnique(tokens, word);
+            word.clear();
+        }
+    }
+    appendUnique(tokens, word);
+}
+
+static QString digitsOf(const QString &text)
+{
+    QString digits;
+    foreach (const QChar &c, text) {
+        if (c.isDigit())
+            digits += c;
+    }
+    return digits;
+}
+
+static QStringList fieldTokens(FieldIndex::Field field, const QContact &contact, bool online)
+{
+    QStringList tokens;
+
+    switch (field) {
+    case FieldIndex::Name: {
+        QContactName name = contact.detail<QContactName>();
+        appendWords(tokens, name.firstName());
+        appendWords(tokens, name.middleName());
+        appendWords(tokens, name.lastName());
+        appendWords(tokens, name.customLabel());
+        break;
+    }
+    case FieldIndex::Company:
+        foreach (const QContactOrganization &organization, contact.details<QContactOrganization>())
+            appendWords(tokens, organization.name());
+        break;
+    case FieldIndex::Email:
+        foreach (const QContactEmailAddress &email, contact.details<QContactEmailAddress>()) {
+            QString address = SearchIndex::fold(email.emailAddress().trimmed());
+            appendUnique(tokens, address);
+            int at = address.indexOf('@');
+            if (at >= 0) {
+                appendUnique(tokens, address.left(at));
+                appendUnique(tokens, address.mid(at));
+                appendUnique(tokens, address.mid(at + 1));
+            }
+        }
+        break;
+    case FieldIndex::Phone:
+        foreach (const QContactPhoneNumber &phone, contact.details<QContactPhoneNumber>()) {
+            QString digits = digitsOf(phone.number());
+            appendUnique(tokens, digits);
+            if (digits.size() > LocalPhoneDigits)
+                appendUnique(tokens, digits.right(LocalPhoneDigits));
+        }
+        break;
+    case FieldIndex::City:
+        foreach (const QContactAddress &address, contact.details<QContactAddress>())
+            appendWords(tokens, address.locality());
+        break;
+    case FieldIndex::Country:
+        foreach (const QContactAddress &address, contact.details<QContactAddress>())
+            appendWords(tokens, address.country());
+        break;
+    case FieldIndex::Url:
+        foreach (const QContactUrl &url, contact.details<QContactUrl>()) {
+            QString host = SearchIndex::fold(url.url().trimmed());
+            host.remove(QRegExp("^[a-z]+://"));
+            appendUnique(tokens, host);
+            if (host.startsWith("www."))
+                appendUnique(tokens, host.mid(4));
+        }
+        break;
+    case FieldIndex::Account:
+        foreach (const QContactOnlineAccount &account, contact.details<QContactOnlineAccount>()) {
+            appendUnique(tokens, SearchIndex::fold(account.accountUri()));
+            appendUnique(tokens, SearchIndex::fold(account.serviceProvider()));
+        }
+        break;
+    case FieldIndex::Is:
+        if (contact.detail<QContactFavorite>().isFavorite())
+            tokens << "favorite";
+        if (online)
+            tokens << "online";
+        break;
+    case FieldIndex::Has:
+        if (!contact.detail<QContactBirthday>().isEmpty())
+            tokens << "birthday";
+        if (!contact.detail<QContactEmailAddress>().isEmpty())
+            tokens << "email";
+        if (!contact.detail<QContactPhoneNumber>().isEmpty())
+            tokens << "phone";
+        if (!contact.detail<QContactAddress>().isEmpty())
+            tokens << "address";
+        if (!contact.detail<QContactOnlineAccount>().isEmpty())
+            tokens << "account";
+        if (!contact.detail<QContactUrl>().isEmpty())
+            tokens << "url";
+        break;
+    default:
+        break;
+    }
+
+    return tokens;
+}
+
+FieldIndex::FieldIndex()
+{
+    for (int field = 0; field < FieldCount; field++)
+        mSorted[field] = false;
+}
+
+void FieldIndex::insert(QContactLocalId id, const QContact &contact, bool online)
+{
+    for (int i = 0; i < FieldCount; i++) {
+        Field field = Field(i);
+        QStringList tokens = fieldTokens(field, contact, online);
+        QStringList previous = mTokens[field].value(id);
+        if (tokens == previous)
+            continue;
+
+        if (mSorted[field]) {
+            removePostings(field, id, previous);
+            addPostings(field, id, tokens);
+        }
+
+        if (tokens.isEmpty())
+            mTokens[field].remove(id);
+        else
+            mTokens[field].insert(id, tokens);
+    }
+}
+
+void FieldIndex::remove(QContactLocalId id)
+{
+    for (int i = 0; i < FieldCount; i++) {
+        Field field = Field(i);
+        QStringList previous = mTokens[field].take(id);
+        if (mSorted[field])
+            removePostings(field, id, previous);
+    }
+}
+
+void FieldIndex::clear()
+{
+    for (int field = 0; field < FieldCount; field++) {
+        mTokens[field].clear();
+        mPostings[field].clear();
+        mSorted[field] = false;
+    }
+}
+
+void FieldIndex::addPostings(Field field, QContactLocalId id, const QStringList &tokens)
+{
+    QVector<Posting> &postings = mPostings[field];
+    foreach (const QString &token, tokens) {
+        Posting posting = { token, id };
+        postings.insert(qLowerBound(postings.begin(), postings.end(), posting), posting);
+    }
+}
+
+void FieldIndex::removePostings(Field field, QContactLocalId id, const QStringList &tokens)
+{
+    QVector<Posting> &postings = mPostings[field];
+    foreach (const QString &token, tokens) {
+        Posting posting = { token, id };
+        QVector<Posting>::iterator it = qLowerBound(postings.begin(), postings.end(), posting);
+        if (it != postings.end() && it->token == token && it->id == id)
+            postings.erase(it);
+    }
+}
+
+/*! Sorts the tokens of \a field if a bulk load left them unsorted.
+ */
+void FieldIndex::sortPostings(Field field) const
+{
+    if (mSorted[field])
+        return;
+
+    QVector<Posting> &postings = mPostings[field];
+    postings.clear();
+    for (QHash<QContactLocalId, QStringList>::const_iterator it = mTokens[field].constBegin();
+         it != mTokens[field].constEnd(); ++it) {
+        foreach (const QString &token, it.value()) {
+            Posting posting = { token, it.key() };
+            postings.append(posting);
+        }
+    }
+    qSort(postings);
+    mSorted[field] = true;
+}
+
+// the tokens of field starting with value
+void FieldIndex::range(Field field, const QString &value,
+                       PostingIterator *begin, PostingIterator *end) const
+{
+    sortPostings(field);
+
+    const QVector<Posting> &postings = mPostings[field];
+    Posting first = { value, 0 };
+    Posting last = { value + QChar(0xffff), 0 };
+    *begin = qLowerBound(postings.constBegin(), postings.constEnd(), first);
+    *end = qLowerBound(*begin, postings.constEnd(), last);
+}
+
+/*! Returns the number of tokens of \a field starting with \a value, an
+ * upper bound of the number of contacts matching, in O(log n).
+ */
+int FieldIndex::count(Field field, const QString &value) const
+{
+    PostingIterator begin, end;
+    range(field, value, &begin, &end);
+    return end - begin;
+}
+
+/*! Returns the contacts with a token of \a field starting with \a value.
+ */
+QList<QContactLocalId> FieldIndex::lookup(Field field, const QString &value) const
+{
+    PostingIterator begin, end;
+    range(field, value, &begin, &end);
+
+    QSet<QContactLocalId> ids;
+    for (PostingIterator it = begin; it != end; ++it)
+        ids.insert(it->id);
+    return ids.toList();
+}
+
+bool FieldIndex::matches(Field field, QContactLocalId id, const QString &value) const
+{
+    QHash<QContactLocalId, QStringList>::const_iterator it = mTokens[field].constFind(id);
+    if (it == mTokens[field].constEnd())
+        return false;
+
+    foreach (const QString &token, it.value()) {
+        if (token.startsWith(value))
+            return true;
+    }
+    return false;
+}
+
+/*! Returns the field named \a name in a query, e.g. "company"; \a ok is
+ * set to false for names that are not fields.
+ */
+FieldIndex::Field FieldIndex::field(const QString &name, bool *ok)
+{
+    static QHash<QString, Field> fields;
+    if (fields.isEmpty()) {
+        fields.insert("name", Name);
+        fields.insert("company", Company);
+        fields.insert("org", Company);
+        fields.insert("email", Email);
+        fields.insert("phone", Phone);
+        fields.insert("tel", Phone);
+        fields.insert("city", City);
+        fields.insert("country", Country);
+        fields.insert("url", Url);
+        fields.insert("web", Url);
+        fields.insert("account", Account);
+        fields.insert("im", Account);
+        fields.insert("is", Is);
+        fields.insert("has", Has);
+    }
+
+    QHash<QString, Field>::const_iterator it = fields.constFind(name.toLower());
+    *ok = (it != fields.constEnd());
+    return *ok ? it.value() : Name;
+}
+
+/*! Returns \a value folded the way the tokens of \a field are.
+ */
+QString FieldIndex::prepareValue(Field field, const QString &value)
+{
+    if (field == Phone)
+        return digitsOf(value);
+    return SearchIndex::fold(value.trimmed());
+}
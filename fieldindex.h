@@ -0,0 +1,88 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef FIELDINDEX_H
+#define FIELDINDEX_H
+
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+#include <QContact>
+
+QTM_USE_NAMESPACE
+
+/*! Finds contacts by the words of one field at a time, for queries such
+ * as company:acme or city:berlin.
+ *
+ * Every field of a contact is split into folded tokens when it is
+ * stored: the words of its names, company, city and country, email
+ * addresses whole, by local part and by "@domain", phone digits whole
+ * and their last seven digits, and flags such as "favorite" for the
+ * is: and has: fields. A value matches a contact if it starts one of
+ * the tokens of the field.
+ *
+ * Each field keeps its tokens sorted, so the contacts matching a value
+ * are found, and counted, by binary search. The sorted tokens are
+ * rebuilt on the next lookup after a bulk load and updated in place
+ * after that.
+ */
+class FieldIndex
+{
+public:
+    enum Field {
+        Name,
+        Company,
+        Email,
+        Phone,
+        City,
+        Country,
+        Url,
+        Account,
+        Is,
+        Has,
+        FieldCount
+    };
+
+    FieldIndex();
+
+    void insert(QContactLocalId id, const QContact &contact, bool online);
+    void remove(QContactLocalId id);
+    void clear();
+
+    int count(Field field, const QString &value) const;
+    QList<QContactLocalId> lookup(Field field, const QString &value) const;
+    bool matches(Field field, QContactLocalId id, const QString &value) const;
+
+    static Field field(const QString &name, bool *ok);
+    static QString prepareValue(Field field, const QString &value);
+
+private:
+    struct Posting {
+        QString token;
+        QContactLocalId id;
+
+        bool operator<(const Posting &other) const
+        {
+            return token < other.token || (token == other.token && id < other.id);
+        }
+    };
+
+    typedef QVector<Posting>::const_iterator PostingIterator;
+
+    void addPostings(Field field, QContactLocalId id, const QStringList &tokens);
+    void removePostings(Field field, QContactLocalId id, const QStringList &tokens);
+    void sortPostings(Field field) const;
+    void range(Field field, const QString &value,
+               PostingIterator *begin, PostingIterator *end) const;
+
+    QHash<QContactLocalId, QStringList> mTokens[FieldCount];
+    mutable QVector<Posting> mPostings[FieldCount];
+    mutable bool mSorted[FieldCount];
+};
+
+#endif // FIELDINDEX_H
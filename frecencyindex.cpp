@@ -0,0 +1,300 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QDebug>
+
+#include <QDataStream>
+#include <QFile>
+
+#include <algorithm>
+#include <math.h>
+
+#include "frecencyindex.h"
+
+const double FrecencyIndex::NoScore = -1e300;
+
+// time for the weight of an interaction to halve
+static const int HalfLifeDays = 14;
+// scores are relative to this point in time; it must never change
+static const uint EpochTime = 1293840000; // 2011-01-01 00:00 UTC
+
+static const quint32 FileMagic = 0x46524543; // "FREC"
+static const quint16 FileVersion = 1;
+
+static double interactionWeight(FrecencyIndex::Interaction interaction)
+{
+    switch (interaction) {
+    case FrecencyIndex::Called:
+        return 4.0;
+    case FrecencyIndex::Messaged:
+    case FrecencyIndex::Emailed:
+        return 3.0;
+    case FrecencyIndex::Edited:
+        return 2.0;
+    case FrecencyIndex::Viewed:
+    default:
+        return 1.0;
+    }
+}
+
+// log(exp(a) + exp(b)) without overflowing
+static double logAdd(double a, double b)
+{
+    if (a < b)
+        qSwap(a, b);
+    if (b == FrecencyIndex::NoScore)
+        return a;
+    return a + log1p(exp(b - a));
+}
+
+FrecencyIndex::FrecencyIndex()
+{
+}
+
+void FrecencyIndex::record(const QUuid &contact, Interaction interaction,
+                           const QDateTime &when)
+{
+    if (contact.isNull())
+        return;
+
+    static const double decayPerSecond = log(2.0) / (HalfLifeDays * 24.0 * 3600.0);
+    double seconds = double(when.toTime_t()) - double(EpochTime);
+    double points = log(interactionWeight(interaction)) + decayPerSecond * seconds;
+
+    QMap<QUuid, int>::const_iterator it = mPosition.constFind(contact);
+    if (it != mPosition.constEnd()) {
+        int i = it.value();
+        mHeap[i].score = logAdd(mHeap[i].score, points);
+        // a score only ever grows
+        siftUp(i);
+        return;
+    }
+
+    Entry entry;
+    entry.contact = contact;
+    entry.score = points;
+    mHeap.append(entry);
+    mPosition.insert(contact, mHeap.size() - 1);
+    siftUp(mHeap.size() - 1);
+}
+
+void FrecencyIndex::remove(const QUuid &contact)
+{
+    QMap<QUuid, int>::iterator it = mPosition.find(contact);
+    if (it == mPosition.end())
+        return;
+
+    int i = it.value();
+    mPosition.erase(it);
+
+    int last = mHeap.size() - 1;
+    if (i == last) {
+        mHeap.resize(last);
+        return;
+    }
+
+    // fill the hole with the last entry and restore the heap around it
+    QUuid moved = mHeap.at(last).contact;
+    mHeap[i] = mHeap.at(last);
+    mHeap.resize(last);
+    mPosition[moved] = i;
+    siftUp(i);
+    siftDown(mPosition.value(moved));
+}
+
+/*! Moves the score of \a from to \a to, for a contact whose uuid
+ * changed; if \a to has a score of its own, the two are added up.
+ * Returns false if \a from has no score.
+ */
+bool FrecencyIndex::rename(const QUuid &from, const QUuid &to)
+{
+    QMap<QUuid, int>::iterator it = mPosition.find(from);
+    if (it == mPosition.end() || from == to || to.isNull())
+        return false;
+
+    int i = it.value();
+    QMap<QUuid, int>::const_iterator existing = mPosition.constFind(to);
+    if (existing != mPosition.constEnd()) {
+        int j = existing.value();
+        mHeap[j].score = logAdd(mHeap.at(j).score, mHeap.at(i).score);
+        siftUp(j);
+        remove(from);
+        return true;
+    }
+
+    mPosition.erase(it);
+    mHeap[i].contact = to;
+    mPosition.insert(to, i);
+    return true;
+}
+
+void FrecencyIndex::clear()
+{
+    mHeap.clear();
+    mPosition.clear();
+}
+
+bool FrecencyIndex::contains(const QUuid &contact) const
+{
+    return mPosition.contains(contact);
+}
+
+double FrecencyIndex::score(const QUuid &contact) const
+{
+    QMap<QUuid, int>::const_iterator it = mPosition.constFind(contact);
+    if (it == mPosition.constEnd())
+        return NoScore;
+    return mHeap.at(it.value()).score;
+}
+
+int FrecencyIndex::size() const
+{
+    return mHeap.size();
+}
+
+// orders heap positions by the score found there, for std::*_heap
+template <typename Heap>
+class HeapPositionLess
+{
+public:
+    HeapPositionLess(const Heap &heap) : mHeap(heap) {}
+
+    bool operator()(int left, int right) const
+    {
+        return mHeap.at(left).score < mHeap.at(right).score;
+    }
+
+private:
+    const Heap &mHeap;
+};
+
+/*! Returns the \a count highest ranked contacts, best first. Only the
+ * part of the heap above them is visited.
+ */
+QList<QUuid> FrecencyIndex::top(int count) const
+{
+    QList<QUuid> result;
+    if (mHeap.isEmpty() || count <= 0)
+        return result;
+
+    HeapPositionLess<QVector<Entry> > less(mHeap);
+
+    // the next best entry is always the root or a child of one taken
+    QVector<int> frontier;
+    frontier.append(0);
+    while (result.size() < count && !frontier.isEmpty()) {
+        std::pop_heap(frontier.begin(), frontier.end(), less);
+        int i = frontier.last();
+        frontier.pop_back();
+        result.append(mHeap.at(i).contact);
+
+        for (int child = 2 * i + 1; child <= 2 * i + 2 && child < mHeap.size(); child++) {
+            frontier.append(child);
+            std::push_heap(frontier.begin(), frontier.end(), less);
+        }
+    }
+
+    return result;
+}
+
+bool FrecencyIndex::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_4_7);
+
+    quint32 magic;
+    quint16 version;
+    quint32 count;
+    in >> magic >> version >> count;
+    if (magic != FileMagic || version != FileVersion) {
+        qWarning() << Q_FUNC_INFO << "ignoring unknown interaction log" << fileName;
+        return false;
+    }
+
+    clear();
+    mHeap.reserve(count);
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        Entry entry;
+        in >> entry.contact >> entry.score;
+        if (entry.contact.isNull() || mPosition.contains(entry.contact))
+            continue;
+        mHeap.append(entry);
+        mPosition.insert(entry.contact, mHeap.size() - 1);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << Q_FUNC_INFO << "truncated interaction log" << fileName;
+        clear();
+        return false;
+    }
+
+    // written in heap order, but do not rely on it
+    for (int i = mHeap.size() / 2 - 1; i >= 0; i--)
+        siftDown(i);
+
+    return true;
+}
+
+/*! Writes the index as 24 bytes per contact: its uuid and its score.
+ */
+bool FrecencyIndex::save(const QString &fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << Q_FUNC_INFO << "failed to write" << fileName;
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_7);
+    out << FileMagic << FileVersion << quint32(mHeap.size());
+    foreach (const Entry &entry, mHeap)
+        out << entry.contact << entry.score;
+
+    return out.status() == QDataStream::Ok;
+}
+
+void FrecencyIndex::siftUp(int i)
+{
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (mHeap.at(parent).score >= mHeap.at(i).score)
+            break;
+        swapEntries(i, parent);
+        i = parent;
+    }
+}
+
+void FrecencyIndex::siftDown(int i)
+{
+    int size = mHeap.size();
+    while (true) {
+        int largest = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < size && mHeap.at(left).score > mHeap.at(largest).score)
+            largest = left;
+        if (right < size && mHeap.at(right).score > mHeap.at(largest).score)
+            largest = right;
+        if (largest == i)
+            break;
+        swapEntries(i, largest);
+        i = largest;
+    }
+}
+
+void FrecencyIndex::swapEntries(int i, int j)
+{
+    qSwap(mHeap[i], mHeap[j]);
+    mPosition[mHeap.at(i).contact] = i;
+    mPosition[mHeap.at(j).contact] = j;
+}
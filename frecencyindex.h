@@ -0,0 +1,71 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef FRECENCYINDEX_H
+#define FRECENCYINDEX_H
+
+#include <QDateTime>
+#include <QList>
+#include <QMap>
+#include <QUuid>
+#include <QVector>
+
+/*! Ranks contacts by how often and how recently the user interacted
+ * with them.
+ *
+ * Every interaction adds a weight that halves every HalfLifeDays. Scores
+ * are kept as the logarithm of the weights decayed towards a fixed epoch,
+ * so scores never have to be recomputed as time passes: a newer
+ * interaction simply counts for more. Contacts are kept in an indexed
+ * max-heap, making an update O(log n) and a top-k query O(k log k).
+ */
+class FrecencyIndex
+{
+public:
+    enum Interaction {
+        Viewed,
+        Edited,
+        Emailed,
+        Messaged,
+        Called
+    };
+
+    FrecencyIndex();
+
+    void record(const QUuid &contact, Interaction interaction,
+                const QDateTime &when = QDateTime::currentDateTime());
+    void remove(const QUuid &contact);
+    bool rename(const QUuid &from, const QUuid &to);
+    void clear();
+
+    bool contains(const QUuid &contact) const;
+    double score(const QUuid &contact) const;
+    QList<QUuid> top(int count) const;
+    int size() const;
+
+    bool load(const QString &fileName);
+    bool save(const QString &fileName) const;
+
+    // score of contacts without interactions, below any recorded score
+    static const double NoScore;
+
+private:
+    struct Entry {
+        QUuid contact;
+        double score;
+    };
+
+    void siftUp(int i);
+    void siftDown(int i);
+    void swapEntries(int i, int j);
+
+    QVector<Entry> mHeap;
+    QMap<QUuid, int> mPosition;
+};
+
+#endif // FRECENCYINDEX_H
@@ -0,0 +1,241 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QDebug>
+
+#include <QDataStream>
+#include <QFile>
+
+#include "groupindex.h"
+
+static const quint32 FileMagic = 0x47525053; // "GRPS"
+static const quint16 FileVersion = 1;
+
+GroupIndex::GroupIndex()
+    : mGeneration(0)
+{
+}
+
+QStringList GroupIndex::groups() const
+{
+    return mMembers.keys();
+}
+
+bool GroupIndex::contains(const QString &group) const
+{
+    return mMembers.contains(group);
+}
+
+bool GroupIndex::addGroup(const QString &group)
+{
+    if (group.isEmpty() || mMembers.contains(group))
+        return false;
+
+    mMembers.insert(group, ContactBitmap());
+    mGeneration++;
+    return true;
+}
+
+bool GroupIndex::removeGroup(const QString &group)
+{
+    if (!mMembers.remove(group))
+        return false;
+
+    QMap<QUuid, QStringList>::iterator it = mGroupsOf.begin();
+    while (it != mGroupsOf.end()) {
+        it.value().removeAll(group);
+        if (it.value().isEmpty())
+            it = mGroupsOf.erase(it);
+        else
+            ++it;
+    }
+    mGeneration++;
+    return true;
+}
+
+/*! Adds the contact \a uuid to \a group, creating the group if needed.
+ * \a id is its local id, or 0 if it is not loaded.
+ */
+void GroupIndex::addMember(const QString &group, const QUuid &uuid, QContactLocalId id)
+{
+    if (group.isEmpty() || uuid.isNull())
+        return;
+
+    QStringList &groups = mGroupsOf[uuid];
+    if (!groups.contains(group))
+        groups << group;
+
+    ContactBitmap &members = mMembers[group];
+    if (id)
+        members.insert(id);
+    mGeneration++;
+}
+
+void GroupIndex::removeMember(const QString &group, const QUuid &uuid, QContactLocalId id)
+{
+    QMap<QUuid, QStringList>::iterator it = mGroupsOf.find(uuid);
+    if (it == mGroupsOf.end() || !it.value().removeAll(group))
+        return;
+
+    if (it.value().isEmpty())
+        mGroupsOf.erase(it);
+    if (id && mMembers.contains(group))
+        mMembers[group].remove(id);
+    mGeneration++;
+}
+
+/*! Drops the deleted contact \a uuid from every group.
+ */
+void GroupIndex::forget(const QUuid &uuid, QContactLocalId id)
+{
+    unbind(uuid, id);
+    mGroupsOf.remove(uuid);
+}
+
+/*! Moves the memberships of \a from to \a to, for a contact whose uuid
+ * changed. Returns false if \a from belonged to no group.
+ */
+bool GroupIndex::rename(const QUuid &from, const QUuid &to)
+{
+    QMap<QUuid, QStringList>::iterator it = mGroupsOf.find(from);
+    if (it == mGroupsOf.end() || from == to)
+        return false;
+
+    QStringList groups = it.value();
+    mGroupsOf.erase(it);
+
+    QStringList &renamed = mGroupsOf[to];
+    foreach (const QString &group, groups) {
+        if (!renamed.contains(group))
+            renamed << group;
+    }
+    mGeneration++;
+    return true;
+}
+
+QStringList GroupIndex::groupsOf(const QUuid &uuid) const
+{
+    return mGroupsOf.value(uuid);
+}
+
+/*! Returns the loaded members of \a group.
+ */
+ContactBitmap GroupIndex::members(const QString &group) const
+{
+    return mMembers.value(group);
+}
+
+/*! Adds the contact \a id to the groups its \a uuid belongs to.
+ */
+void GroupIndex::bind(const QUuid &uuid, QContactLocalId id)
+{
+    QMap<QUuid, QStringList>::const_iterator it = mGroupsOf.constFind(uuid);
+    if (it == mGroupsOf.constEnd())
+        return;
+
+    foreach (const QString &group, it.value()) {
+        if (mMembers[group].insert(id))
+            mGeneration++;
+    }
+}
+
+void GroupIndex::unbind(const QUuid &uuid, QContactLocalId id)
+{
+    if (mFavorites.remove(id))
+        mGeneration++;
+
+    foreach (const QString &group, mGroupsOf.value(uuid)) {
+        QMap<QString, ContactBitmap>::iterator it = mMembers.find(group);
+        if (it != mMembers.end() && it.value().remove(id))
+            mGeneration++;
+    }
+}
+
+void GroupIndex::setFavorite(QContactLocalId id, bool favorite)
+{
+    if (favorite ? mFavorites.insert(id) : mFavorites.remove(id))
+        mGeneration++;
+}
+
+/*! Forgets the local ids of all members, before the contacts are
+ * loaded again; the groups and their uuids stay.
+ */
+void GroupIndex::clearIds()
+{
+    for (QMap<QString, ContactBitmap>::iterator it = mMembers.begin(); it != mMembers.end(); ++it)
+        it.value().clear();
+    mFavorites.clear();
+    mGeneration++;
+}
+
+bool GroupIndex::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_4_7);
+
+    quint32 magic;
+    quint16 version;
+    quint32 count;
+    in >> magic >> version >> count;
+    if (magic != FileMagic || version != FileVersion) {
+        qWarning() << Q_FUNC_INFO << "ignoring unknown group file" << fileName;
+        return false;
+    }
+
+    QMap<QString, ContactBitmap> members;
+    QMap<QUuid, QStringList> groupsOf;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        QString group;
+        QList<QUuid> uuids;
+        in >> group >> uuids;
+        members.insert(group, ContactBitmap());
+        foreach (const QUuid &uuid, uuids)
+            groupsOf[uuid] << group;
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << Q_FUNC_INFO << "truncated group file" << fileName;
+        return false;
+    }
+
+    mMembers = members;
+    mGroupsOf = groupsOf;
+    mGeneration++;
+    return true;
+}
+
+bool GroupIndex::save(const QString &fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << Q_FUNC_INFO << "failed to write" << fileName;
+        return false;
+    }
+
+    QMap<QString, QList<QUuid> > uuids;
+    foreach (const QString &group, mMembers.keys())
+        uuids.insert(group, QList<QUuid>());
+    for (QMap<QUuid, QStringList>::const_iterator it = mGroupsOf.constBegin();
+         it != mGroupsOf.constEnd(); ++it) {
+        foreach (const QString &group, it.value())
+            uuids[group] << it.key();
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_7);
+    out << FileMagic << FileVersion << quint32(uuids.size());
+    for (QMap<QString, QList<QUuid> >::const_iterator it = uuids.constBegin();
+         it != uuids.constEnd(); ++it)
+        out << it.key() << it.value();
+
+    return out.status() == QDataStream::Ok;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef GROUPINDEX_H
+#define GROUPINDEX_H
+
+#include <QMap>
+#include <QStringList>
+#include <QUuid>
+#include <QContact>
+
+#include "contactbitmap.h"
+
+QTM_USE_NAMESPACE
+
+/*! Named groups of contacts, such as "Work" or "Family".
+ *
+ * Membership is kept by contact uuid, which is what gets saved, and as
+ * a ContactBitmap of the local ids of the members currently loaded,
+ * which is what filters use. The store binds a uuid to its id whenever
+ * it stores a contact, so members added before a reload come back as
+ * soon as their contacts do.
+ *
+ * The favorites are kept as a bitmap too, so that they combine with
+ * groups. generation() changes with every bitmap, for users caching
+ * the result of combining them.
+ */
+class GroupIndex
+{
+public:
+    GroupIndex();
+
+    QStringList groups() const;
+    bool contains(const QString &group) const;
+    bool addGroup(const QString &group);
+    bool removeGroup(const QString &group);
+
+    void addMember(const QString &group, const QUuid &uuid, QContactLocalId id);
+    void removeMember(const QString &group, const QUuid &uuid, QContactLocalId id);
+    void forget(const QUuid &uuid, QContactLocalId id);
+    bool rename(const QUuid &from, const QUuid &to);
+    QStringList groupsOf(const QUuid &uuid) const;
+
+    ContactBitmap members(const QString &group) const;
+    const ContactBitmap &favorites() const { return mFavorites; }
+
+    void bind(const QUuid &uuid, QContactLocalId id);
+    void unbind(const QUuid &uuid, QContactLocalId id);
+    void setFavorite(QContactLocalId id, bool favorite);
+    void clearIds();
+
+    uint generation() const { return mGeneration; }
+
+    bool load(const QString &fileName);
+    bool save(const QString &fileName) const;
+
+private:
+    // loaded members of each group, and the groups of each uuid
+    QMap<QString, ContactBitmap> mMembers;
+    QMap<QUuid, QStringList> mGroupsOf;
+    ContactBitmap mFavorites;
+    uint mGeneration;
+};
+
+#endif // GROUPINDEX_H
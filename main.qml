@@ -25,6 +25,7 @@ Labs.Window {
     property string filterAll: qsTr("All")
     property string filterFavorites: qsTr("Favorites")
     property string filterWhosOnline: qsTr("Who's online")
+    property string filterRecent: qsTr("Recent")
 
     property string contextView: qsTr("View")
     property string contextShare: qsTr("Share")
@@ -47,6 +48,15 @@ Labs.Window {
 
     property int animationDuration: 250
 
+    // the vCard being written to be shared; the email composer is only
+    // started once it is complete
+    property string sharedVCard: ""
+
+    function shareContact(uuid, filename) {
+        sharedVCard = filename;
+        peopleModel.exportContact(uuid, filename);
+    }
+
     applicationPage: myAppAllContacts
 
     Connections {
@@ -78,14 +88,21 @@ Labs.Window {
 
     onFilterTriggered: {
         if(index == 0){
+            proxyModel.setFilter(ProxyModel.FilterAll);
             peopleModel.setFilter(PeopleModel.AllFilter);
             scene.applicationPage = myAppAllContacts;
         }else if(index == 1){
+            proxyModel.setFilter(ProxyModel.FilterAll);
             peopleModel.setFilter(PeopleModel.FavoritesFilter);
             scene.applicationPage = myAppAllContacts;
         }else if(index == 2){
+            proxyModel.setFilter(ProxyModel.FilterAll);
             peopleModel.setFilter(PeopleModel.OnlineFilter);
             scene.applicationPage = myAppAllContacts;
+        }else if(index == 3){
+            peopleModel.setFilter(PeopleModel.AllFilter);
+            proxyModel.setFilter(ProxyModel.FilterRecent);
+            scene.applicationPage = myAppAllContacts;
         }
     }
 
@@ -133,7 +150,7 @@ Labs.Window {
             onTypeChanged: {
                 if(groupedViewPage.type < 2){
                     peopleModel.setFilter(PeopleModel.AllFilter, false);
-                    scene.filterModel =  [filterAll, filterFavorites, filterWhosOnline];
+                    scene.filterModel =  [filterAll, filterFavorites, filterWhosOnline, filterRecent];
                 }
             }
         }
@@ -166,9 +183,7 @@ Labs.Window {
                 model: [contextShare, contextEdit]
                 onTriggered: {
                     if(index == 0) {
-                        peopleModel.exportContact(scene.currentContactId,  "/tmp/vcard.vcf");
-                        var cmd = "/usr/bin/meego-qml-launcher --app meego-app-email --fullscreen --cmd openComposer --cdata \"file:///tmp/vcard.vcf\"";
-                        appModel.launch(cmd);
+                        scene.shareContact(scene.currentContactId, "/tmp/vcard.vcf");
                     }
                     else if(index == 1) {
                         scene.addApplicationPage(myAppEdit);
@@ -278,6 +293,19 @@ Labs.Window {
         id: peopleModel
     }
 
+    Connections {
+        target: peopleModel
+        onExportFinished: {
+            if (filename != scene.sharedVCard)
+                return;
+            scene.sharedVCard = "";
+            if (success) {
+                var cmd = "/usr/bin/meego-qml-launcher --app meego-app-email --fullscreen --cmd openComposer --cdata \"file://" + filename + "\"";
+                peopleModel.launch(cmd);
+            }
+        }
+    }
+
     ProxyModel{
         id: proxyModel
         Component.onCompleted:{
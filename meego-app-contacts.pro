@@ -22,16 +22,46 @@ MOC_DIR = .moc
 MOBILITY = contacts versit
 
 HEADERS += \
+    accountindex.h \
+    birthdayindex.h \
+    contactbackup.h \
+    contactbitmap.h \
     contacts.h \
+    contactquery.h \
+    contactstore.h \
+    contacttrace.h \
+    dialpadindex.h \
+    fieldindex.h \
+    groupindex.h \
+    frecencyindex.h \
     peoplemodel.h \
     peoplemodel_p.h \
     proxymodel.h \
+    rowtable.h \
+    searchindex.h \
+    startuptimeline.h \
+    stringpool.h \
     settingsdatastore.h
 
 SOURCES += \
+    accountindex.cpp \
+    birthdayindex.cpp \
+    contactbackup.cpp \
+    contactbitmap.cpp \
     contacts.cpp \
+    contactquery.cpp \
+    contactstore.cpp \
+    contacttrace.cpp \
+    dialpadindex.cpp \
+    fieldindex.cpp \
+    groupindex.cpp \
+    frecencyindex.cpp \
     peoplemodel.cpp \
     proxymodel.cpp \
+    rowtable.cpp \
+    searchindex.cpp \
+    startuptimeline.cpp \
+    stringpool.cpp \
     settingsdatastore.cpp
 
 QML_FILES = *.qml
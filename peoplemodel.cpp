@@ -7,6 +7,7 @@
  */
 
 #include <QDebug>
+#include <QElapsedTimer>
 
 #include <QVector>
 #include <QContactAddress>
@@ -25,16 +26,261 @@
 #include <QContactUrl>
 #include <QContactNote>
 #include <QContactPresence>
-#include <QSettings>
-#include <QContactDetailFilter>
 #include <QVersitContactExporter>
 #include <QVersitReader>
-#include <QContactLocalIdFilter>
 #include <QContactManagerEngine>
 #include <QFile>
+#include <QImage>
+#include <QProcess>
 
 #include "peoplemodel.h"
 #include "peoplemodel_p.h"
+#include "startuptimeline.h"
+
+// roles read by the list delegate (ContactCardPortrait)
+static QList<int> cardRoles()
+{
+    static QList<int> roles;
+    if (roles.isEmpty()) {
+        roles << PeopleModel::FirstNameRole << PeopleModel::LastNameRole
+              << PeopleModel::CompanyNameRole << PeopleModel::UuidRole
+              << PeopleModel::FavoriteRole << PeopleModel::PresenceRole
+              << PeopleModel::IsSelfRole << PeopleModel::AvatarRole
+              << PeopleModel::PhoneNumberRole << PeopleModel::EmailAddressRole
+              << PeopleModel::OnlineAccountUriRole
+              << PeopleModel::OnlineServiceProviderRole
+              << PeopleModel::WebUrlRole;
+    }
+    return roles;
+}
+
+/*
+ * Role extraction
+ *
+ * Every role is answered by an extractor taking the contact and the model
+ * state. Most roles are generated from one of the templates below, given
+ * the detail type and its field accessor; the rest are written out. The
+ * table is indexed by role, so data() and rowData() share one lookup and
+ * new roles only need a table entry.
+ */
+
+typedef QVariant (*RoleExtractorFunction)(const QContact &contact, const PeopleModelPriv *priv);
+
+struct RoleExtractor
+{
+    int role;
+    RoleExtractorFunction extract;
+    // true if the role needs the complete contact, not the list projection
+    bool needsDetails;
+};
+
+// which values list extractors leave out
+enum ListPolicy {
+    SkipNull,
+    SkipEmpty,
+    KeepAll
+};
+
+template <typename D, QString (D::*field)() const>
+static QVariant scalarField(const QContact &contact, const PeopleModelPriv *)
+{
+    D detail = contact.detail<D>();
+    return QString((detail.*field)());
+}
+
+template <typename D, QString (D::*field)() const, int policy>
+static QVariant listField(const QContact &contact, const PeopleModelPriv *)
+{
+    QStringList list;
+    foreach (const D &detail, contact.details<D>()) {
+        QString value = (detail.*field)();
+        if ((policy == SkipNull && value.isNull()) || (policy == SkipEmpty && value.isEmpty()))
+            continue;
+        list << value;
+    }
+    return list;
+}
+
+template <typename D>
+static QVariant contextsField(const QContact &contact, const PeopleModelPriv *)
+{
+    QStringList list;
+    foreach (const D &detail, contact.details<D>()) {
+        if (!detail.contexts().isEmpty())
+            list << detail.contexts();
+    }
+    return list;
+}
+
+static QVariant contactId(const QContact &contact, const PeopleModelPriv *)
+{
+    return contact.id().localId();
+}
+
+static QVariant birthday(const QContact &contact, const PeopleModelPriv *priv)
+{
+    return priv->store->birthdayIndex().text(contact.localId());
+}
+
+static QVariant avatarUrl(const QContact &contact, const PeopleModelPriv *)
+{
+    QContactAvatar avatar = contact.detail<QContactAvatar>();
+    if(!avatar.imageUrl().isEmpty())
+        return QUrl(avatar.imageUrl()).toString();
+    return QString();
+}
+
+static QVariant thumbnail(const QContact &contact, const PeopleModelPriv *)
+{
+    QContactThumbnail thumb = contact.detail<QContactThumbnail>();
+    return thumb.thumbnail();
+}
+
+static QVariant favorite(const QContact &contact, const PeopleModelPriv *)
+{
+    QContactFavorite fav = contact.detail<QContactFavorite>();
+    if(!fav.isEmpty())
+        return QVariant(fav.isFavorite());
+    return false;
+}
+
+static QVariant serviceProviders(const QContact &contact, const PeopleModelPriv *)
+{
+    //REVISIT: We should use ServiceProvider, but this isn't supported
+    //BUG: https://bugs.meego.com/show_bug.cgi?id=13454
+    QStringList list;
+    foreach (const QContactOnlineAccount& account,
+             contact.details<QContactOnlineAccount>()){
+        if(account.subTypes().size() > 0)
+            list << account.subTypes().at(0);
+    }
+    return list;
+}
+
+static QVariant isSelf(const QContact &contact, const PeopleModelPriv *priv)
+{
+    return priv->store->isSelf(contact.localId());
+}
+
+static QVariant addresses(const QContact &contact, const PeopleModelPriv *)
+{
+    QStringList list;
+    foreach (const QContactAddress& address,
+             contact.details<QContactAddress>()) {
+        list << address.street() + "\n" + address.locality() + "\n" +
+                address.region() + "\n" + address.postcode() + "\n" +
+                address.country();
+    }
+    return list;
+}
+
+static QVariant presence(const QContact &contact, const PeopleModelPriv *priv)
+{
+    return priv->store->presence(contact.localId());
+}
+
+static QVariant webUrls(const QContact &contact, const PeopleModelPriv *)
+{
+    QStringList list;
+    foreach(const QContactUrl &url, contact.details<QContactUrl>()){
+        if(!url.isEmpty())
+            list << url.url();
+    }
+    return list;
+}
+
+static QVariant note(const QContact &contact, const PeopleModelPriv *)
+{
+    QContactNote note = contact.detail<QContactNote>();
+    if(!note.isEmpty())
+        return note.note();
+    return QString();
+}
+
+static QVariant firstCharacter(const QContact &contact, const PeopleModelPriv *priv)
+{
+    QContactName name = contact.detail<QContactName>();
+    if ((priv->sortOrder.isEmpty()) ||
+       (priv->sortOrder.at(0).detailFieldName() == QContactName::FieldFirstName)) {
+        if(!name.firstName().isEmpty()){
+            return QString(name.firstName().at(0).toUpper());
+        }
+    }
+
+    if (!priv->sortOrder.isEmpty() &&
+        priv->sortOrder.at(0).detailFieldName() == QContactName::FieldLastName) {
+        if(!name.lastName().isEmpty()){
+            return QString(name.lastName().at(0).toUpper());
+        }
+    }
+
+    return QString(PeopleModel::tr("#"));
+}
+
+static QVariant frecency(const QContact &contact, const PeopleModelPriv *priv)
+{
+    return priv->store->frecency().score(priv->store->uuidForId(contact.localId()));
+}
+
+static QVariant searchDistance(const QContact &contact, const PeopleModelPriv *priv)
+{
+    if (priv->searchQuery.isEmpty())
+        return -1;
+    if (!priv->query.isEmpty())
+        return priv->queryMatches.contains(contact.localId()) ? 0 : -1;
+    if (!priv->fuzzySearch)
+        return priv->store->searchIndex().matches(contact.localId(), priv->searchQuery) ? 0 : -1;
+    return priv->searchDistances.value(contact.localId(), -1);
+}
+
+// in PeopleModel::PeopleRoles order, starting at ContactRole
+static const RoleExtractor roleExtractors[] = {
+    { PeopleModel::ContactRole, &contactId, false },
+    { PeopleModel::FirstNameRole, &scalarField<QContactName, &QContactName::firstName>, false },
+    { PeopleModel::LastNameRole, &scalarField<QContactName, &QContactName::lastName>, false },
+    { PeopleModel::CompanyNameRole, &scalarField<QContactOrganization, &QContactOrganization::name>, false },
+    { PeopleModel::FavoriteRole, &favorite, false },
+    { PeopleModel::UuidRole, &scalarField<QContactGuid, &QContactGuid::guid>, false },
+    { PeopleModel::PresenceRole, &presence, false },
+    { PeopleModel::AvatarRole, &avatarUrl, false },
+    { PeopleModel::ThumbnailRole, &thumbnail, true },
+    { PeopleModel::IsSelfRole, &isSelf, false },
+    { PeopleModel::BirthdayRole, &birthday, false },
+    { PeopleModel::OnlineAccountUriRole, &listField<QContactOnlineAccount, &QContactOnlineAccount::accountUri, SkipNull>, false },
+    { PeopleModel::OnlineServiceProviderRole, &serviceProviders, false },
+    { PeopleModel::EmailAddressRole, &listField<QContactEmailAddress, &QContactEmailAddress::emailAddress, SkipNull>, false },
+    { PeopleModel::EmailContextRole, &contextsField<QContactEmailAddress>, false },
+    { PeopleModel::PhoneNumberRole, &listField<QContactPhoneNumber, &QContactPhoneNumber::number, SkipNull>, false },
+    { PeopleModel::PhoneContextRole, &contextsField<QContactPhoneNumber>, false },
+    { PeopleModel::AddressRole, &addresses, false },
+    { PeopleModel::AddressStreetRole, &listField<QContactAddress, &QContactAddress::street, SkipEmpty>, false },
+    { PeopleModel::AddressLocaleRole, &listField<QContactAddress, &QContactAddress::locality, SkipNull>, false },
+    { PeopleModel::AddressRegionRole, &listField<QContactAddress, &QContactAddress::region, SkipNull>, false },
+    { PeopleModel::AddressCountryRole, &listField<QContactAddress, &QContactAddress::country, SkipNull>, false },
+    { PeopleModel::AddressPostcodeRole, &listField<QContactAddress, &QContactAddress::postcode, KeepAll>, false },
+    { PeopleModel::AddressContextRole, &contextsField<QContactAddress>, false },
+    { PeopleModel::WebUrlRole, &webUrls, false },
+    { PeopleModel::WebContextRole, &contextsField<QContactUrl>, false },
+    { PeopleModel::NotesRole, &note, true },
+    { PeopleModel::FirstCharacterRole, &firstCharacter, false },
+    { PeopleModel::FrecencyRole, &frecency, false },
+    { PeopleModel::SearchDistanceRole, &searchDistance, false }
+};
+
+// fails to compile when a role is added without its extractor
+typedef char roleExtractorsComplete[
+        (sizeof(roleExtractors) / sizeof(roleExtractors[0])
+         == PeopleModel::SearchDistanceRole - PeopleModel::ContactRole + 1) ? 1 : -1];
+
+static const RoleExtractor *roleExtractor(int role)
+{
+    if (role < PeopleModel::ContactRole || role > PeopleModel::SearchDistanceRole)
+        return 0;
+
+    const RoleExtractor *extractor = &roleExtractors[role - PeopleModel::ContactRole];
+    Q_ASSERT(extractor->role == role);
+    return extractor;
+}
 
 PeopleModel::PeopleModel(QObject *parent)
     : QAbstractListModel(parent)
@@ -47,6 +293,7 @@ PeopleModel::PeopleModel(QObject *parent)
     setRoleNames(roles);
 
     priv = new PeopleModelPriv(this);
+    priv->store = ContactStore::acquire();
 
     QContactSortOrder sort;
     sort.setDetailDefinitionName(QContactName::DefinitionName, QContactName::FieldFirstName);
@@ -54,117 +301,45 @@ PeopleModel::PeopleModel(QObject *parent)
     priv->sortOrder.clear();
     priv->sortOrder.append(sort);
 
-    qDebug() << Q_FUNC_INFO << QContactManager::availableManagers();
-    if (QContactManager::availableManagers().contains("tracker")) {
-        priv->manager = new QContactManager("tracker");
-        qDebug() << "[PeopleModel] Manager is tracker";
-    }
-    else if (QContactManager::availableManagers().contains("memory")) {
-        priv->manager = new QContactManager("memory");
-        qDebug() << "[PeopleModel] Manager is memory";
-
-        qWarning() << Q_FUNC_INFO << "Only recognised tracker engine available is 'memory'";
-        qWarning() << Q_FUNC_INFO << "Changes to contacts WILL NOT be persistent!";
-
-    }else{
-        priv->manager = new QContactManager("default");
-        qDebug() << "[PeopleModel] Manager is empty";
-    }
-
-    qDebug() << Q_FUNC_INFO << "Manager is " << priv->manager->managerName();
-
-    priv->settings = new QSettings("MeeGo", "meego-app-contacts");
-
-    //MeCard feature not added yet
-    if (priv->manager->hasFeature(QContactManager::SelfContact, QContactType::TypeContact)) {
-        // self contact supported by manager - let's try fetch the me card
-        QContactManager::Error error(QContactManager::NoError);
-        const QContactLocalId meCardId(priv->manager->selfContactId());
-
-        //if we have a valid selfId
-        if ((error == QContactManager::NoError) && (meCardId != 0)) {
-            qDebug() << Q_FUNC_INFO << "valid selfId, error" << error << "id " << meCardId;
-            //check if contact with selfId exists
-            QContactLocalIdFilter idListFilter;
-            idListFilter.setIds(QList<QContactLocalId>() << meCardId);
-
-            QContactFetchRequest *meFetchRequest = new QContactFetchRequest(this);
-            connect(meFetchRequest,
-                    SIGNAL(stateChanged(QContactAbstractRequest::State)),
-                    SLOT(onMeFetchRequestStateChanged(QContactAbstractRequest::State)));
-            meFetchRequest->setFilter(idListFilter);
-            meFetchRequest->setManager(priv->manager);
-            meFetchRequest->start();
-        } else {
-            qWarning() << Q_FUNC_INFO << "no valid meCard Id provided";
-        }
-    } else {
-        qWarning() << Q_FUNC_INFO << "MeCard Not supported";
-    }
-
-    connect(priv->manager, SIGNAL(contactsAdded(QList<QContactLocalId>)),
-            this, SLOT(contactsAdded(QList<QContactLocalId>)));
-    connect(priv->manager, SIGNAL(contactsChanged(QList<QContactLocalId>)),
-            this, SLOT(contactsChanged(QList<QContactLocalId>)));
-    connect(priv->manager, SIGNAL(contactsRemoved(QList<QContactLocalId>)),
-            this, SLOT(contactsRemoved(QList<QContactLocalId>)));
-    connect(priv->manager, SIGNAL(dataChanged()), this, SLOT(dataReset()));
+    priv->fuzzySearch = priv->store->settings()->value("FuzzySearch", true).toBool();
+
+    connect(priv->store, SIGNAL(contactsReset()), this, SLOT(onContactsReset()));
+    connect(priv->store, SIGNAL(contactsInserted(QList<QContactLocalId>)),
+            this, SLOT(onContactsInserted(QList<QContactLocalId>)));
+    connect(priv->store, SIGNAL(contactsUpdated(QList<QContactLocalId>)),
+            this, SLOT(onContactsUpdated(QList<QContactLocalId>)));
+    connect(priv->store, SIGNAL(contactsAboutToBeRemoved(QList<QContactLocalId>)),
+            this, SLOT(onContactsAboutToBeRemoved(QList<QContactLocalId>)));
+    connect(priv->store, SIGNAL(contactIdChanged(QContactLocalId, QContactLocalId)),
+            this, SLOT(onContactIdChanged(QContactLocalId, QContactLocalId)));
+    connect(priv->store, SIGNAL(detailsLoaded(QContactLocalId)),
+            this, SLOT(onDetailsLoaded(QContactLocalId)));
+    connect(priv->store, SIGNAL(memoryBudgetChanged()), this, SIGNAL(memoryBudgetChanged()));
+    connect(priv->store, SIGNAL(memoryUsageChanged()), this, SIGNAL(memoryUsageChanged()));
+    connect(priv->store, SIGNAL(groupsChanged()), this, SIGNAL(groupsChanged()));
     connect(&priv->writer, SIGNAL(stateChanged(QVersitWriter::State)),
             this, SLOT(vCardFinished(QVersitWriter::State)));
 
-    dataReset();
-}
-
-// for Me card support
-void PeopleModel::createMeCard()
-{
-  QContact contact;
-  QContactId contactId;
-  contactId.setLocalId(priv->manager->selfContactId());
-
-  qDebug() << Q_FUNC_INFO << "self contact does not exist, creating";
-  contact.setId(contactId);
-
-  QContactGuid guid;
-  guid.setGuid(QUuid::createUuid().toString());
-  if (!contact.saveDetail(&guid))
-    qWarning() << Q_FUNC_INFO << "failed to save guid in mecard contact";
-
-  QContactAvatar avatar;
-  avatar.setImageUrl(QUrl("image://theme/contacts/img_blankavatar"));
-  if (!contact.saveDetail(&avatar))
-      qWarning() << Q_FUNC_INFO << "failed to save avatar in mecard contact";
+    priv->backup = new ContactBackup(priv->store, this);
+    connect(priv->backup, SIGNAL(progress(int, int)), this, SIGNAL(backupProgress(int, int)));
+    connect(priv->backup, SIGNAL(finished(bool)), this, SIGNAL(backupFinished(bool)));
 
-  QContactName name;
-  name.setFirstName(QObject::tr(" Me","Default string to describe self if no self contact information found, default created with [Me] as firstname"));
-  name.setLastName("");
-  if (!contact.saveDetail(&name))
-    qWarning() << Q_FUNC_INFO << "failed to save mecard name";
-
-    QContactFavorite fav;
-    fav.setFavorite(false);
-    if (!contact.saveDetail(&fav))
-        qWarning() << "[PeopleModel] failed to save mecard favorite to " << fav.isFavorite();
-
-  bool isSelf = true;
-  if (priv->settings) {
-    QString key = guid.guid();
-    key += "/self";
-    priv->settings->setValue(key, isSelf);
-  }
-
-  queueContactSave(contact);
+    // another model may have loaded the contacts already
+    if (priv->store->isLoaded())
+        resetRows();
 }
 
 PeopleModel::~PeopleModel()
 {
+    delete priv->backup;
+    priv->store->release();
     delete priv;
 }
 
 int PeopleModel::rowCount(const QModelIndex& parent) const
 {
     Q_UNUSED(parent);
-    return priv->contactIds.size();
+    return priv->rows.count();
 }
 
 int PeopleModel::columnCount(const QModelIndex& parent) const
@@ -182,517 +357,484 @@ QVariant PeopleModel::data(const QModelIndex& index, int role) const
 
 QVariant PeopleModel::data(int row, int role) const
 {
-    QContactLocalId id = priv->contactIds[row];
-    QContact &contact = priv->idToContact[id];
-
-      if(contact.isEmpty())
-		return QVariant();
+    if (row < 0 || row >= priv->rows.count())
+        return QVariant();
 
-    switch (role) {
-    case ContactRole:
-    {
-        return contact.id().localId();
-    }
-    case FirstNameRole:
-    {
-        QContactName name = contact.detail<QContactName>();
-        if(!name.firstName().isNull()){
-            return QString(name.firstName());
-        }
-        return QString();
-    }
-    case LastNameRole:
-    {
-        QContactName name = contact.detail<QContactName>();
-        if(!name.lastName().isNull())
-            return QString(name.lastName());
-        return QString();
-    }
-    case CompanyNameRole:
-    {
-        QContactOrganization company = contact.detail<QContactOrganization>();
-        if(!company.name().isNull())
-            return QString(company.name());
-        return QString();
-    }
-    case BirthdayRole:
-    {
-        QContactBirthday day = contact.detail<QContactBirthday>();
-        if(!day.date().isNull())
-            return day.date().toString(Qt::SystemLocaleDate);
-        return QString();
-    }
-    case AvatarRole:
-    {
-        QContactAvatar avatar = contact.detail<QContactAvatar>();
-        if(!avatar.imageUrl().isEmpty()) {
-            return QUrl(avatar.imageUrl()).toString();
-        }
-        return QString();
-    }
-    case ThumbnailRole:
-    {
-        QContactThumbnail thumb = contact.detail<QContactThumbnail>();
-        return thumb.thumbnail();
-    }
-    case FavoriteRole:
-    {
-        QContactFavorite fav = contact.detail<QContactFavorite>();
-        if(!fav.isEmpty())
-            return QVariant(fav.isFavorite());
-        return false;
-    }
-    case OnlineAccountUriRole:
-    {
-        QStringList list;
-        foreach (const QContactOnlineAccount& account,
-                 contact.details<QContactOnlineAccount>()){
-            if(!account.accountUri().isNull())
-                list << account.accountUri();
-        }
-        return list;
-    }
-    case OnlineServiceProviderRole:
-    {
-        //REVISIT: We should use ServiceProvider, but this isn't supported
-        //BUG: https://bugs.meego.com/show_bug.cgi?id=13454
-        QStringList list;
-        foreach (const QContactOnlineAccount& account,
-                 contact.details<QContactOnlineAccount>()){
-            if(account.subTypes().size() > 0)
-                list << account.subTypes().at(0);
-        }
-        return list;
-    }
-    case IsSelfRole:
-    {
-            if(contact.id().localId() == priv->manager->selfContactId())
-                return true;
-        return false;
-    }
-    case EmailAddressRole:
-    {
-        QStringList list;
-        foreach (const QContactEmailAddress& email,
-                 contact.details<QContactEmailAddress>()){
-            if(!email.emailAddress().isNull())
-                list << email.emailAddress();
-        }
-        return list;
-    }
-    case EmailContextRole:
-    {
-        QStringList list;
-        foreach (const QContactEmailAddress& email,
-                 contact.details<QContactEmailAddress>()){
-            if(!email.contexts().isEmpty())
-                list << email.contexts();
-        }
-        return list;
-    }
-    case PhoneNumberRole:
-    {
-        QStringList list;
-        foreach (const QContactPhoneNumber& phone,
-                 contact.details<QContactPhoneNumber>()){
-            if(!phone.number().isNull())
-                list << phone.number();
-        }
-        return list;
-    }
-    case PhoneContextRole:
-    {
-        QStringList list;
-        foreach (const QContactPhoneNumber& phone,
-                 contact.details<QContactPhoneNumber>()){
-            if(!phone.contexts().isEmpty())
-                list << phone.contexts();
-        }
-        return list;
-    }
-    case AddressRole:
-    {
-        QStringList list;
-        foreach (const QContactAddress& address,
-                 contact.details<QContactAddress>()) {
-            list << address.street() + "\n" + address.locality() + "\n" +
-                    address.region() + "\n" + address.postcode() + "\n" +
-                    address.country();
-        }
-        return list;
-    }
-    case AddressStreetRole:
-    {
-        QStringList list;
-        foreach (const QContactAddress& address,
-                 contact.details<QContactAddress>()){
-            if(!address.street().isEmpty())
-                list << address.street();
-        }
-        return list;
-    }
-    case AddressLocaleRole:
-    {
-        QStringList list;
-        foreach (const QContactAddress& address,
-                 contact.details<QContactAddress>()) {
-            if(!address.locality().isNull())
-                list << address.locality();
-        }
-        return list;
-    }
-    case AddressRegionRole:
-    {
-        QStringList list;
-        foreach (const QContactAddress& address,
-                 contact.details<QContactAddress>()) {
-            if(!address.region().isNull())
-                list << address.region();
-        }
-        return list;
-    }
-    case AddressCountryRole:
-    {
-        QStringList list;
-        foreach (const QContactAddress& address,
-                 contact.details<QContactAddress>()) {
-            if(!address.country().isNull())
-                list << address.country();
-        }
-        return list;
-    }
-    case AddressPostcodeRole:
-    {
-        QStringList list;
-        foreach (const QContactAddress& address,
-                 contact.details<QContactAddress>())
-            list << address.postcode();
-        return list;
-    }
-
-    case AddressContextRole:
-    {
-        QStringList list;
-        foreach (const QContactAddress& address,
-                 contact.details<QContactAddress>()) {
-            if(!address.contexts().isEmpty())
-                list << address.contexts();
-            return list;
-        }
+    const RoleExtractor *extractor = roleExtractor(role);
+    if (!extractor) {
+        qWarning() << "[PeopleModel] request for data with unknown row" <<
+                      row << " role : " << role;
+        return QVariant();
     }
-    case PresenceRole:
-    {
-        foreach (const QContactPresence& qp,
-                 contact.details<QContactPresence>()) {
-            if(!qp.isEmpty())
-                if(qp.presenceState() == QContactPresence::PresenceAvailable)
-                    return qp.presenceState();
-        }
-        foreach (const QContactPresence& qp,
-                 contact.details<QContactPresence>()) {
-            if(!qp.isEmpty())
-                if(qp.presenceState() == QContactPresence::PresenceBusy)
-                    return qp.presenceState();
+
+    const QContact *contact = rowContact(row, extractor->needsDetails);
+    if (!contact)
+        return QVariant();
+
+    return extractor->extract(*contact, priv);
+}
+
+/*! Returns the given \a roles of \a row, keyed by role number. The
+ * contact is looked up once for all of them.
+ */
+QVariantMap PeopleModel::rowData(int row, const QList<int>& roles) const
+{
+    QVariantMap values;
+    if (row < 0 || row >= priv->rows.count())
+        return values;
+
+    QList<const RoleExtractor *> extractors;
+    bool needsDetails = false;
+    foreach (int role, roles) {
+        const RoleExtractor *extractor = roleExtractor(role);
+        if (!extractor) {
+            qWarning() << "[PeopleModel] request for data with unknown row" <<
+                          row << " role : " << role;
+            continue;
         }
-        return QContactPresence::PresenceUnknown;
+        extractors.append(extractor);
+        needsDetails |= extractor->needsDetails;
     }
 
-    case UuidRole:
-    {
-        QContactGuid guid = contact.detail<QContactGuid>();
-        if(!guid.guid().isNull())
-            return guid.guid();
-        return QString();
-    }
+    const QContact *contact = rowContact(row, needsDetails);
+    if (!contact)
+        return values;
 
-    case WebUrlRole:
-    {
-        QStringList list;
-       foreach(const QContactUrl &url, contact.details<QContactUrl>()){
-        if(!url.isEmpty())
-            list << url.url();
-       }
-        return QStringList(list);
-    }
-
-    case WebContextRole:
-    {
-        QStringList list;
-       foreach(const QContactUrl &url, contact.details<QContactUrl>()){
-        if(!url.contexts().isEmpty())
-            list << url.contexts();
-       }
-        return list;
-    }
-
-    case NotesRole:
-    {
-        QContactNote note = contact.detail<QContactNote>();
-        if(!note.isEmpty())
-            return note.note();
-        return QString();
-    }
-    case FirstCharacterRole:
-    {
-        QContactName name = contact.detail<QContactName>();
-        if ((priv->sortOrder.isEmpty()) ||
-           (priv->sortOrder.at(0).detailFieldName() == QContactName::FieldFirstName)) {
-            if(!name.firstName().isNull()){
-                return QString(name.firstName().at(0).toUpper());
-            }
-        }
+    foreach (const RoleExtractor *extractor, extractors)
+        values.insert(QString::number(extractor->role), extractor->extract(*contact, priv));
+    return values;
+}
 
-        if (priv->sortOrder.at(0).detailFieldName() == QContactName::FieldLastName) {
-            if(!name.lastName().isNull()){
-                return QString(name.lastName().at(0).toUpper());
-            }
-        }
+QVariantMap PeopleModel::rowData(int row, const QVariantList& roles) const
+{
+    QList<int> roleList;
+    foreach (const QVariant &role, roles)
+        roleList.append(role.toInt());
+    return rowData(row, roleList);
+}
 
-        return QString(tr("#"));
-    }
+/*! Returns the contact on \a row, or 0 if there is none. With
+ * \a needsDetails the complete contact is returned if cached; if not,
+ * it is requested and the list projection is returned meanwhile.
+ */
+const QContact *PeopleModel::rowContact(int row, bool needsDetails) const
+{
+    return priv->store->contact(priv->rows.id(row), needsDetails);
+}
 
+/*! Returns true if the contact with \a id gets a row under the current
+ * filter. The online filter is not decided here but in acceptsRow(), as
+ * presence changes too often to move rows around.
+ */
+bool PeopleModel::isMember(QContactLocalId id) const
+{
+    switch (priv->filter) {
+    case FavoritesFilter:
+        return priv->store->isFavorite(id);
+    case ContactFilter:
+        return priv->store->uuidForId(id) == QUuid(priv->currentGuid.guid());
     default:
-        qWarning() << "[PeopleModel] request for data with unknown row" <<
-                      row << " role : " << role;
-        return QVariant();
+        return true;
     }
 }
 
 void PeopleModel::fixIndexMap()
 {
-    int i=0;
+    priv->rows.reindex();
+}
+
+/*! Rebuilds the rows from the contacts of the store.
+ */
+void PeopleModel::resetRows()
+{
+    qDebug() << Q_FUNC_INFO << "Starting model reset";
+    QElapsedTimer timer;
+    timer.start();
     beginResetModel();
-    priv->idToIndex.clear();
-    foreach (const QContactLocalId& id, priv->contactIds)
-        priv->idToIndex.insert(id, i++);
+
+    // the previous rows go in one piece with their generation, along
+    // with the selection
+    bool hadSelection = priv->rows.selectedCount() > 0;
+    const QList<QContactLocalId> &ids = priv->store->contactIds();
+    priv->rows.reset(ids.size());
+    foreach (const QContactLocalId& id, ids) {
+        if (isMember(id))
+            priv->rows.append(id);
+    }
+
+    if (!priv->query.isEmpty())
+        priv->queryMatches = priv->query.evaluate(*priv->store);
+    else if (priv->fuzzySearch && !priv->searchQuery.isEmpty())
+        priv->searchDistances = priv->store->searchIndex().distances(priv->searchQuery);
+
     endResetModel();
+    priv->resetTime = timer.elapsed();
+    if (hadSelection)
+        emit selectionChanged();
+    qDebug() << Q_FUNC_INFO << "Done with model reset in" << priv->resetTime << "ms";
 }
 
-void PeopleModel::addContacts(const QList<QContact> contactsList,
-                              int size)
+/*! Appends rows for \a contactIds.
+ */
+void PeopleModel::insertContactRows(const QList<QContactLocalId>& contactIds)
 {
-    foreach (const QContact &contact, contactsList) {
-        qDebug() << Q_FUNC_INFO << "Adding contact " << contact.id() << " local " << contact.localId();
-        QContactLocalId id = contact.localId();
-
-        priv->contactIds.push_back(id);
-        priv->idToIndex.insert(id, size++);
-        priv->idToContact.insert(id, contact);
+    if (contactIds.isEmpty())
+        return;
 
-        QContactGuid guid = contact.detail<QContactGuid>();
-        if (!guid.isEmpty()) {
-            QUuid uuid(guid.guid());
-            priv->uuidToId.insert(uuid, id);
-            priv->idToUuid.insert(id, uuid);
-        }
+    int size = priv->rows.count();
+    beginInsertRows(QModelIndex(), size, size + contactIds.size() - 1);
+    foreach (const QContactLocalId& id, contactIds) {
+        priv->rows.append(id);
+        updateSearchDistance(id);
     }
+    endInsertRows();
 }
 
-// helper function to check validity of sender and stuff.
-template<typename T> inline T *checkRequest(QObject *sender, QContactAbstractRequest::State requestState)
+/*! Removes the rows of \a contactIds, sending one removal per run of
+ * adjacent rows rather than one per contact.
+ */
+void PeopleModel::removeContactRows(const QList<QContactLocalId>& contactIds)
 {
-    qDebug() << Q_FUNC_INFO << "Request state: " << requestState;
-    T *request = qobject_cast<T *>(sender);
-    if (!request) {
-        qWarning() << Q_FUNC_INFO << "NULL request pointer";
-        return 0;
+    QList<int> removed;
+    foreach (const QContactLocalId& id, contactIds) {
+        int row = priv->rows.row(id);
+        if (row >= 0)
+            removed.append(row);
     }
 
-    if (request->error() != QContactManager::NoError) {
-        qDebug() << Q_FUNC_INFO << "Error" << request->error()
-                 << "occurred during request!";
-        request->deleteLater();
-        return 0;
-    }
+    if (removed.isEmpty())
+        return;
 
-    if (requestState != QContactAbstractRequest::FinishedState &&
-        requestState != QContactAbstractRequest::CanceledState)
-    {
-        // ignore
-        return 0;
+    qSort(removed);
+    int selected = priv->rows.selectedCount();
+
+    // remove in reverse order so the other index numbers will not change
+    int last = removed.size() - 1;
+    while (last >= 0) {
+        int first = last;
+        while (first > 0 && removed.at(first - 1) == removed.at(first) - 1)
+            first--;
+
+        int firstRow = removed.at(first);
+        int lastRow = removed.at(last);
+
+        beginRemoveRows(QModelIndex(), firstRow, lastRow);
+        for (int row = lastRow; row >= firstRow; row--) {
+            priv->searchDistances.remove(priv->rows.id(row));
+            priv->queryMatches.remove(priv->rows.id(row));
+        }
+        priv->rows.removeRows(firstRow, lastRow);
+        endRemoveRows();
+
+        last = first - 1;
     }
 
-    return request;
+    // rows after the removed ones have shifted; the views already know
+    // that from the removal signals, so only our own map needs fixing
+    fixIndexMap();
+
+    if (priv->rows.selectedCount() != selected)
+        emit selectionChanged();
 }
 
-void PeopleModel::contactsAdded(const QList<QContactLocalId>& contactIds)
+/*! Refreshes the fuzzy search distance of the contact with \a id, or
+ * whether it matches the current query.
+ */
+void PeopleModel::updateSearchDistance(QContactLocalId id)
 {
-    if (contactIds.size() == 0)
-        return;
-
-    QContactLocalIdFilter filter;
-    filter.setIds(contactIds);
-
-    QContactFetchRequest *fetchRequest = new QContactFetchRequest(this);
-    fetchRequest->setManager(priv->manager);
-    connect(fetchRequest,
-            SIGNAL(stateChanged(QContactAbstractRequest::State)),
-            SLOT(onAddedFetchChanged(QContactAbstractRequest::State)));
-    fetchRequest->setFilter(filter);
-    qDebug() << Q_FUNC_INFO << "Fetching new contacts " << contactIds;
-
-    if (!fetchRequest->start()) {
-        qWarning() << Q_FUNC_INFO << "Fetch request failed";
-        delete fetchRequest;
+    if (!priv->query.isEmpty()) {
+        if (priv->query.matches(*priv->store, id))
+            priv->queryMatches.insert(id);
+        else
+            priv->queryMatches.remove(id);
         return;
     }
-}
 
-void PeopleModel::onAddedFetchChanged(QContactAbstractRequest::State requestState)
-{
-    QContactFetchRequest *fetchRequest = checkRequest<QContactFetchRequest>(sender(), requestState);
-    if (!fetchRequest)
+    if (!priv->fuzzySearch || priv->searchQuery.isEmpty())
         return;
 
-    QList<QContact> addedContactsList = fetchRequest->contacts();
+    int distance = priv->store->searchIndex().distance(id, priv->searchQuery);
+    if (distance < 0)
+        priv->searchDistances.remove(id);
+    else
+        priv->searchDistances.insert(id, distance);
+}
 
-    int size = priv->contactIds.size();
-    int added = addedContactsList.size();
+void PeopleModel::onContactsReset()
+{
+    resetRows();
+}
 
-    beginInsertRows(QModelIndex(), size, size + added - 1);
-    addContacts(addedContactsList, size);
-    endInsertRows();
+void PeopleModel::onContactsInserted(const QList<QContactLocalId>& contactIds)
+{
+    QList<QContactLocalId> members;
+    foreach (const QContactLocalId& id, contactIds) {
+        if (isMember(id) && !priv->rows.contains(id))
+            members.append(id);
+    }
 
+    insertContactRows(members);
     qDebug() << Q_FUNC_INFO << "Done updating model after adding"
-        << added << "contacts";
-    fetchRequest->deleteLater();
+        << members.size() << "contacts";
 }
 
-void PeopleModel::contactsChanged(const QList<QContactLocalId>& contactIds)
+/*! Refreshes the rows of \a contactIds. A change may also move a
+ * contact into or out of the filter, e.g. when it is made a favorite.
+ */
+void PeopleModel::onContactsUpdated(const QList<QContactLocalId>& contactIds)
 {
-    if (contactIds.size() == 0)
-        return;
+    QList<QContactLocalId> joined;
+    QList<QContactLocalId> left;
+    QList<QContactLocalId> changed;
+    foreach (const QContactLocalId& id, contactIds) {
+        bool member = isMember(id);
+        bool hasRow = priv->rows.contains(id);
+        if (member && !hasRow)
+            joined.append(id);
+        else if (!member && hasRow)
+            left.append(id);
+        else if (member)
+            changed.append(id);
+    }
+
+    removeContactRows(left);
+
+    QList<int> rows;
+    foreach (const QContactLocalId& id, changed) {
+        rows.append(priv->rows.row(id));
+        updateSearchDistance(id);
+    }
+    qSort(rows);
+
+    // one signal per run of adjacent rows; a single range covering them
+    // all would have the proxy filter and sort every row in between
+    int first = 0;
+    while (first < rows.size()) {
+        int last = first;
+        while (last + 1 < rows.size() && rows.at(last + 1) <= rows.at(last) + 1)
+            last++;
+
+        // FIXME: unfortunate that we can't easily identify what changed
+        emit dataChanged(index(rows.at(first), 0), index(rows.at(last), 0));
+        first = last + 1;
+    }
+
+    insertContactRows(joined);
+}
 
-    QContactLocalIdFilter filter;
-    filter.setIds(contactIds);
+void PeopleModel::onContactsAboutToBeRemoved(const QList<QContactLocalId>& contactIds)
+{
+    removeContactRows(contactIds);
+
+    // removed contacts are left out of exports waiting for them
+    for (int i = 0; i < priv->pendingExports.size(); i++) {
+        PeopleModelPriv::PendingExport &pending = priv->pendingExports[i];
+        foreach (const QContactLocalId& id, contactIds) {
+            if (pending.ids.removeAll(id))
+                qWarning() << "[PeopleModel] vCard export failed for contact" << id;
+            pending.missing.remove(id);
+            pending.contacts.remove(id);
+        }
+    }
+    writePendingExports();
+}
 
-    QContactFetchRequest *fetchRequest = new QContactFetchRequest(this);
-    fetchRequest->setManager(priv->manager);
-    connect(fetchRequest,
-            SIGNAL(stateChanged(QContactAbstractRequest::State)),
-            SLOT(onChangedFetchChanged(QContactAbstractRequest::State)));
-    fetchRequest->setFilter(filter);
+/*! Moves the row of a newly created contact from its provisional id to
+ * the one the backend gave it. The row stays where it is.
+ */
+void PeopleModel::onContactIdChanged(QContactLocalId oldId, QContactLocalId newId)
+{
+    int row = priv->rows.row(oldId);
+    if (row >= 0)
+        priv->rows.setId(row, newId);
+
+    if (priv->searchDistances.contains(oldId))
+        priv->searchDistances.insert(newId, priv->searchDistances.take(oldId));
+    if (priv->queryMatches.remove(oldId))
+        priv->queryMatches.insert(newId);
+
+    for (int i = 0; i < priv->pendingExports.size(); i++) {
+        PeopleModelPriv::PendingExport &pending = priv->pendingExports[i];
+        int index = pending.ids.indexOf(oldId);
+        if (index >= 0)
+            pending.ids[index] = newId;
+        if (pending.missing.remove(oldId))
+            pending.missing.insert(newId);
+        if (pending.contacts.contains(oldId))
+            pending.contacts.insert(newId, pending.contacts.take(oldId));
+    }
+}
 
-    qDebug() << Q_FUNC_INFO << "Fetching changed contacts " << contactIds;
+void PeopleModel::onDetailsLoaded(QContactLocalId id)
+{
+    int row = priv->rows.row(id);
+    if (row >= 0) {
+        emit dataChanged(index(row, 0), index(row, 0));
+        emit detailsLoaded(row);
+    }
+
+    // exports that were waiting for the complete contact
+    const QContact *contact = 0;
+    if (priv->store->hasDetails(id))
+        contact = priv->store->contact(id, true);
+    for (int i = 0; contact && i < priv->pendingExports.size(); i++) {
+        PeopleModelPriv::PendingExport &pending = priv->pendingExports[i];
+        if (pending.missing.remove(id))
+            pending.contacts.insert(id, *contact);
+    }
+    writePendingExports();
+}
 
-    if (!fetchRequest->start()) {
-        qWarning() << Q_FUNC_INFO << "Fetch request failed";
-        delete fetchRequest;
-        return;
+/*! Starts writing the first export no longer waiting for complete
+ * contacts. The writer has a single device, so while it is busy the
+ * exports wait for vCardFinished().
+ */
+void PeopleModel::writePendingExports()
+{
+    int i = 0;
+    while (!priv->writer.device() && i < priv->pendingExports.size()) {
+        if (!priv->pendingExports.at(i).missing.isEmpty()) {
+            i++;
+            continue;
+        }
+
+        PeopleModelPriv::PendingExport pending = priv->pendingExports.takeAt(i);
+        QList<QContact> contacts;
+        foreach (const QContactLocalId& id, pending.ids) {
+            QHash<QContactLocalId, QContact>::const_iterator contact = pending.contacts.constFind(id);
+            if (contact != pending.contacts.constEnd())
+                contacts << contact.value();
+        }
+        if (contacts.isEmpty() || !writeVCards(contacts, pending.filename))
+            emit exportFinished(pending.filename, false);
     }
 }
 
-void PeopleModel::onChangedFetchChanged(QContactAbstractRequest::State requestState)
+/*! Makes sure the complete contact on \a row is loaded; detailsLoaded()
+ * is emitted once it is available.
+ */
+void PeopleModel::loadDetails(int row)
 {
-    QContactFetchRequest *fetchRequest = checkRequest<QContactFetchRequest>(sender(), requestState);
-    if (!fetchRequest)
+    if (row < 0 || row >= priv->rows.count())
         return;
 
-    // NOTE: this implementation sends one dataChanged signal with
-    // the minimal range that covers all the changed contacts, but it
-    // could be more efficient to send multiple dataChanged signals,
-    // though more work to find them
-    int min = priv->contactIds.size();
-    int max = 0;
-
-    QList<QContact> changedContactsList = fetchRequest->contacts();
+    QContactLocalId id = priv->rows.id(row);
+    if (priv->store->hasDetails(id))
+        emit detailsLoaded(row);
+    else
+        priv->store->requestDetails(id);
+}
 
-    foreach (const QContact &changedContact, changedContactsList) {
-        qDebug() << Q_FUNC_INFO << "Fetched changed contact " << changedContact.id();
-        int index =priv->idToIndex.value(changedContact.localId());
+/*! Returns all roles shown by the list delegate for \a row, keyed by
+ * role number.
+ */
+QVariantMap PeopleModel::cardData(int row) const
+{
+    if (row < 0 || row >= priv->rows.count())
+        return QVariantMap();
 
-        if (index < min)
-            min = index;
+    QContactLocalId id = priv->rows.id(row);
+    const QVariantMap *cached = priv->store->card(id);
+    if (cached)
+        return *cached;
 
-        if (index > max)
-            max = index;
+    QVariantMap card = rowData(row, cardRoles());
+    priv->store->cacheCard(id, card);
+    return card;
+}
 
-        // FIXME: this looks like it may be wrong,
-        // could lead to multiple entries
-       priv->idToContact[changedContact.localId()] = changedContact;
-    }
+/*! Warms the cards of rows \a first to \a last and returns them. The
+ * complete contacts of the \a lookahead rows following \a last are
+ * fetched in the background, so they are at hand when scrolled to.
+ */
+QVariantList PeopleModel::prefetch(int first, int last, int lookahead)
+{
+    QVariantList cards;
+    first = qMax(first, 0);
+    last = qMin(last, priv->rows.count() - 1);
+    for (int row = first; row <= last; row++)
+        cards.append(cardData(row));
 
-    // FIXME: unfortunate that we can't easily identify what changed
-    if (min <= max)
-        emit dataChanged(index(min, 0), index(max, 0));
+    int end = qMin(last + lookahead, priv->rows.count() - 1);
+    for (int row = last + 1; row <= end; row++)
+        prefetchDetails(row);
 
-    qDebug() << Q_FUNC_INFO << "Done updating model after contacts update";
-    fetchRequest->deleteLater();
+    return cards;
 }
 
-void PeopleModel::contactsRemoved(const QList<QContactLocalId>& contactIds)
+/*! Fetches the complete contact on \a row in the background, unless it
+ * is cached already.
+ */
+void PeopleModel::prefetchDetails(int row)
 {
-    qDebug() << Q_FUNC_INFO << "contacts removed:" << contactIds;
-    // FIXME: the fact that we're only notified after removal may mean that we must
-    //   store the full contact in the model, because the data could be invalid
-    //   when the view goes to access it
+    if (row < 0 || row >= priv->rows.count())
+        return;
 
-    QList<int> removed;
-    foreach (const QContactLocalId& id, contactIds)
-        removed.push_front(priv->idToIndex.value(id));
-    qSort(removed);
+    QContactLocalId id = priv->rows.id(row);
+    if (!priv->store->hasDetails(id))
+        priv->store->requestDetails(id);
+}
 
-    // NOTE: this could check for adjacent rows being removed and send fewer signals
-    int size = removed.size();
-    for (int i=0; i<size; i++) {
-        // remove in reverse order so the other index numbers will not change
-        int index = removed.takeLast();
-        beginRemoveRows(QModelIndex(), index, index);
-        QContactLocalId id = this->priv->contactIds.takeAt(index);
-
-       priv->idToContact.remove(id);
-       priv->idToIndex.remove(id);
-
-        QUuid uuid = priv->idToUuid[id];
-        if (!uuid.isNull()) {
-            priv->idToUuid.remove(id);
-           priv->uuidToId.remove(uuid);
-        }
-        endRemoveRows();
-    }
-    fixIndexMap();
+int PeopleModel::memoryBudget() const
+{
+    return priv->store->memoryBudget();
 }
 
-void PeopleModel::dataReset()
+void PeopleModel::setMemoryBudget(int bytes)
 {
-    qDebug() << Q_FUNC_INFO << "data reset";
-    QContactFetchRequest *fetchRequest = new QContactFetchRequest(this);
-    fetchRequest->setManager(priv->manager);
-    connect(fetchRequest,
-            SIGNAL(stateChanged(QContactAbstractRequest::State)),
-            SLOT(onDataResetFetchChanged(QContactAbstractRequest::State)));
-    fetchRequest->setFilter(priv->currentFilter);
+    priv->store->setMemoryBudget(bytes);
+}
 
-    if (!fetchRequest->start()) {
-        qWarning() << Q_FUNC_INFO << "Fetch request failed";
-        delete fetchRequest;
-        return;
-    }
+/*! Returns an estimate of the bytes held by the list projections of all
+ * contacts plus the cached complete contacts and pooled strings; the
+ * contacts are shared with every other model.
+ */
+int PeopleModel::memoryUsage() const
+{
+    return priv->store->memoryUsage();
 }
 
-void PeopleModel::onDataResetFetchChanged(QContactAbstractRequest::State requestState)
+QVariantMap PeopleModel::fetchStatistics() const
 {
-    QContactFetchRequest *fetchRequest = checkRequest<QContactFetchRequest>(sender(), requestState);
-    if (!fetchRequest)
-        return;
+    return priv->store->fetchStatistics();
+}
 
-    QList<QContact> contactsList = fetchRequest->contacts();
-    int size = 0;
+QVariantMap PeopleModel::internStatistics() const
+{
+    return priv->store->internStatistics();
+}
 
-    qDebug() << Q_FUNC_INFO << "Starting model reset";
-    beginResetModel();
+/*! Returns the phases of the startup of the process so far, see
+ * StartupTimeline::phases().
+ */
+QVariantList PeopleModel::startupTimeline() const
+{
+    return StartupTimeline::phases();
+}
 
-    priv->contactIds.clear();
-   priv->idToContact.clear();
-   priv->idToIndex.clear();
-   priv->uuidToId.clear();
-    priv->idToUuid.clear();
+/*! Records the contact manager notifications seen by the store, and the
+ * contacts fetched in response, to \a filename, for replaying with
+ * meego-contacts-replay.
+ */
+bool PeopleModel::startTrace(const QString& filename)
+{
+    return priv->store->startTrace(filename);
+}
 
-    addContacts(contactsList, size);
+void PeopleModel::stopTrace()
+{
+    priv->store->stopTrace();
+}
 
-    endResetModel();
-    qDebug() << Q_FUNC_INFO << "Done with model reset";
-    fetchRequest->deleteLater();
+/*! Returns the allocation statistics of the rows of this model, see
+ * RowTable::statistics(), plus the duration of the last reset in
+ * milliseconds.
+ */
+QVariantMap PeopleModel::rowStatistics() const
+{
+    QVariantMap stats = priv->rows.statistics();
+    stats.insert("resetTime", priv->resetTime);
+    return stats;
 }
 
 bool PeopleModel::createPersonModel(QString avatarUrl, QString thumbUrl, QString firstName, QString lastName, QString companyname,
@@ -787,7 +929,7 @@ bool PeopleModel::createPersonModel(QString avatarUrl, QString thumbUrl, QString
     note.setNote(notetext);
     contact.saveDetail(&note);
 
-    queueContactSave(contact);
+    priv->store->saveContact(contact);
 
     return true;
 }
@@ -799,7 +941,182 @@ void PeopleModel::deletePerson(const QString& uuid)
         return;
     }
 
-    removeContact(priv->uuidToId[uuid]);
+    removeContact(priv->store->idForUuid(uuid));
+}
+
+/*! Removes the contacts with \a uuids with a single request. The self
+ * contact is never removed.
+ */
+void PeopleModel::deletePeople(const QStringList& uuids)
+{
+    QList<QContactLocalId> ids;
+    foreach (const QString& uuid, uuids) {
+        QContactLocalId id = priv->store->idForUuid(uuid);
+        if (!priv->store->contains(id))
+            continue;
+        if (priv->store->isSelf(id)) {
+            qWarning() << Q_FUNC_INFO << "attempted to remove MeCard";
+            continue;
+        }
+        ids << id;
+    }
+
+    priv->store->removeContacts(ids);
+}
+
+/*! Returns the IM accounts contacts are reachable through, mapped to
+ * their protocol.
+ */
+QMap<QString, QString> PeopleModel::availableAccounts() const
+{
+    const AccountIndex &index = priv->store->accountIndex();
+    QMap<QString, QString> accounts;
+    foreach (const QString& account, index.accounts())
+        accounts.insert(account, index.protocol(account));
+    return accounts;
+}
+
+/*! Returns the uuids of the contacts reachable through \a accountId.
+ */
+QStringList PeopleModel::availableContacts(QString accountId) const
+{
+    QStringList uuids;
+    foreach (const QContactLocalId& id, priv->store->accountIndex().contacts(accountId)) {
+        QUuid uuid = priv->store->uuidForId(id);
+        if (!uuid.isNull())
+            uuids << uuid.toString();
+    }
+    return uuids;
+}
+
+/*! Returns the next \a count birthdays on or after \a from, today if
+ * not given, soonest first. Each is a map with the uuid of the contact,
+ * the date it falls on and the number of days until then.
+ */
+QVariantList PeopleModel::upcomingBirthdays(int count, const QDate& from) const
+{
+    QDate start = from.isValid() ? from : QDate::currentDate();
+    QVariantList birthdays;
+    foreach (const BirthdayIndex::Upcoming& upcoming,
+             priv->store->birthdayIndex().upcoming(start, count)) {
+        QVariantMap birthday;
+        birthday.insert("uuid", priv->store->uuidForId(upcoming.id).toString());
+        birthday.insert("date", upcoming.date);
+        birthday.insert("days", start.daysTo(upcoming.date));
+        birthdays.append(birthday);
+    }
+    return birthdays;
+}
+
+/*! Returns the number of days until the next birthday of the contact on
+ * \a row, or -1 if its birthday is not known.
+ */
+int PeopleModel::daysUntilBirthday(int row) const
+{
+    if (row < 0 || row >= priv->rows.count())
+        return -1;
+
+    QDate today = QDate::currentDate();
+    QDate next = priv->store->birthdayIndex().nextBirthday(priv->rows.id(row), today);
+    return next.isValid() ? today.daysTo(next) : -1;
+}
+
+/*! Returns true if the contact on \a row is reachable through the IM
+ * account \a accountId.
+ */
+bool PeopleModel::isInAccount(int row, const QString& accountId) const
+{
+    if (row < 0 || row >= priv->rows.count())
+        return false;
+
+    return priv->store->accountIndex().contains(accountId, priv->rows.id(row));
+}
+
+QStringList PeopleModel::groups() const
+{
+    return priv->store->groupIndex().groups();
+}
+
+bool PeopleModel::createGroup(const QString& group)
+{
+    return priv->store->addGroup(group);
+}
+
+bool PeopleModel::deleteGroup(const QString& group)
+{
+    return priv->store->removeGroup(group);
+}
+
+/*! Adds the contacts \a uuids to \a group, creating it if needed.
+ */
+void PeopleModel::addToGroup(const QString& group, const QStringList& uuids)
+{
+    QList<QContactLocalId> ids;
+    foreach (const QString& uuid, uuids) {
+        QContactLocalId id = priv->store->idForUuid(uuid);
+        if (priv->store->contains(id))
+            ids << id;
+    }
+    priv->store->addToGroup(group, ids);
+}
+
+void PeopleModel::removeFromGroup(const QString& group, const QStringList& uuids)
+{
+    QList<QContactLocalId> ids;
+    foreach (const QString& uuid, uuids) {
+        QContactLocalId id = priv->store->idForUuid(uuid);
+        if (priv->store->contains(id))
+            ids << id;
+    }
+    priv->store->removeFromGroup(group, ids);
+}
+
+QStringList PeopleModel::groupsOf(const QString& uuid) const
+{
+    return priv->store->groupIndex().groupsOf(QUuid(uuid));
+}
+
+/*! Returns the loaded members of \a group. Unless the user made a group
+ * of that name, "Favorites" stands for the favorite contacts, so that
+ * groups can be combined with them.
+ */
+ContactBitmap PeopleModel::groupMembers(const QString& group) const
+{
+    const GroupIndex &index = priv->store->groupIndex();
+    if (group == "Favorites" && !index.contains(group))
+        return index.favorites();
+    return index.members(group);
+}
+
+/*! Returns a number that changes whenever any groupMembers() does.
+ */
+uint PeopleModel::groupGeneration() const
+{
+    return priv->store->groupIndex().generation();
+}
+
+bool PeopleModel::isMemberOf(int row, const ContactBitmap& members) const
+{
+    if (row < 0 || row >= priv->rows.count())
+        return false;
+
+    return members.contains(priv->rows.id(row));
+}
+
+/*! Returns the rows of \a members, in ascending order; contacts without
+ * a row are left out.
+ */
+QVector<int> PeopleModel::rowsOf(const ContactBitmap& members) const
+{
+    QVector<int> rows;
+    rows.reserve(members.count());
+    foreach (const QContactLocalId& id, members.toList()) {
+        int row = priv->rows.row(id);
+        if (row >= 0)
+            rows.append(row);
+    }
+    qSort(rows);
+    return rows;
 }
 
 void PeopleModel::editPersonModel(QString uuid, QString avatarUrl, QString firstName, QString lastName, QString companyname,
@@ -809,9 +1126,12 @@ void PeopleModel::editPersonModel(QString uuid, QString avatarUrl, QString first
                                   QStringList zip, QStringList country, QStringList addresscontexts,
                                   QStringList urllinks,  QStringList urlcontexts, QDate birthday, QString notetext)
 {
-    QContactLocalId id = priv->uuidToId[uuid];
-    QContact &contact = priv->idToContact[id];
-    if (!contact.isEmpty()) {
+    QContactLocalId id = priv->store->idForUuid(uuid);
+    bool partial;
+    QContact contact = priv->store->editableContact(id, &partial);
+    // an unknown contact is created; an existing one keeps its guid, which
+    // its groups and interactions are kept under
+    if (contact.isEmpty()) {
         QContactGuid guid;
         guid.setGuid(QUuid::createUuid().toString());
         if (!contact.saveDetail(&guid))
@@ -943,19 +1263,75 @@ void PeopleModel::editPersonModel(QString uuid, QString avatarUrl, QString first
         contact.saveDetail(&note);
     }
 
-    queueContactSave(contact);
+    if (partial)
+        priv->store->saveContactPartially(contact);
+    else
+        priv->store->saveContact(contact);
+
+    // under the guid the contact has now, in case it was just created
+    priv->store->recordInteraction(contact.detail<QContactGuid>().guid(),
+                                   FrecencyIndex::Edited);
 }
 
 void PeopleModel::setCurrentUuid(const QString& uuid)
 {
     priv->currentGuid.setGuid(uuid);
     qDebug() << "sets current uuid to " << uuid << "test " << priv->currentGuid.guid();
+
+    priv->store->recordInteraction(uuid, FrecencyIndex::Viewed);
+}
+
+/*! Starts \a cmd. If it calls, messages or emails a contact, as told by
+ * \a interaction, that is recorded for \a uuid, or the current contact if
+ * none is given.
+ */
+void PeopleModel::launch(QString cmd, int interaction, QString uuid)
+{
+    QProcess::startDetached(cmd);
+
+    FrecencyIndex::Interaction recorded;
+    switch (interaction) {
+    case CallInteraction:
+        recorded = FrecencyIndex::Called;
+        break;
+    case MessageInteraction:
+        recorded = FrecencyIndex::Messaged;
+        break;
+    case EmailInteraction:
+        recorded = FrecencyIndex::Emailed;
+        break;
+    default:
+        return;
+    }
+
+    priv->store->recordInteraction(uuid.isEmpty() ? priv->currentGuid.guid() : uuid,
+                                   recorded);
+}
+
+/*! Returns the uuids of the \a count contacts interacted with the most,
+ * best first.
+ */
+QStringList PeopleModel::recentContacts(int count) const
+{
+    QStringList uuids;
+    foreach (const QUuid& uuid, priv->store->frecency().top(count))
+        uuids << uuid.toString();
+    return uuids;
+}
+
+bool PeopleModel::isRecent(int row) const
+{
+    if (row < 0 || row >= priv->rows.count())
+        return false;
+
+    return priv->store->isRecent(priv->rows.id(row));
 }
 
 void PeopleModel::toggleFavorite(const QString& uuid)
 {
-    QContactLocalId id = priv->uuidToId[uuid];
-    QContact &contact = priv->idToContact[id];
+    QContactLocalId id = priv->store->idForUuid(uuid);
+    bool partial;
+    QContact contact = priv->store->editableContact(id, &partial);
 
  if (contact.isEmpty())
         return;
@@ -968,39 +1344,197 @@ void PeopleModel::toggleFavorite(const QString& uuid)
         return;
     }
 
-    queueContactSave(contact);
+    if (partial)
+        priv->store->saveContactPartially(contact);
+    else
+        priv->store->saveContact(contact);
 }
 
-void PeopleModel::exportContact(QString uuid,  QString filename){
-    QVersitContactExporter exporter;
+/*! Makes the contacts with \a uuids favorites, or not, with a single
+ * save request and a single update of the models.
+ */
+void PeopleModel::setFavorite(const QStringList& uuids, bool favorite)
+{
     QList<QContact> contacts;
-    QList<QVersitDocument> documents;
+    foreach (const QString& uuid, uuids) {
+        QContactLocalId id = priv->store->idForUuid(uuid);
+        if (!priv->store->contains(id) || priv->store->isFavorite(id) == favorite)
+            continue;
 
-    QContactLocalId id = priv->uuidToId[uuid];
-    QContact &person = priv->idToContact[id];
+        bool partial;
+        QContact contact = priv->store->editableContact(id, &partial);
+        QContactFavorite fav = contact.detail<QContactFavorite>();
+        fav.setFavorite(favorite);
+        if (!contact.saveDetail(&fav)) {
+            qWarning() << Q_FUNC_INFO << "failed to save favorite for" << uuid;
+            continue;
+        }
+        contacts << contact;
+    }
 
-    if(person.isEmpty()){
-        qWarning() << "[PeopleModel] no contact found to export with uuid " + uuid;
+    priv->store->saveContactDetails(contacts, QStringList() << QContactFavorite::DefinitionName);
+}
+
+/*! Returns true if \a row is selected for a bulk operation. Selecting
+ * does not change the data of a row, so delegates read this again on
+ * selectionChanged() rather than on dataChanged(), and the proxy does
+ * not filter and sort the rows again.
+ */
+bool PeopleModel::isSelected(int row) const
+{
+    if (row < 0 || row >= priv->rows.count())
+        return false;
+
+    return priv->rows.isSelected(row);
+}
+
+void PeopleModel::setSelected(int row, bool selected)
+{
+    if (row < 0 || row >= priv->rows.count() || priv->rows.isSelected(row) == selected)
+        return;
+
+    priv->rows.setSelected(row, selected);
+    emit selectionChanged();
+}
+
+void PeopleModel::selectAll()
+{
+    if (priv->rows.selectedCount() == priv->rows.count())
+        return;
+
+    priv->rows.selectAll();
+    emit selectionChanged();
+}
+
+void PeopleModel::clearSelection()
+{
+    if (priv->rows.selectedCount() == 0)
+        return;
+
+    priv->rows.clearSelection();
+    emit selectionChanged();
+}
+
+int PeopleModel::selectedCount() const
+{
+    return priv->rows.selectedCount();
+}
+
+/*! Returns the uuids of the selected rows, in row order, to hand to
+ * deletePeople(), setFavorite() or exportPeople().
+ */
+QStringList PeopleModel::selectedUuids() const
+{
+    QStringList uuids;
+    foreach (int row, priv->rows.selectedRows())
+        uuids << priv->store->uuidForId(priv->rows.id(row)).toString();
+    return uuids;
+}
+
+void PeopleModel::exportContact(QString uuid,  QString filename){
+    exportPeople(QStringList() << uuid, filename);
+}
+
+/*! Writes the contacts with \a uuids to the vCard file \a filename.
+ * The file is written in the background; exportFinished() tells when it
+ * is complete.
+ */
+void PeopleModel::exportPeople(const QStringList& uuids, const QString& filename)
+{
+    PeopleModelPriv::PendingExport pending;
+    pending.filename = filename;
+    foreach (const QString& uuid, uuids) {
+        QContactLocalId id = priv->store->idForUuid(uuid);
+        if(!priv->store->contains(id)){
+            qWarning() << "[PeopleModel] no contact found to export with uuid " + uuid;
+            continue;
+        }
+
+        // the vCard needs the complete contact, not just the list projection
+        pending.ids.append(id);
+        const QContact *contact = 0;
+        if (priv->store->hasDetails(id))
+            contact = priv->store->contact(id, true);
+        if (contact)
+            pending.contacts.insert(id, *contact);
+        else
+            pending.missing.insert(id);
+    }
+
+    if (pending.ids.isEmpty()) {
+        emit exportFinished(filename, false);
         return;
     }
 
-    contacts.append(person);
+    priv->pendingExports.append(pending);
+    foreach (const QContactLocalId& id, pending.missing)
+        priv->store->requestDetails(id);
+    writePendingExports();
+}
+
+/*! Starts backing up every contact to \a filename, in the binary format
+ * of ContactBackup, which is much faster to write and read than vCards.
+ * backupProgress() reports each chunk written and backupFinished() the
+ * outcome. Returns false if a backup or restore is already running.
+ */
+bool PeopleModel::backupContacts(const QString& filename)
+{
+    return priv->backup->backup(filename);
+}
+
+/*! Starts restoring the contacts of the backup \a filename. Contacts
+ * that still exist are overwritten with their backed up version.
+ */
+bool PeopleModel::restoreContacts(const QString& filename)
+{
+    return priv->backup->restore(filename);
+}
+
+void PeopleModel::cancelBackup()
+{
+    priv->backup->cancel();
+}
+
+/*! Starts writing \a contacts to \a filename; returns false if the
+ * writing could not be started.
+ */
+bool PeopleModel::writeVCards(const QList<QContact>& contacts, const QString& filename)
+{
+    QVersitContactExporter exporter;
     exporter.exportContacts(contacts);
-    documents = exporter.documents();
+    QList<QVersitDocument> documents = exporter.documents();
 
     QFile * file = new QFile(filename);
-    if(file->open(QIODevice::ReadWrite)){
-        priv->writer.setDevice(file);
-        priv->writer.startWriting(documents);
-    }else{
-        qWarning() << "[PeopleModel] vCard export failed for contact with uuid " + uuid;
+    if(!file->open(QIODevice::ReadWrite | QIODevice::Truncate)){
+        qWarning() << "[PeopleModel] vCard export failed to open " + filename;
+        delete file;
+        return false;
     }
+
+    priv->writer.setDevice(file);
+    if (!priv->writer.startWriting(documents)) {
+        qWarning() << "[PeopleModel] vCard export failed to start for " + filename;
+        priv->writer.setDevice(0);
+        delete file;
+        return false;
+    }
+    return true;
 }
 
 void PeopleModel::vCardFinished(QVersitWriter::State state){
     if(state == QVersitWriter::FinishedState || state == QVersitWriter::CanceledState){
-        delete priv->writer.device();
+        QFile *file = qobject_cast<QFile *>(priv->writer.device());
+        QString filename = file ? file->fileName() : QString();
+        bool success = state == QVersitWriter::FinishedState
+                && priv->writer.error() == QVersitWriter::NoError;
+        delete file;
         priv->writer.setDevice(0);
+        if (!success)
+            qWarning() << "[PeopleModel] vCard export failed for " + filename;
+        emit exportFinished(filename, success);
+
+        // the next export that was waiting for the writer
+        writePendingExports();
     }
 }
 
@@ -1009,12 +1543,12 @@ void PeopleModel::setSorting(int role){
 
     switch(role){
     case LastNameRole:
-        sort.setDetailDefinitionName(QContactName::DefinitionName, 
+        sort.setDetailDefinitionName(QContactName::DefinitionName,
                                      QContactName::FieldLastName);
         break;
     case FirstNameRole:
     default:
-        sort.setDetailDefinitionName(QContactName::DefinitionName, 
+        sort.setDetailDefinitionName(QContactName::DefinitionName,
                                      QContactName::FieldFirstName);
         break;
     }
@@ -1034,232 +1568,175 @@ int PeopleModel::getSortingRole(){
     return PeopleModel::FirstNameRole;
 }
 
+// filters deciding which contacts get a row, as opposed to the online
+// filter, which only hides rows
+static bool isRowFilter(int filter)
+{
+    return filter == PeopleModel::FavoritesFilter || filter == PeopleModel::ContactFilter;
+}
+
+/*! Shows the contacts matching \a role. All filters are evaluated on the
+ * contacts held by the store, so no filter needs a backend query; with
+ * \a dataResetNeeded the rows are rebuilt for the new filter.
+ */
 void PeopleModel::setFilter(int role, bool dataResetNeeded){
+    int previousFilter = priv->filter;
+
     switch(role){
     case FavoritesFilter:
-    {
-        QContactDetailFilter favFilter;
-        favFilter.setDetailDefinitionName(QContactFavorite::DefinitionName, QContactFavorite::FieldFavorite);
-        favFilter.setValue("true");
-        priv->currentFilter = favFilter;
-        break;
-    }
     case OnlineFilter:
-    {
-        QContactDetailFilter availableFilter;
-        availableFilter.setDetailDefinitionName(QContactPresence::DefinitionName, QContactPresence::FieldPresenceState);
-        availableFilter.setValue(QContactPresence::PresenceAvailable);
-        priv->currentFilter = availableFilter;
-        break;
-    }
-    case AllFilter:
-    {
-        priv->currentFilter = QContactFilter();
-        break;
-    }
     case ContactFilter:
-    {
-        QContactDetailFilter contactFilter;
-        contactFilter.setDetailDefinitionName(QContactGuid::DefinitionName, QContactGuid::FieldGuid);
-        contactFilter.setValue(priv->currentGuid.guid());
-        priv->currentFilter = contactFilter;
+        priv->filter = role;
         break;
-    }
+    case AllFilter:
     default:
-    {
-        priv->currentFilter = QContactFilter();
+        priv->filter = AllFilter;
         break;
     }
-    }
-
-    if (dataResetNeeded)
-        dataReset();
-}
-
-void PeopleModel::searchContacts(const QString text){
 
-        qDebug() << "[PeopleModel] searchContact " + text;
-        QList<QContactFilter> filterList;
-        QContactUnionFilter unionFilter;
-
-        QContactDetailFilter nameFilter;
-        nameFilter.setDetailDefinitionName(QContactName::DefinitionName);
-        nameFilter.setValue(text);
-        nameFilter.setMatchFlags(QContactFilter::MatchContains);
-        filterList.append(nameFilter);
-
-       /* QContactDetailFilter labelFilter;
-        labelFilter.setDetailDefinitionName(QContactDisplayLabel::DefinitionName);
-        labelFilter.setValue(text);
-        labelFilter.setMatchFlags(QContactFilter::MatchContains);
-        filterList.append(labelFilter);*/
-
-        QContactDetailFilter companyFilter;
-        companyFilter.setDetailDefinitionName(QContactOrganization::DefinitionName);
-        companyFilter.setValue(text);
-        //companyFilter.setMatchFlags(QContactFilter::MatchContains);
-        filterList.append(companyFilter);
-
-        QContactDetailFilter phoneFilter;
-        phoneFilter.setDetailDefinitionName(QContactPhoneNumber::DefinitionName);
-        phoneFilter.setValue(text);
-        phoneFilter.setMatchFlags(QContactFilter::MatchPhoneNumber);
-        filterList.append(phoneFilter);
-
-       /* QContactDetailFilter emailFilter;
-        emailFilter.setDetailDefinitionName(QContactEmailAddress::DefinitionName);
-        emailFilter.setValue(text);
-        emailFilter.setMatchFlags(QContactFilter::MatchContains);
-        filterList.append(emailFilter);*/
-
-        QContactDetailFilter addressFilter;
-        addressFilter.setDetailDefinitionName(QContactAddress::DefinitionName);
-        addressFilter.setValue(text);
-        //addressFilter.setMatchFlags(QContactFilter::MatchContains);
-        filterList.append(addressFilter);
-
-       /* QContactDetailFilter urlFilter;
-        urlFilter.setDetailDefinitionName(QContactUrl::DefinitionName);
-        urlFilter.setValue(text);
-        //urlFilter.setMatchFlags(QContactFilter::MatchContains);
-        filterList.append(urlFilter);*/
-
-        unionFilter.setFilters(filterList);
-        priv->currentFilter = unionFilter;
-        dataReset();
-}
+    // presence flips constantly, so the online filter keeps every row and
+    // hides the offline ones in acceptsRow(); views see rows come and go
+    // through dataChanged
+    if ((priv->filter == OnlineFilter) != (previousFilter == OnlineFilter))
+        emit localFilterChanged();
 
-void PeopleModel::clearSearch(){
-     setFilter(AllFilter);
+    if (dataResetNeeded && (isRowFilter(priv->filter) || isRowFilter(previousFilter)))
+        resetRows();
 }
 
-
-/*! Queues a \a contact for asynchronous saving after calls
- * to QContact::saveDetail(), etc.
+/*! Returns false if \a row is hidden by a filter that does not remove
+ * rows, such as OnlineFilter or a search.
  */
-void PeopleModel::queueContactSave(QContact contactToSave)
+bool PeopleModel::acceptsRow(int row) const
 {
-    priv->contactsPendingSave.append(contactToSave);
-
-    if (contactToSave.localId()) {
-        // we save the contact to our model as well; if it existed previously.
-        // this covers our QContactManager being slow at informing us about saves
-        // with the slight problem that our data may be a little inconsistent if
-        // the QContactManager decides to save differently from what we asked
-        // it to - but this is ok, because the save request finishing will fix that.
-        int rowId =priv->idToIndex.value(contactToSave.localId());
-        qDebug() << Q_FUNC_INFO << "Faked save for " << contactToSave.localId() << " row " << rowId;
-       priv->idToContact[contactToSave.localId()] = contactToSave;
-        emit dataChanged(index(rowId, 0), index(rowId, 0));
-    }
-
-    // TODO: in a more complicated implementation, we'd only save
-    // on a timer instead of flushing all the time
-    savePendingContacts();
-}
+    if (row < 0 || row >= priv->rows.count())
+        return false;
 
-void PeopleModel::savePendingContacts()
-{
-    QContactSaveRequest *saveRequest = new QContactSaveRequest(this);
-    connect(saveRequest,
-            SIGNAL(stateChanged(QContactAbstractRequest::State)),
-            SLOT(onSaveStateChanged(QContactAbstractRequest::State)));
-    saveRequest->setContacts(priv->contactsPendingSave);
-    saveRequest->setManager(priv->manager);
+    QContactLocalId id = priv->rows.id(row);
+    if (priv->filter == OnlineFilter && !priv->store->isOnline(id))
+        return false;
 
-    foreach (const QContact &contact, priv->contactsPendingSave)
-        qDebug() << Q_FUNC_INFO << "Saving " << contact.id();
+    if (!priv->query.isEmpty())
+        return priv->queryMatches.contains(id);
 
-    if (!saveRequest->start()) {
-        qWarning() << Q_FUNC_INFO << "Save request failed: " << saveRequest->error();
-        delete saveRequest;
-    }
+    if (priv->fuzzySearch && !priv->searchQuery.isEmpty())
+        return priv->searchDistances.contains(id);
 
-    priv->contactsPendingSave.clear();
+    return priv->store->searchIndex().matches(id, priv->searchQuery);
 }
 
-void PeopleModel::onSaveStateChanged(QContactAbstractRequest::State requestState)
-{
-    QContactSaveRequest *saveRequest = checkRequest<QContactSaveRequest>(sender(), requestState);
-    if (!saveRequest)
-        return;
-
-    QList<QContact> contactList = saveRequest->contacts();
+/*! Narrows the rows to those matching \a text by name, company, email,
+ * phone number or, for CJK names, by pinyin initials, romaji or Hangul
+ * initials. The matching is done on the contacts already loaded. With
+ * fuzzySearch, names and companies a few typos away match as well.
+ *
+ * Text with field:value terms or OR, such as "company:acme is:favorite",
+ * is run as a ContactQuery over the field index of the store instead.
+ */
+void PeopleModel::searchContacts(const QString text){
+    qDebug() << "[PeopleModel] searchContact " + text;
 
-    foreach (const QContact &new_contact, contactList) {
-        qDebug() << Q_FUNC_INFO << "Successfully saved " << new_contact.id();
+    QString query = priv->store->searchIndex().prepareQuery(text);
+    bool structured = ContactQuery::isStructured(text);
+    if (query == priv->searchQuery && structured == !priv->query.isEmpty())
+        return;
 
-        // make sure data shown to user matches what is
-        // really in the database
-        QContactLocalId id = new_contact.localId();
-       priv->idToContact[id] = new_contact;
+    priv->searchQuery = query;
+    priv->query = structured ? ContactQuery::parse(text, priv->store->searchIndex())
+                             : ContactQuery();
+    priv->queryMatches.clear();
+    if (!priv->query.isEmpty()) {
+        QElapsedTimer timer;
+        timer.start();
+        priv->queryMatches = priv->query.evaluate(*priv->store);
+        priv->searchDistances.clear();
+        qDebug() << "[PeopleModel] query matched" << priv->queryMatches.size()
+                 << "contacts in" << timer.elapsed() << "ms";
+    } else if (priv->fuzzySearch && !query.isEmpty()) {
+        priv->searchDistances = priv->store->searchIndex().distances(query);
+    } else {
+        priv->searchDistances.clear();
     }
-
-    saveRequest->deleteLater();
+    emit localFilterChanged();
 }
 
-/*! Removes a given \a contactId asynchronously.
+/*! Returns the uuids of at most \a limit contacts whose name or number
+ * matches the dial pad \a keys, best match first. Meant to be called on
+ * every key press; each call narrows the results of the previous one.
  */
-void PeopleModel::removeContact(QContactLocalId contactId)
+QStringList PeopleModel::dialpadSearch(const QString& keys, int limit)
 {
-    QContactRemoveRequest *removeRequest = new QContactRemoveRequest(this);
-    removeRequest->setManager(priv->manager);
-    connect(removeRequest,
-            SIGNAL(stateChanged(QContactAbstractRequest::State)),
-            SLOT(onRemoveStateChanged(QContactAbstractRequest::State)));
-    removeRequest->setContactId(contactId);
-    qDebug() << Q_FUNC_INFO << "Removing " << contactId;
+    QStringList uuids;
+    foreach (const DialpadIndex::Hit& hit, priv->store->dialpadIndex().search(keys)) {
+        if (uuids.size() >= limit)
+            break;
 
-    if (!removeRequest->start()) {
-        qWarning() << Q_FUNC_INFO << "Remove request failed";
-        delete removeRequest;
+        QUuid uuid = priv->store->uuidForId(hit.id);
+        if (!uuid.isNull())
+            uuids << uuid.toString();
     }
+    return uuids;
 }
 
-void PeopleModel::onRemoveStateChanged(QContactAbstractRequest::State requestState)
-{
-    QContactRemoveRequest *removeRequest = checkRequest<QContactRemoveRequest>(sender(), requestState);
-    if (!removeRequest)
+void PeopleModel::clearSearch(){
+    if (priv->searchQuery.isEmpty())
         return;
 
-    qDebug() << Q_FUNC_INFO << "Removed" << removeRequest->contactIds();
-    removeRequest->deleteLater();
+    priv->searchQuery.clear();
+    priv->searchDistances.clear();
+    priv->query = ContactQuery();
+    priv->queryMatches.clear();
+    emit localFilterChanged();
+}
+
+bool PeopleModel::isSearching() const
+{
+    return !priv->searchQuery.isEmpty();
 }
 
-// For Me card support
-void PeopleModel::onMeFetchRequestStateChanged(QContactAbstractRequest::State requestState)
+bool PeopleModel::fuzzySearch() const
 {
-    QContactFetchRequest *fetchRequest = checkRequest<QContactFetchRequest>(sender(), requestState);
-    if (!fetchRequest)
+    return priv->fuzzySearch;
+}
+
+void PeopleModel::setFuzzySearch(bool fuzzy)
+{
+    if (fuzzy == priv->fuzzySearch)
         return;
 
-    // Check if we need to save Me contact again
-    bool saveMe = false;
+    priv->fuzzySearch = fuzzy;
+    priv->store->settings()->setValue("FuzzySearch", fuzzy);
+    emit fuzzySearchChanged();
 
-    if (fetchRequest->contacts().size() == 0) {
-        qDebug() << Q_FUNC_INFO << "No Me contact, saving one";
-        saveMe = true;
-    } else {
-        const QContactName &name = fetchRequest->contacts()[0].detail<QContactName>();
-        if (name.firstName().isEmpty() || name.firstName().isNull()) {
-            qDebug() << Q_FUNC_INFO << "Empty value for Me contact; saving again";
-            saveMe = true;
-        }
+    if (!priv->searchQuery.isEmpty() && priv->query.isEmpty()) {
+        if (fuzzy)
+            priv->searchDistances = priv->store->searchIndex().distances(priv->searchQuery);
+        else
+            priv->searchDistances.clear();
+        emit localFilterChanged();
     }
+}
 
-    if (saveMe)
-        createMeCard();
+/*! Saves \a contact asynchronously after calls to
+ * QContact::saveDetail(), etc.
+ */
+void PeopleModel::queueContactSave(QContact contact)
+{
+    priv->store->saveContact(contact);
+}
 
-    fetchRequest->deleteLater();
+/*! Removes a given \a contactId asynchronously.
+ */
+void PeopleModel::removeContact(QContactLocalId contactId)
+{
+    priv->store->removeContact(contactId);
 }
 
 bool PeopleModel::isSelfContact(const QContactLocalId id)
 {
-  if(id == priv->manager->selfContactId())
-    return true;
-  return false;
+  return priv->store->isSelf(id);
 }
 
 bool PeopleModel::isSelfContact(const QUuid id){
-  return isSelfContact(priv->uuidToId[id]);
+  return isSelfContact(priv->store->idForUuid(id));
 }
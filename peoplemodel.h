@@ -15,8 +15,11 @@
 #include <QAbstractListModel>
 
 #include <QUuid>
+#include <QVector>
 #include <QContactManagerEngine>
 
+#include "contactbitmap.h"
+
 QTM_USE_NAMESPACE
 class PeopleModelPriv;
 
@@ -25,6 +28,11 @@ class PeopleModel: public QAbstractListModel
     Q_OBJECT
     Q_ENUMS(PeopleRoles)
     Q_ENUMS(FilterRoles)
+    Q_ENUMS(Interactions)
+    Q_PROPERTY(int memoryBudget READ memoryBudget WRITE setMemoryBudget NOTIFY memoryBudgetChanged)
+    Q_PROPERTY(int memoryUsage READ memoryUsage NOTIFY memoryUsageChanged)
+    Q_PROPERTY(bool fuzzySearch READ fuzzySearch WRITE setFuzzySearch NOTIFY fuzzySearchChanged)
+    Q_PROPERTY(int selectedCount READ selectedCount NOTIFY selectionChanged)
 
 public:
     PeopleModel(QObject *parent = 0);
@@ -37,6 +45,14 @@ public:
         ContactFilter
     };
 
+    // what a launched command does with a contact, for the frecency log
+    enum Interactions{
+        NoInteraction = 0,
+        CallInteraction,
+        MessageInteraction,
+        EmailInteraction
+    };
+
     enum PeopleRoles{
         ContactRole = Qt::UserRole + 500,
         FirstNameRole, //533
@@ -65,7 +81,9 @@ public:
         WebUrlRole,
         WebContextRole,
         NotesRole,
-        FirstCharacterRole
+        FirstCharacterRole,
+        FrecencyRole,
+        SearchDistanceRole
     };
 
     //From QAbstractListModel
@@ -78,6 +96,8 @@ public:
 
     //QML API
     Q_INVOKABLE QVariant data(const int row, int role) const;
+    Q_INVOKABLE QVariantMap rowData(int row, const QVariantList& roles) const;
+    QVariantMap rowData(int row, const QList<int>& roles) const;
 
     Q_INVOKABLE bool createPersonModel(QString avatarUrl, QString thumbUrl, QString firstName, QString lastName,
                                        QString companyname, QStringList phonenumbers, QStringList phonecontexts,
@@ -88,6 +108,7 @@ public:
                                        QDate birthday, QString notetext);
 
     Q_INVOKABLE void deletePerson(const QString& uuid);
+    Q_INVOKABLE void deletePeople(const QStringList& uuids);
 
     Q_INVOKABLE void editPersonModel(QString contactId, QString avatarUrl, QString firstName, QString lastName, QString companyname,
                                      QStringList phonenumbers, QStringList phonecontexts, bool favorite,
@@ -98,18 +119,44 @@ public:
 
     Q_INVOKABLE QMap<QString, QString> availableAccounts() const;
     Q_INVOKABLE QStringList availableContacts(QString accountId) const;
-
-    Q_INVOKABLE void launch (QString cmd) {
-        QProcess::startDetached (cmd);
-    }
+    Q_INVOKABLE bool isInAccount(int row, const QString& accountId) const;
+    Q_INVOKABLE QVariantList upcomingBirthdays(int count = 10, const QDate& from = QDate()) const;
+    Q_INVOKABLE int daysUntilBirthday(int row) const;
+
+    Q_INVOKABLE QStringList groups() const;
+    Q_INVOKABLE bool createGroup(const QString& group);
+    Q_INVOKABLE bool deleteGroup(const QString& group);
+    Q_INVOKABLE void addToGroup(const QString& group, const QStringList& uuids);
+    Q_INVOKABLE void removeFromGroup(const QString& group, const QStringList& uuids);
+    Q_INVOKABLE QStringList groupsOf(const QString& uuid) const;
+    ContactBitmap groupMembers(const QString& group) const;
+    uint groupGeneration() const;
+    bool isMemberOf(int row, const ContactBitmap& members) const;
+    QVector<int> rowsOf(const ContactBitmap& members) const;
+
+    Q_INVOKABLE void launch(QString cmd, int interaction = NoInteraction,
+                            QString uuid = QString());
 
     Q_INVOKABLE void exportContact(QString uuid, QString filename);
+    Q_INVOKABLE void exportPeople(const QStringList& uuids, const QString& filename);
+    Q_INVOKABLE bool backupContacts(const QString& filename);
+    Q_INVOKABLE bool restoreContacts(const QString& filename);
+    Q_INVOKABLE void cancelBackup();
     Q_INVOKABLE void sort(int flags);
 
     Q_INVOKABLE void setCurrentUuid(const QString& uuid);
     QString currentUuid();
 
     Q_INVOKABLE void toggleFavorite(const QString& uuid);
+    Q_INVOKABLE void setFavorite(const QStringList& uuids, bool favorite);
+
+    Q_INVOKABLE bool isSelected(int row) const;
+    Q_INVOKABLE void setSelected(int row, bool selected);
+    Q_INVOKABLE void selectAll();
+    Q_INVOKABLE void clearSelection();
+    Q_INVOKABLE QStringList selectedUuids() const;
+    int selectedCount() const;
+
     bool isSelfContact(const QContactLocalId id);
     bool isSelfContact(const QUuid id);
     Q_INVOKABLE void setSorting(int role);
@@ -117,25 +164,58 @@ public:
     Q_INVOKABLE int getSortingRole();
     Q_INVOKABLE void searchContacts(const QString text);
     Q_INVOKABLE void clearSearch();
+    Q_INVOKABLE QVariantMap fetchStatistics() const;
+    Q_INVOKABLE QVariantMap internStatistics() const;
+    Q_INVOKABLE QVariantMap rowStatistics() const;
+    Q_INVOKABLE QVariantList startupTimeline() const;
+    Q_INVOKABLE bool startTrace(const QString& filename);
+    Q_INVOKABLE void stopTrace();
+    Q_INVOKABLE bool acceptsRow(int row) const;
+    Q_INVOKABLE void loadDetails(int row);
+    Q_INVOKABLE QVariantMap cardData(int row) const;
+    Q_INVOKABLE QVariantList prefetch(int first, int last, int lookahead = 0);
+    void prefetchDetails(int row);
+    Q_INVOKABLE QStringList recentContacts(int count = 20) const;
+    Q_INVOKABLE bool isRecent(int row) const;
+    Q_INVOKABLE QStringList dialpadSearch(const QString& keys, int limit = 20);
+
+    int memoryBudget() const;
+    void setMemoryBudget(int bytes);
+    int memoryUsage() const;
+    bool fuzzySearch() const;
+    void setFuzzySearch(bool fuzzy);
+    bool isSearching() const;
+
+signals:
+    void localFilterChanged();
+    void detailsLoaded(int row);
+    void memoryBudgetChanged();
+    void memoryUsageChanged();
+    void fuzzySearchChanged();
+    void selectionChanged();
+    void groupsChanged();
+    void backupProgress(int done, int total);
+    void backupFinished(bool success);
+    void exportFinished(const QString& filename, bool success);
 
 protected:
     void fixIndexMap();
-    void addContacts(const QList<QContact> contactsList, int size);
+    void resetRows();
+    bool isMember(QContactLocalId id) const;
+    void insertContactRows(const QList<QContactLocalId>& contactIds);
+    void removeContactRows(const QList<QContactLocalId>& contactIds);
+    void updateSearchDistance(QContactLocalId id);
+    bool writeVCards(const QList<QContact>& contacts, const QString& filename);
+    void writePendingExports();
+    const QContact *rowContact(int row, bool needsDetails) const;
 
 private slots:
-    void onSaveStateChanged(QContactAbstractRequest::State requestState);
-    void onRemoveStateChanged(QContactAbstractRequest::State requestState);
-    void onDataResetFetchChanged(QContactAbstractRequest::State requestState);
-    void onAddedFetchChanged(QContactAbstractRequest::State requestState);
-    void onChangedFetchChanged(QContactAbstractRequest::State requestState);
-    void onMeFetchRequestStateChanged(QContactAbstractRequest::State requestState);
-
-    void contactsAdded(const QList<QContactLocalId>& contactIds);
-    void contactsChanged(const QList<QContactLocalId>& contactIds);
-    void contactsRemoved(const QList<QContactLocalId>& contactIds);
-    void dataReset();
-    void savePendingContacts();
-    void createMeCard();
+    void onContactsReset();
+    void onContactsInserted(const QList<QContactLocalId>& contactIds);
+    void onContactsUpdated(const QList<QContactLocalId>& contactIds);
+    void onContactsAboutToBeRemoved(const QList<QContactLocalId>& contactIds);
+    void onContactIdChanged(QContactLocalId oldId, QContactLocalId newId);
+    void onDetailsLoaded(QContactLocalId id);
     void vCardFinished(QVersitWriter::State state);
 
 private:
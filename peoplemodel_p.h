@@ -13,44 +13,67 @@
 
 #include <QObject>
 #include <QVector>
+#include <QSet>
+#include <QHash>
+#include <QPair>
 #include <QStringList>
-#include <QSettings>
 #include <QContactGuid>
 
 #include "peoplemodel.h"
+#include "contactbackup.h"
+#include "contactquery.h"
+#include "contactstore.h"
+#include "rowtable.h"
 
 class PeopleModelPriv : public QObject
 {
     Q_OBJECT
 public:
 
-    QContactManager *manager;
-    QContactFetchHint currentFetchHint;
+    // the contacts themselves are shared with every other model
+    ContactStore *store;
     QList<QContactSortOrder> sortOrder;
-    QContactFilter currentFilter;
-    QList<QContactLocalId> contactIds;
-    QMap<QContactLocalId, int> idToIndex;
-    QMap<QContactLocalId, QContact> idToContact;
-    QMap<QUuid, QContactLocalId> uuidToId;
-    QMap<QContactLocalId, QUuid> idToUuid;
+    RowTable rows;
+    // milliseconds taken by the last reset of the rows
+    qint64 resetTime;
 
     QVersitWriter writer;
     QVersitReader reader;
+    ContactBackup *backup;
 
     QVector<QStringList> data;
     QStringList headers;
-    QSettings *settings;
     QContactGuid currentGuid;
 
-    explicit PeopleModelPriv(PeopleModel* /*parent*/){}
+    explicit PeopleModelPriv(PeopleModel* /*parent*/)
+        : store(0), resetTime(0), backup(0), filter(PeopleModel::AllFilter), fuzzySearch(true) {}
 
-    virtual ~PeopleModelPriv()
-    {
-        delete manager;
-        delete settings;
-    }
+    virtual ~PeopleModelPriv() {}
 
-    QList<QContact> contactsPendingSave;
+    // vCard exports waiting for complete contacts to be fetched, or for
+    // the writer to finish the export before them
+    struct PendingExport {
+        QList<QContactLocalId> ids;
+        QSet<QContactLocalId> missing;
+        // copied as they arrive, as the store may drop them again
+        QHash<QContactLocalId, QContact> contacts;
+        QString filename;
+    };
+    QList<PendingExport> pendingExports;
+
+    // the FilterRoles value in effect; all but OnlineFilter decide which
+    // contacts of the store get a row
+    int filter;
+
+    // the current search, matched against the search index of the store;
+    // a fuzzy search also keeps the edit distance of every matching contact
+    QString searchQuery;
+    bool fuzzySearch;
+    QHash<QContactLocalId, int> searchDistances;
+
+    // a search with field:value terms, and the contacts it matches
+    ContactQuery query;
+    QSet<QContactLocalId> queryMatches;
 
 private:
     Q_DISABLE_COPY(PeopleModelPriv);
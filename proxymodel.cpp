@@ -9,41 +9,83 @@
 #include <QDebug>
 
 #include <QStringList>
+#include <QVector>
 #include <QFileSystemWatcher>
+#include <QTimer>
 
 #include "proxymodel.h"
 #include "settingsdatastore.h"
+#include "startuptimeline.h"
+
+// rows past the visible ones whose complete contacts are fetched ahead
+static const int PrefetchLookahead = 8;
 
 class ProxyModelPriv
 {
 public:
     ProxyModel::FilterType filterType;
+    // only contacts reachable through this IM account, if set
+    QString account;
+    // only members of these groups, e.g. "Work & Favorites"; the members
+    // are combined again whenever a group changes, groupGeneration being
+    // one past the generation they were combined at, or 0
+    QString groupExpression;
+    mutable ContactBitmap groupMembers;
+    mutable uint groupGeneration;
     PeopleModel::PeopleRoles sortType;
     PeopleModel::PeopleRoles displayType;
     SettingsDataStore *settings;
     QFileSystemWatcher *settingsFileWatcher;
+
+    // accepted source rows in sorted order, and the reverse mapping
+    // (-1 for source rows the filter rejects)
+    QVector<int> proxyToSource;
+    QVector<int> sourceToProxy;
+};
+
+struct SourceRowLessThan
+{
+    SourceRowLessThan(const ProxyModel *proxy) : proxy(proxy) {}
+
+    bool operator()(int left, int right) const
+    {
+        return proxy->lessThan(left, right);
+    }
+
+    const ProxyModel *proxy;
 };
 
 ProxyModel::ProxyModel(QObject *parent)
+    : QAbstractProxyModel(parent)
 {
-    Q_UNUSED(parent);
     priv = new ProxyModelPriv;
     priv->filterType = FilterAll;
+    priv->sortType = PeopleModel::FirstNameRole;
+    priv->displayType = PeopleModel::FirstNameRole;
     priv->settings = SettingsDataStore::self();
-    setDynamicSortFilter(true);
-    setFilterKeyColumn(-1);
+    priv->settingsFileWatcher = 0;
+    priv->groupGeneration = 0;
+
+    // reading the settings from disk and watching them waits for the
+    // event loop, overlapping with the first fetch of the contacts
+    StartupTimeline::begin("proxySettings");
+    QTimer::singleShot(0, this, SLOT(watchSettings()));
+}
 
+ProxyModel::~ProxyModel()
+{
+    delete priv;
+}
+
+void ProxyModel::watchSettings()
+{
     priv->settingsFileWatcher = new QFileSystemWatcher(this);
     priv->settingsFileWatcher->addPath(priv->settings->getSettingsStoreFileName());
     connect(priv->settingsFileWatcher, SIGNAL(fileChanged(QString)),
             this, SLOT(readSettings()));
 
     readSettings();
-}
-
-ProxyModel::~ProxyModel()
-{
-    delete priv;
+    StartupTimeline::end("proxySettings");
 }
 
 void ProxyModel::readSettings() 
@@ -57,21 +99,97 @@ void ProxyModel::readSettings()
 
 void ProxyModel::setFilter(FilterType filter)
 {
+    if (filter == priv->filterType)
+        return;
+
     priv->filterType = filter;
-    invalidateFilter();
+    invalidate();
+}
+
+/*! Narrows the rows to the contacts reachable through the IM account
+ * \a account, as listed by PeopleModel::availableAccounts(), on top of
+ * the other filters. An empty \a account shows all contacts again.
+ */
+void ProxyModel::setAccountFilter(const QString& account)
+{
+    if (account == priv->account)
+        return;
+
+    priv->account = account;
+    invalidate();
+}
+
+/*! Narrows the rows to the members of the groups in \a expression, on
+ * top of the other filters. Groups are joined left to right with "&"
+ * (or U+2229) for the members of both and "|" (or U+222A) for the
+ * members of either, as in "Work & Favorites" or "Family | Friends".
+ * An empty \a expression shows all contacts again.
+ */
+void ProxyModel::setGroupFilter(const QString& expression)
+{
+    QString trimmed = expression.trimmed();
+    if (trimmed == priv->groupExpression)
+        return;
+
+    priv->groupExpression = trimmed;
+    priv->groupGeneration = 0;
+    invalidate();
+}
+
+/*! Returns the contacts the group filter lets through, combining the
+ * group bitmaps again if any of them changed since the last call.
+ */
+const ContactBitmap& ProxyModel::groupMembers() const
+{
+    PeopleModel *model = dynamic_cast<PeopleModel *>(sourceModel());
+    if (!model) {
+        priv->groupMembers.clear();
+        return priv->groupMembers;
+    }
+
+    uint generation = model->groupGeneration() + 1;
+    if (generation == priv->groupGeneration)
+        return priv->groupMembers;
+
+    ContactBitmap members;
+    QChar operation;
+    QString group;
+    for (int i = 0; i <= priv->groupExpression.size(); i++) {
+        QChar c = i < priv->groupExpression.size() ? priv->groupExpression.at(i) : QChar('|');
+        if (c != '&' && c != '|' && c != QChar(0x2229) && c != QChar(0x222a)) {
+            group += c;
+            continue;
+        }
+
+        ContactBitmap operand = model->groupMembers(group.trimmed());
+        if (operation.isNull())
+            members = operand;
+        else if (operation == '&' || operation == QChar(0x2229))
+            members = members & operand;
+        else
+            members = members | operand;
+        operation = c;
+        group.clear();
+    }
+
+    priv->groupMembers = members;
+    priv->groupGeneration = generation;
+    return priv->groupMembers;
 }
 
 void ProxyModel::setSortType(PeopleModel::PeopleRoles sortType)
 {
+    bool changed = (sortType != priv->sortType);
     priv->sortType = sortType;
-    setSortRole(sortType);
 
     PeopleModel *model = dynamic_cast<PeopleModel *>(sourceModel());
     if (model)
         model->setSorting(sortType);
 
-    reset(); //Clear the current sort method and then re-sort
-    sort(0, Qt::AscendingOrder);
+    // the settings watcher calls us for any change to the settings file;
+    // only a different sort role needs a full re-sort
+    if (changed)
+        invalidate();
 }
 
 void ProxyModel::setDisplayType(PeopleModel::PeopleRoles displayType)
@@ -81,8 +199,49 @@ void ProxyModel::setDisplayType(PeopleModel::PeopleRoles displayType)
 
 void ProxyModel::setModel(PeopleModel *model)
 {
+    if (sourceModel())
+        disconnect(sourceModel(), 0, this, 0);
+
+    beginResetModel();
     setSourceModel(model);
-    readSettings();
+    if (model) {
+        setRoleNames(model->roleNames());
+        connect(model, SIGNAL(localFilterChanged()),
+                this, SLOT(onModelFilterChanged()));
+        connect(model, SIGNAL(groupsChanged()),
+                this, SLOT(onModelGroupsChanged()));
+        connect(model, SIGNAL(modelAboutToBeReset()),
+                this, SLOT(onSourceAboutToBeReset()));
+        connect(model, SIGNAL(modelReset()),
+                this, SLOT(onSourceReset()));
+        connect(model, SIGNAL(rowsInserted(QModelIndex,int,int)),
+                this, SLOT(onSourceRowsInserted(QModelIndex,int,int)));
+        connect(model, SIGNAL(rowsAboutToBeRemoved(QModelIndex,int,int)),
+                this, SLOT(onSourceRowsAboutToBeRemoved(QModelIndex,int,int)));
+        connect(model, SIGNAL(rowsRemoved(QModelIndex,int,int)),
+                this, SLOT(onSourceRowsRemoved(QModelIndex,int,int)));
+        connect(model, SIGNAL(dataChanged(QModelIndex,QModelIndex)),
+                this, SLOT(onSourceDataChanged(QModelIndex,QModelIndex)));
+        connect(model, SIGNAL(layoutChanged()),
+                this, SLOT(onSourceReset()));
+    }
+    rebuildIndex();
+    endResetModel();
+
+    // until watchSettings() has run, it reads the settings for us
+    if (priv->settingsFileWatcher)
+        readSettings();
+}
+
+void ProxyModel::onModelFilterChanged()
+{
+    invalidate();
+}
+
+void ProxyModel::onModelGroupsChanged()
+{
+    if (!priv->groupExpression.isEmpty())
+        invalidate();
 }
 
 int ProxyModel::getSourceRow(int row)
@@ -90,40 +249,386 @@ int ProxyModel::getSourceRow(int row)
     return mapToSource(index(row, 0)).row();
 }
 
+QModelIndex ProxyModel::index(int row, int column, const QModelIndex& parent) const
+{
+    if (parent.isValid() || column != 0 || row < 0 || row >= priv->proxyToSource.size())
+        return QModelIndex();
+    return createIndex(row, column);
+}
+
+QModelIndex ProxyModel::parent(const QModelIndex& child) const
+{
+    Q_UNUSED(child);
+    return QModelIndex();
+}
+
+int ProxyModel::rowCount(const QModelIndex& parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return priv->proxyToSource.size();
+}
+
+int ProxyModel::columnCount(const QModelIndex& parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return 1;
+}
+
+QModelIndex ProxyModel::mapToSource(const QModelIndex& proxyIndex) const
+{
+    if (!sourceModel() || !proxyIndex.isValid()
+        || proxyIndex.row() >= priv->proxyToSource.size())
+        return QModelIndex();
+    return sourceModel()->index(priv->proxyToSource.at(proxyIndex.row()), 0);
+}
+
+QModelIndex ProxyModel::mapFromSource(const QModelIndex& sourceIndex) const
+{
+    if (!sourceIndex.isValid() || sourceIndex.row() >= priv->sourceToProxy.size())
+        return QModelIndex();
+
+    int row = priv->sourceToProxy.at(sourceIndex.row());
+    if (row < 0)
+        return QModelIndex();
+    return createIndex(row, 0);
+}
+
+/*! Filters and sorts all source rows from scratch. Only used when the
+ * filter or the sort role changes, or the source model is reset.
+ */
+void ProxyModel::rebuildIndex()
+{
+    priv->proxyToSource.clear();
+    priv->sourceToProxy.clear();
+
+    if (!sourceModel())
+        return;
+
+    int count = sourceModel()->rowCount();
+    priv->sourceToProxy.fill(-1, count);
+
+    // a group view only visits the rows of the members
+    PeopleModel *model = dynamic_cast<PeopleModel *>(sourceModel());
+    if (model && !priv->groupExpression.isEmpty()) {
+        QVector<int> rows = model->rowsOf(groupMembers());
+        priv->proxyToSource.reserve(rows.size());
+        foreach (int row, rows) {
+            if (filterAcceptsRow(row, QModelIndex()))
+                priv->proxyToSource.append(row);
+        }
+    } else {
+        priv->proxyToSource.reserve(count);
+        for (int row = 0; row < count; row++) {
+            if (filterAcceptsRow(row, QModelIndex()))
+                priv->proxyToSource.append(row);
+        }
+    }
+
+    qStableSort(priv->proxyToSource.begin(), priv->proxyToSource.end(),
+                SourceRowLessThan(this));
+
+    for (int i = 0; i < priv->proxyToSource.size(); i++)
+        priv->sourceToProxy[priv->proxyToSource.at(i)] = i;
+}
+
+void ProxyModel::invalidate()
+{
+    beginResetModel();
+    rebuildIndex();
+    endResetModel();
+}
+
+/*! Returns the proxy row \a sourceRow belongs at: after every row that
+ * does not sort after it, found by binary search.
+ */
+int ProxyModel::insertionPoint(int sourceRow) const
+{
+    int low = 0;
+    int high = priv->proxyToSource.size();
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (lessThan(sourceRow, priv->proxyToSource.at(mid)))
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    return low;
+}
+
+void ProxyModel::insertSourceRow(int sourceRow)
+{
+    int row = insertionPoint(sourceRow);
+
+    beginInsertRows(QModelIndex(), row, row);
+    priv->proxyToSource.insert(row, sourceRow);
+    for (int i = row; i < priv->proxyToSource.size(); i++)
+        priv->sourceToProxy[priv->proxyToSource.at(i)] = i;
+    endInsertRows();
+}
+
+/*! Inserts the accepted source rows \a sourceRows at once. They are
+ * sorted among themselves, then each is placed by binary search among the
+ * existing rows. Rows landing next to each other are inserted as one
+ * range, last range first so that the proxy rows of the ranges still to
+ * insert stay valid, and the rows are renumbered once at the end.
+ */
+void ProxyModel::insertSourceRows(QVector<int> sourceRows)
+{
+    if (sourceRows.isEmpty())
+        return;
+    if (sourceRows.size() == 1) {
+        insertSourceRow(sourceRows.first());
+        return;
+    }
+
+    qStableSort(sourceRows.begin(), sourceRows.end(), SourceRowLessThan(this));
+    QVector<int> points(sourceRows.size());
+    for (int i = 0; i < sourceRows.size(); i++)
+        points[i] = insertionPoint(sourceRows.at(i));
+
+    int end = sourceRows.size();
+    while (end > 0) {
+        int start = end - 1;
+        while (start > 0 && points.at(start - 1) == points.at(end - 1))
+            start--;
+
+        int row = points.at(start);
+        beginInsertRows(QModelIndex(), row, row + end - start - 1);
+        priv->proxyToSource.insert(row, end - start, 0);
+        for (int i = start; i < end; i++)
+            priv->proxyToSource[row + i - start] = sourceRows.at(i);
+        endInsertRows();
+        end = start;
+    }
+
+    for (int i = points.first(); i < priv->proxyToSource.size(); i++)
+        priv->sourceToProxy[priv->proxyToSource.at(i)] = i;
+}
+
+void ProxyModel::removeProxyRows(int first, int last)
+{
+    beginRemoveRows(QModelIndex(), first, last);
+    for (int i = first; i <= last; i++)
+        priv->sourceToProxy[priv->proxyToSource.at(i)] = -1;
+    priv->proxyToSource.remove(first, last - first + 1);
+    for (int i = first; i < priv->proxyToSource.size(); i++)
+        priv->sourceToProxy[priv->proxyToSource.at(i)] = i;
+    endRemoveRows();
+}
+
+/*! Brings \a sourceRow, whose data changed, up to date: it is inserted
+ * or removed if the filter now decides differently, moved if it is out
+ * of order with its neighbours, and otherwise just reported as changed.
+ */
+void ProxyModel::updateSourceRow(int sourceRow)
+{
+    int row = priv->sourceToProxy.at(sourceRow);
+    bool accepted = filterAcceptsRow(sourceRow, QModelIndex());
+
+    if (row < 0) {
+        if (accepted)
+            insertSourceRow(sourceRow);
+        return;
+    }
+
+    if (!accepted) {
+        removeProxyRows(row, row);
+        return;
+    }
+
+    int last = priv->proxyToSource.size() - 1;
+    bool inOrder = (row == 0 || !lessThan(sourceRow, priv->proxyToSource.at(row - 1)))
+            && (row == last || !lessThan(priv->proxyToSource.at(row + 1), sourceRow));
+
+    if (inOrder) {
+        emit dataChanged(index(row, 0), index(row, 0));
+        return;
+    }
+
+    // find the new place among the other rows, then move there
+    priv->proxyToSource.remove(row);
+    int target = insertionPoint(sourceRow);
+    priv->proxyToSource.insert(row, sourceRow);
+
+    // beginMoveRows() wants the destination in terms of the rows
+    // before the move
+    int destination = (target > row) ? target + 1 : target;
+    if (!beginMoveRows(QModelIndex(), row, row, QModelIndex(), destination)) {
+        emit dataChanged(index(row, 0), index(row, 0));
+        return;
+    }
+
+    priv->proxyToSource.remove(row);
+    priv->proxyToSource.insert(target, sourceRow);
+    for (int i = qMin(row, target); i <= qMax(row, target); i++)
+        priv->sourceToProxy[priv->proxyToSource.at(i)] = i;
+    endMoveRows();
+
+    emit dataChanged(index(target, 0), index(target, 0));
+}
+
+void ProxyModel::onSourceAboutToBeReset()
+{
+    beginResetModel();
+}
+
+void ProxyModel::onSourceReset()
+{
+    rebuildIndex();
+    endResetModel();
+}
+
+void ProxyModel::onSourceRowsInserted(const QModelIndex& parent, int first, int last)
+{
+    if (parent.isValid())
+        return;
+
+    // source rows at and after first have moved down
+    int count = last - first + 1;
+    for (int i = 0; i < priv->proxyToSource.size(); i++) {
+        if (priv->proxyToSource.at(i) >= first)
+            priv->proxyToSource[i] += count;
+    }
+    priv->sourceToProxy.insert(first, count, -1);
+
+    QVector<int> accepted;
+    for (int row = first; row <= last; row++) {
+        if (filterAcceptsRow(row, QModelIndex()))
+            accepted.append(row);
+    }
+    insertSourceRows(accepted);
+}
+
+void ProxyModel::onSourceRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last)
+{
+    if (parent.isValid())
+        return;
+
+    QList<int> removed;
+    for (int row = first; row <= last; row++) {
+        int proxyRow = priv->sourceToProxy.at(row);
+        if (proxyRow >= 0)
+            removed.append(proxyRow);
+    }
+    qSort(removed);
+
+    // one removal per run of adjacent proxy rows, last run first
+    int end = removed.size() - 1;
+    while (end >= 0) {
+        int start = end;
+        while (start > 0 && removed.at(start - 1) == removed.at(start) - 1)
+            start--;
+        removeProxyRows(removed.at(start), removed.at(end));
+        end = start - 1;
+    }
+}
+
+void ProxyModel::onSourceRowsRemoved(const QModelIndex& parent, int first, int last)
+{
+    if (parent.isValid())
+        return;
+
+    int count = last - first + 1;
+    priv->sourceToProxy.remove(first, count);
+    for (int i = 0; i < priv->proxyToSource.size(); i++) {
+        if (priv->proxyToSource.at(i) > last)
+            priv->proxyToSource[i] -= count;
+    }
+}
+
+void ProxyModel::onSourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight)
+{
+    if (topLeft.parent().isValid())
+        return;
+
+    for (int row = topLeft.row(); row <= bottomRight.row(); row++)
+        updateSourceRow(row);
+}
+
+QVariantMap ProxyModel::cardData(int row)
+{
+    PeopleModel *model = dynamic_cast<PeopleModel *>(sourceModel());
+    if (!model)
+        return QVariantMap();
+
+    return model->cardData(getSourceRow(row));
+}
+
+/*! Warms the cards of proxy rows \a first to \a last and returns them;
+ * the rows just after \a last are loaded in the background.
+ */
+QVariantList ProxyModel::prefetch(int first, int last)
+{
+    QVariantList cards;
+    PeopleModel *model = dynamic_cast<PeopleModel *>(sourceModel());
+    if (!model)
+        return cards;
+
+    int lastVisible = qMin(last, rowCount() - 1);
+    for (int row = qMax(first, 0); row <= lastVisible; row++)
+        cards.append(model->cardData(getSourceRow(row)));
+
+    // neighbouring proxy rows are scattered over the source model, so the
+    // lookahead is scheduled row by row
+    int end = qMin(lastVisible + PrefetchLookahead, rowCount() - 1);
+    for (int row = lastVisible + 1; row <= end; row++)
+        model->prefetchDetails(getSourceRow(row));
+
+    return cards;
+}
+
 bool ProxyModel::filterAcceptsRow(int source_row,
                                   const QModelIndex& source_parent) const
 {
-    // TODO: add communication history
     //if (!QSortFilterProxyModel::filterAcceptsRow(source_row, source_parent))
     //    return false;
 
-    if (priv->filterType == FilterAll)
-        return true;
-
     PeopleModel *model = dynamic_cast<PeopleModel *>(sourceModel());
     if (!model)
         return true;
 
+    // filters the model evaluates itself, e.g. who's online
+    if (!model->acceptsRow(source_row))
+        return false;
+
+    if (!priv->account.isEmpty() && !model->isInAccount(source_row, priv->account))
+        return false;
+
+    if (!priv->groupExpression.isEmpty() && !model->isMemberOf(source_row, groupMembers()))
+        return false;
+
+    if (priv->filterType == FilterAll)
+        return true;
+
     if (priv->filterType == FilterFavorites) {
         QModelIndex modelIndex = sourceModel()->index(source_row, 0, source_parent);
         //return model->index(source_row, PeopleModel::FavoriteRole).data(DataRole);
         return (model->data(modelIndex, PeopleModel::FavoriteRole) == "Favorite");
     }
+    else if (priv->filterType == FilterRecent) {
+        return model->isRecent(source_row);
+    }
+    else if (priv->filterType == FilterBirthdays) {
+        return model->daysUntilBirthday(source_row) >= 0;
+    }
     else {
         qWarning() << "[ProxyModel] invalid filter type";
         return true;
     }
 }
 
-bool ProxyModel::lessThan(const QModelIndex& left,
-                          const QModelIndex& right) const
+bool ProxyModel::lessThan(int leftRow, int rightRow) const
 {
     PeopleModel *model = dynamic_cast<PeopleModel *>(sourceModel());
     if (!model)
         return true;
 
     if ((priv->sortType != PeopleModel::FirstNameRole) 
-        && (priv->sortType != PeopleModel::LastNameRole))
+        && (priv->sortType != PeopleModel::LastNameRole)
+        && (priv->sortType != PeopleModel::FrecencyRole)
+        && (priv->sortType != PeopleModel::BirthdayRole))
         return false;
 
     int searchRole = PeopleModel::FirstNameRole;
@@ -134,11 +639,11 @@ bool ProxyModel::lessThan(const QModelIndex& left,
         secondaryRole = PeopleModel::FirstNameRole;
     }
 
-    const QString& lStr = model->data(left.row(), searchRole).toString();
-    const bool isleftSelf = model->data(left.row(), PeopleModel::IsSelfRole).toBool();
+    const QString& lStr = model->data(leftRow, searchRole).toString();
+    const bool isleftSelf = model->data(leftRow, PeopleModel::IsSelfRole).toBool();
 
-    const QString& rStr = model->data(right.row(), searchRole).toString();
-    const bool isrightSelf = model->data(right.row(), PeopleModel::IsSelfRole).toBool();
+    const QString& rStr = model->data(rightRow, searchRole).toString();
+    const bool isrightSelf = model->data(rightRow, PeopleModel::IsSelfRole).toBool();
 
     //qWarning() << "[ProxyModel] lessThan isSelf left" << isleftSelf << " right" << isrightSelf;
 
@@ -148,8 +653,33 @@ bool ProxyModel::lessThan(const QModelIndex& left,
     if(isrightSelf)
         return false;
 
-    const QString& lStr2 = model->data(left.row(), secondaryRole).toString();
-    const QString& rStr2 = model->data(right.row(), secondaryRole).toString();
+    //Closest search matches first
+    if (model->isSearching()) {
+        const int lDistance = model->data(leftRow, PeopleModel::SearchDistanceRole).toInt();
+        const int rDistance = model->data(rightRow, PeopleModel::SearchDistanceRole).toInt();
+        if (lDistance != rDistance)
+            return lDistance < rDistance;
+    }
+
+    //Next birthdays first; no birthday (-1) wraps to the largest unsigned
+    //value, putting those contacts after them, by name
+    if (priv->sortType == PeopleModel::BirthdayRole) {
+        const uint lDays = model->daysUntilBirthday(leftRow);
+        const uint rDays = model->daysUntilBirthday(rightRow);
+        if (lDays != rDays)
+            return lDays < rDays;
+    }
+
+    //Most recently and frequently contacted first, the rest by name
+    if (priv->sortType == PeopleModel::FrecencyRole) {
+        const double lScore = model->data(leftRow, PeopleModel::FrecencyRole).toDouble();
+        const double rScore = model->data(rightRow, PeopleModel::FrecencyRole).toDouble();
+        if (lScore != rScore)
+            return lScore > rScore;
+    }
+
+    const QString& lStr2 = model->data(leftRow, secondaryRole).toString();
+    const QString& rStr2 = model->data(rightRow, secondaryRole).toString();
 
     //qWarning() << "[ProxyModel] lessThan " << lStr << "VS" << rStr << "compare returns:" << QString::localeAwareCompare(lStr, rStr);
 
@@ -9,12 +9,13 @@
 #ifndef PROXYMODEL_H
 #define PROXYMODEL_H
 
-#include <QSortFilterProxyModel>
+#include <QAbstractProxyModel>
 #include "peoplemodel.h"
 
 class ProxyModelPriv;
+struct SourceRowLessThan;
 
-class ProxyModel: public QSortFilterProxyModel
+class ProxyModel: public QAbstractProxyModel
 {
     Q_OBJECT
     Q_ENUMS(FilterType)
@@ -26,23 +27,56 @@ public:
     enum FilterType {
         FilterAll,
         FilterFavorites,
+        FilterRecent,
+        FilterBirthdays
     };
 
     Q_INVOKABLE virtual void setFilter(FilterType filter);
+    Q_INVOKABLE void setAccountFilter(const QString& account);
+    Q_INVOKABLE void setGroupFilter(const QString& expression);
     Q_INVOKABLE virtual void setSortType(PeopleModel::PeopleRoles sortType);
     Q_INVOKABLE virtual void setDisplayType(PeopleModel::PeopleRoles displayType);
     Q_INVOKABLE void setModel(PeopleModel *model);
     Q_INVOKABLE int getSourceRow(int row);
+    Q_INVOKABLE QVariantMap cardData(int row);
+    Q_INVOKABLE QVariantList prefetch(int first, int last);
+
+    //From QAbstractProxyModel
+    virtual QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const;
+    virtual QModelIndex parent(const QModelIndex& child) const;
+    virtual int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    virtual int columnCount(const QModelIndex& parent = QModelIndex()) const;
+    virtual QModelIndex mapToSource(const QModelIndex& proxyIndex) const;
+    virtual QModelIndex mapFromSource(const QModelIndex& sourceIndex) const;
 
 protected:
     virtual bool filterAcceptsRow(int source_row, const QModelIndex& source_parent) const;
-    virtual bool lessThan(const QModelIndex& left, const QModelIndex& right) const;
+    virtual bool lessThan(int leftRow, int rightRow) const;
+
+    void rebuildIndex();
+    void invalidate();
+    int insertionPoint(int sourceRow) const;
+    void insertSourceRow(int sourceRow);
+    void insertSourceRows(QVector<int> sourceRows);
+    void removeProxyRows(int first, int last);
+    void updateSourceRow(int sourceRow);
+    const ContactBitmap& groupMembers() const;
 
 private slots:
+    void watchSettings();
     void readSettings();
+    void onModelFilterChanged();
+    void onModelGroupsChanged();
+    void onSourceAboutToBeReset();
+    void onSourceReset();
+    void onSourceRowsInserted(const QModelIndex& parent, int first, int last);
+    void onSourceRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+    void onSourceRowsRemoved(const QModelIndex& parent, int first, int last);
+    void onSourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
 
 private:
     ProxyModelPriv *priv;
+    friend struct SourceRowLessThan;
     Q_DISABLE_COPY(ProxyModel);
 };
 
@@ -0,0 +1,284 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rowtable.h"
+
+static const int BlockSize = 64 * 1024;
+static const int MinCapacity = 64;
+
+static inline int bitWords(int bits)
+{
+    return (bits + 31) >> 5;
+}
+
+static inline uint slotHash(QContactLocalId id)
+{
+    uint hash = id * 2654435761u;
+    return hash ^ (hash >> 16);
+}
+
+RowTable::RowTable()
+    : mFirstBlockSize(0), mBlockSize(0), mBlockUsed(0),
+      mIds(0), mSelected(0), mCount(0), mCapacity(0), mSelectedCount(0),
+      mSlots(0), mSlotMask(0),
+      mGeneration(0), mHeapAllocations(0), mTotalHeapAllocations(0),
+      mArenaBytes(0)
+{
+}
+
+RowTable::~RowTable()
+{
+    foreach (char *block, mBlocks)
+        free(block);
+}
+
+/*! Drops all rows and starts a new generation with room for \a capacity
+ * rows. The first arena block is reused if it is large enough, so
+ * resetting to a similar number of rows does not touch the heap.
+ */
+void RowTable::reset(int capacity)
+{
+    capacity = qMax(capacity, MinCapacity);
+    int slotCount = 1;
+    while (slotCount < 2 * capacity)
+        slotCount <<= 1;
+    int needed = capacity * sizeof(QContactLocalId) + bitWords(capacity) * sizeof(quint32)
+            + slotCount * sizeof(Slot) + 32;
+
+    releaseBlocks();
+    if (mFirstBlockSize < needed && !mBlocks.isEmpty()) {
+        free(mBlocks.takeFirst());
+        mArenaBytes -= mFirstBlockSize;
+        mFirstBlockSize = 0;
+        mBlockSize = 0;
+    }
+
+    mGeneration++;
+    mHeapAllocations = 0;
+    mIds = 0;
+    mSelected = 0;
+    mCount = 0;
+    mCapacity = 0;
+    mSelectedCount = 0;
+    mSlots = 0;
+    mSlotMask = 0;
+
+    if (mBlocks.isEmpty()) {
+        mBlocks.append(static_cast<char *>(malloc(qMax(needed, BlockSize))));
+        mFirstBlockSize = mBlockSize = qMax(needed, BlockSize);
+        mArenaBytes += mFirstBlockSize;
+        mHeapAllocations++;
+        mTotalHeapAllocations++;
+    }
+
+    reserve(capacity);
+}
+
+void RowTable::releaseBlocks()
+{
+    while (mBlocks.size() > 1)
+        free(mBlocks.takeLast());
+    mArenaBytes = mFirstBlockSize;
+    mBlockSize = mFirstBlockSize;
+    mBlockUsed = 0;
+}
+
+void *RowTable::allocate(int bytes)
+{
+    bytes = (bytes + 7) & ~7;
+    if (mBlocks.isEmpty() || mBlockUsed + bytes > mBlockSize) {
+        mBlockSize = qMax(bytes, BlockSize);
+        mBlocks.append(static_cast<char *>(malloc(mBlockSize)));
+        if (mBlocks.size() == 1)
+            mFirstBlockSize = mBlockSize;
+        mBlockUsed = 0;
+        mArenaBytes += mBlockSize;
+        mHeapAllocations++;
+        mTotalHeapAllocations++;
+    }
+
+    void *memory = mBlocks.last() + mBlockUsed;
+    mBlockUsed += bytes;
+    return memory;
+}
+
+void RowTable::reserve(int capacity)
+{
+    if (capacity <= mCapacity)
+        return;
+
+    capacity = qMax(capacity, qMax(2 * mCapacity, MinCapacity));
+    QContactLocalId *ids = static_cast<QContactLocalId *>(
+            allocate(capacity * sizeof(QContactLocalId)));
+    if (mCount)
+        memcpy(ids, mIds, mCount * sizeof(QContactLocalId));
+    mIds = ids;
+
+    quint32 *selected = static_cast<quint32 *>(allocate(bitWords(capacity) * sizeof(quint32)));
+    memset(selected, 0, bitWords(capacity) * sizeof(quint32));
+    if (mCount)
+        memcpy(selected, mSelected, bitWords(mCount) * sizeof(quint32));
+    mSelected = selected;
+    mCapacity = capacity;
+
+    // keep the table at most half full
+    int slotCount = 1;
+    while (slotCount < 2 * capacity)
+        slotCount <<= 1;
+    if (slotCount > mSlotMask + 1)
+        rehash(slotCount);
+}
+
+void RowTable::rehash(int slotCount)
+{
+    mSlots = static_cast<Slot *>(allocate(slotCount * sizeof(Slot)));
+    mSlotMask = slotCount - 1;
+    reindex();
+}
+
+/*! Rebuilds the row of every contact id, after rows were removed.
+ */
+void RowTable::reindex()
+{
+    if (!mSlots)
+        return;
+
+    memset(mSlots, 0, (mSlotMask + 1) * sizeof(Slot));
+    for (int row = 0; row < mCount; row++)
+        insertSlot(mIds[row], row);
+}
+
+void RowTable::insertSlot(QContactLocalId id, int row)
+{
+    uint i = slotHash(id) & mSlotMask;
+    while (mSlots[i].id != 0 && mSlots[i].id != id)
+        i = (i + 1) & mSlotMask;
+    mSlots[i].id = id;
+    mSlots[i].row = row;
+}
+
+/*! Returns the row of \a id, or -1 if it has none.
+ */
+int RowTable::row(QContactLocalId id) const
+{
+    if (!mSlots || id == 0)
+        return -1;
+
+    uint i = slotHash(id) & mSlotMask;
+    while (mSlots[i].id != 0) {
+        if (mSlots[i].id == id)
+            return mSlots[i].row;
+        i = (i + 1) & mSlotMask;
+    }
+    return -1;
+}
+
+void RowTable::append(QContactLocalId id)
+{
+    if (mCount == mCapacity)
+        reserve(mCount + 1);
+
+    mIds[mCount] = id;
+    insertSlot(id, mCount);
+    mCount++;
+}
+
+/*! Gives \a row the contact id \a id instead of its current one.
+ */
+void RowTable::setId(int row, QContactLocalId id)
+{
+    mIds[row] = id;
+    reindex();
+}
+
+/*! Removes rows \a first to \a last. The rows of the contacts that
+ * follow are only updated by reindex(), so that removing several runs
+ * of rows renumbers them once.
+ */
+void RowTable::removeRows(int first, int last)
+{
+    int removed = last - first + 1;
+    memmove(mIds + first, mIds + last + 1,
+            (mCount - last - 1) * sizeof(QContactLocalId));
+
+    for (int row = first; row <= last; row++) {
+        if (isSelected(row))
+            mSelectedCount--;
+    }
+    for (int row = first; row < mCount - removed; row++)
+        setBit(row, isSelected(row + removed));
+    for (int row = mCount - removed; row < mCount; row++)
+        setBit(row, false);
+
+    mCount -= removed;
+}
+
+void RowTable::setBit(int row, bool set)
+{
+    if (set)
+        mSelected[row >> 5] |= 1u << (row & 31);
+    else
+        mSelected[row >> 5] &= ~(1u << (row & 31));
+}
+
+void RowTable::setSelected(int row, bool selected)
+{
+    if (isSelected(row) == selected)
+        return;
+
+    setBit(row, selected);
+    mSelectedCount += selected ? 1 : -1;
+}
+
+void RowTable::selectAll()
+{
+    for (int row = 0; row < mCount; row++)
+        setBit(row, true);
+    mSelectedCount = mCount;
+}
+
+void RowTable::clearSelection()
+{
+    if (mSelected)
+        memset(mSelected, 0, bitWords(mCount) * sizeof(quint32));
+    mSelectedCount = 0;
+}
+
+/*! Returns the selected rows in ascending order.
+ */
+QList<int> RowTable::selectedRows() const
+{
+    QList<int> rows;
+    for (int word = 0; word < bitWords(mCount) && rows.size() < mSelectedCount; word++) {
+        quint32 bits = mSelected[word];
+        for (int bit = 0; bits; bit++, bits >>= 1) {
+            if (bits & 1)
+                rows << (word << 5) + bit;
+        }
+    }
+    return rows;
+}
+
+/*! Returns the generation number, the number of rows, the heap
+ * allocations made in this generation and in total, and the bytes and
+ * blocks held by the arena.
+ */
+QVariantMap RowTable::statistics() const
+{
+    QVariantMap stats;
+    stats.insert("generation", mGeneration);
+    stats.insert("rows", mCount);
+    stats.insert("heapAllocations", mHeapAllocations);
+    stats.insert("totalHeapAllocations", mTotalHeapAllocations);
+    stats.insert("arenaBytes", mArenaBytes);
+    stats.insert("arenaBlocks", mBlocks.size());
+    return stats;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef ROWTABLE_H
+#define ROWTABLE_H
+
+#include <QList>
+#include <QVariantMap>
+#include <QContact>
+
+QTM_USE_NAMESPACE
+
+/*! The rows of a PeopleModel: the contact id on every row and the row of
+ * every contact id.
+ *
+ * Both live in one generation of a bump allocated arena instead of a
+ * list and a map allocating a node per contact. reset() starts a new
+ * generation, releasing the previous one at once, so a filter change or
+ * a reload costs a handful of heap allocations however many rows it
+ * replaces. Arrays outgrown within a generation are left behind in the
+ * arena until the next reset.
+ *
+ * Contact ids are looked up in an open addressed table; 0 is never a
+ * valid QContactLocalId and marks free slots. The rows selected for bulk
+ * operations are kept in a bitset next to the ids.
+ */
+class RowTable
+{
+public:
+    RowTable();
+    ~RowTable();
+
+    void reset(int capacity = 0);
+
+    int count() const { return mCount; }
+    QContactLocalId id(int row) const { return mIds[row]; }
+    int row(QContactLocalId id) const;
+    bool contains(QContactLocalId id) const { return row(id) >= 0; }
+
+    void append(QContactLocalId id);
+    void setId(int row, QContactLocalId id);
+    void removeRows(int first, int last);
+    void reindex();
+
+    bool isSelected(int row) const { return mSelected[row >> 5] & (1u << (row & 31)); }
+    void setSelected(int row, bool selected);
+    void selectAll();
+    void clearSelection();
+    int selectedCount() const { return mSelectedCount; }
+    QList<int> selectedRows() const;
+
+    QVariantMap statistics() const;
+
+private:
+    void *allocate(int bytes);
+    void releaseBlocks();
+    void reserve(int capacity);
+    void rehash(int slotCount);
+    void insertSlot(QContactLocalId id, int row);
+    void setBit(int row, bool set);
+
+    struct Slot {
+        QContactLocalId id;
+        int row;
+    };
+
+    // arena: mBlocks[0] is kept across generations, the rest are freed
+    QList<char *> mBlocks;
+    int mFirstBlockSize;
+    int mBlockSize;
+    int mBlockUsed;
+
+    QContactLocalId *mIds;
+    quint32 *mSelected;
+    int mCount;
+    int mCapacity;
+    int mSelectedCount;
+
+    Slot *mSlots;
+    int mSlotMask;
+
+    int mGeneration;
+    int mHeapAllocations;
+    int mTotalHeapAllocations;
+    int mArenaBytes;
+
+    Q_DISABLE_COPY(RowTable);
+};
+
+#endif // ROWTABLE_H
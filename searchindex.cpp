@@ -0,0 +1,424 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QDebug>
+
+#include <QStringList>
+#include <QTextCodec>
+#include <QContactName>
+#include <QContactOrganization>
+#include <QContactPhoneNumber>
+#include <QContactEmailAddress>
+
+#include <string.h>
+
+#include "searchindex.h"
+
+static const QChar KeySeparator('\n');
+
+// Level 1 of GB2312 (0xB0A1 - 0xD7F9) is ordered by pinyin, so the
+// initial of a common Chinese character follows from the first code of
+// each initial. Level 2 is ordered by radical and has no initials.
+static const struct {
+    ushort firstCode;
+    char initial;
+} PinyinBoundaries[] = {
+    { 0xB0A1, 'a' }, { 0xB0C5, 'b' }, { 0xB2C1, 'c' }, { 0xB4EE, 'd' },
+    { 0xB6EA, 'e' }, { 0xB7A2, 'f' }, { 0xB8C1, 'g' }, { 0xB9FE, 'h' },
+    { 0xBBF7, 'j' }, { 0xBFA6, 'k' }, { 0xC0AC, 'l' }, { 0xC2E8, 'm' },
+    { 0xC4C3, 'n' }, { 0xC5B6, 'o' }, { 0xC5BE, 'p' }, { 0xC6DA, 'q' },
+    { 0xC8BB, 'r' }, { 0xC8F6, 's' }, { 0xCBFA, 't' }, { 0xCDDA, 'w' },
+    { 0xCEF4, 'x' }, { 0xD1B9, 'y' }, { 0xD4D1, 'z' }
+};
+static const ushort PinyinLevel1End = 0xD7FA;
+
+// Hepburn readings of hiragana U+3041 - U+3096
+static const char * const KanaRomaji[] = {
+    "a", "a", "i", "i", "u", "u", "e", "e", "o", "o",
+    "ka", "ga", "ki", "gi", "ku", "gu", "ke", "ge", "ko", "go",
+    "sa", "za", "shi", "ji", "su", "zu", "se", "ze", "so", "zo",
+    "ta", "da", "chi", "ji", "", "tsu", "zu", "te", "de", "to", "do",
+    "na", "ni", "nu", "ne", "no",
+    "ha", "ba", "pa", "hi", "bi", "pi", "fu", "bu", "pu",
+    "he", "be", "pe", "ho", "bo", "po",
+    "ma", "mi", "mu", "me", "mo",
+    "ya", "ya", "yu", "yu", "yo", "yo",
+    "ra", "ri", "ru", "re", "ro",
+    "wa", "wa", "i", "e", "o", "n", "vu", "ka", "ke"
+};
+static const ushort HiraganaFirst = 0x3041;
+static const ushort HiraganaLast = 0x3096;
+static const ushort SmallTsu = 0x3063;
+static const ushort SmallYa = 0x3083;
+static const ushort SmallYu = 0x3085;
+static const ushort SmallYo = 0x3087;
+static const ushort ProlongedSoundMark = 0x30FC;
+
+typedef char kanaRomajiComplete[
+        (sizeof(KanaRomaji) / sizeof(KanaRomaji[0]) == HiraganaLast - HiraganaFirst + 1) ? 1 : -1];
+
+static const ushort HangulFirst = 0xAC00;
+static const ushort HangulLast = 0xD7A3;
+// syllables sharing an initial consonant: 21 vowels times 28 finals
+static const int HangulSyllablesPerChoseong = 21 * 28;
+// the 19 initial consonants, in syllable order
+static const ushort ChoseongFirst = 0x1100;
+static const ushort ChoseongLast = 0x1112;
+
+// longest query matched fuzzily, the bits in a pattern mask
+static const int MaxFuzzyLength = 64;
+
+/*
+ * Bit-parallel approximate matching (G. Myers, "A fast bit-vector
+ * algorithm for approximate string matching based on dynamic
+ * programming", 1999). A column of the edit distance matrix is kept as
+ * vertical deltas in two words, so each character of the text costs a
+ * handful of word operations regardless of the query length.
+ */
+class FuzzyPattern
+{
+public:
+    explicit FuzzyPattern(const QString &pattern)
+        : mLength(qMin(pattern.size(), MaxFuzzyLength))
+    {
+        memset(mAscii, 0, sizeof(mAscii));
+        for (int i = 0; i < mLength; i++) {
+            ushort c = pattern.at(i).unicode();
+            if (c < 128)
+                mAscii[c] |= quint64(1) << i;
+            else
+                mOther[c] |= quint64(1) << i;
+        }
+    }
+
+    // the smallest number of edits turning the pattern into a substring
+    // of \a text, or -1 if that takes more than \a maxErrors
+    int distance(const QString &text, int maxErrors) const
+    {
+        quint64 pv = ~quint64(0);
+        quint64 mv = 0;
+        const quint64 high = quint64(1) << (mLength - 1);
+        int score = mLength;
+        int best = score;
+
+        const QChar *c = text.constData();
+        const QChar *end = c + text.size();
+        for (; c != end; ++c) {
+            quint64 eq = mask(c->unicode());
+            quint64 xv = eq | mv;
+            quint64 xh = (((eq & pv) + pv) ^ pv) | eq;
+            quint64 ph = mv | ~(xh | pv);
+            quint64 mh = pv & xh;
+
+            if (ph & high)
+                score++;
+            else if (mh & high)
+                score--;
+
+            // a match may start anywhere in the text, so the top row of
+            // the matrix stays zero and nothing is shifted in
+            ph <<= 1;
+            mh <<= 1;
+            pv = mh | ~(xv | ph);
+            mv = ph & xv;
+
+            if (score < best) {
+                best = score;
+                if (best == 0)
+                    break;
+            }
+        }
+
+        return best <= maxErrors ? best : -1;
+    }
+
+private:
+    quint64 mask(ushort c) const
+    {
+        return c < 128 ? mAscii[c] : mOther.value(c);
+    }
+
+    int mLength;
+    quint64 mAscii[128];
+    QHash<ushort, quint64> mOther;
+};
+
+SearchIndex::SearchIndex()
+{
+}
+
+static void addKey(QStringList &keys, const QString &key)
+{
+    if (!key.isEmpty() && !keys.contains(key))
+        keys << key;
+}
+
+// the plain text of \a text plus whatever readings apply to it
+static void addTextKeys(QStringList &keys, const QString &text)
+{
+    QString folded = SearchIndex::fold(text);
+    if (folded.isEmpty())
+        return;
+
+    addKey(keys, folded);
+    addKey(keys, SearchIndex::pinyinInitials(folded));
+    addKey(keys, SearchIndex::choseong(folded));
+
+    QString reading = SearchIndex::romaji(folded);
+    if (reading != folded)
+        addKey(keys, reading);
+}
+
+/*! Builds the search keys of \a contact, replacing any earlier ones.
+ */
+void SearchIndex::insert(QContactLocalId id, const QContact &contact)
+{
+    QStringList keys;
+
+    QContactName name = contact.detail<QContactName>();
+    QString first = name.firstName();
+    QString last = name.lastName();
+
+    // Western names are typed given name first, CJK names family name
+    // first and without a space
+    addTextKeys(keys, first + " " + last);
+    addTextKeys(keys, last + first);
+    addTextKeys(keys, contact.detail<QContactOrganization>().name());
+
+    foreach (const QContactEmailAddress &email, contact.details<QContactEmailAddress>())
+        addKey(keys, fold(email.emailAddress()));
+
+    foreach (const QContactPhoneNumber &phone, contact.details<QContactPhoneNumber>()) {
+        QString digits;
+        foreach (const QChar &c, phone.number()) {
+            if (c.isDigit())
+                digits += c;
+        }
+        addKey(keys, digits);
+    }
+
+    mKeys.insert(id, keys.join(KeySeparator));
+    mNames.insert(id, fold(first + " " + last) + KeySeparator
+                  + fold(contact.detail<QContactOrganization>().name()));
+}
+
+void SearchIndex::remove(QContactLocalId id)
+{
+    mKeys.remove(id);
+    mNames.remove(id);
+}
+
+void SearchIndex::clear()
+{
+    mKeys.clear();
+    mNames.clear();
+}
+
+/*! Returns \a text in the form matches() expects. Phone numbers are
+ * reduced to their digits, anything else is folded like the keys.
+ */
+QString SearchIndex::prepareQuery(const QString &text) const
+{
+    QString query = fold(text).trimmed();
+
+    QString digits;
+    foreach (const QChar &c, query) {
+        if (c.isDigit())
+            digits += c;
+        else if (!c.isSpace() && c != '-' && c != '(' && c != ')' && c != '+' && c != '.')
+            return query;
+    }
+
+    return digits.isEmpty() ? query : digits;
+}
+
+bool SearchIndex::matches(QContactLocalId id, const QString &preparedQuery) const
+{
+    if (preparedQuery.isEmpty())
+        return true;
+
+    QHash<QContactLocalId, QString>::const_iterator it = mKeys.constFind(id);
+    if (it == mKeys.constEnd())
+        return false;
+
+    return it.value().contains(preparedQuery);
+}
+
+/*! Returns the number of typos tolerated in \a preparedQuery: none for
+ * short queries, where almost anything would match, up to two for long
+ * ones.
+ */
+int SearchIndex::maxErrors(const QString &preparedQuery)
+{
+    int length = preparedQuery.size();
+    if (length <= 3 || length > MaxFuzzyLength)
+        return 0;
+    return length <= 6 ? 1 : 2;
+}
+
+/*! Returns 0 if the contact with \a id matches \a preparedQuery exactly,
+ * the number of edits its name or company is away from containing the
+ * query if that is within maxErrors(), and -1 otherwise.
+ */
+int SearchIndex::distance(QContactLocalId id, const QString &preparedQuery) const
+{
+    if (matches(id, preparedQuery))
+        return 0;
+
+    int errors = maxErrors(preparedQuery);
+    if (errors == 0)
+        return -1;
+
+    return FuzzyPattern(preparedQuery).distance(mNames.value(id), errors);
+}
+
+/*! Returns the distance() of every contact within reach of
+ * \a preparedQuery, preparing the query only once.
+ */
+QHash<QContactLocalId, int> SearchIndex::distances(const QString &preparedQuery) const
+{
+    QHash<QContactLocalId, int> result;
+    int errors = maxErrors(preparedQuery);
+    FuzzyPattern pattern(preparedQuery);
+
+    for (QHash<QContactLocalId, QString>::const_iterator it = mKeys.constBegin();
+         it != mKeys.constEnd(); ++it) {
+        if (it.value().contains(preparedQuery)) {
+            result.insert(it.key(), 0);
+        } else if (errors > 0) {
+            int distance = pattern.distance(mNames.value(it.key()), errors);
+            if (distance >= 0)
+                result.insert(it.key(), distance);
+        }
+    }
+
+    return result;
+}
+
+/*! Returns \a text case folded, in compatibility form, with accents
+ * removed from Latin letters and katakana turned into hiragana.
+ */
+QString SearchIndex::fold(const QString &text)
+{
+    QString compat = text.normalized(QString::NormalizationForm_KC);
+    QString folded;
+    folded.reserve(compat.size());
+
+    foreach (const QChar &c, compat) {
+        ushort u = c.unicode();
+        if (u >= 0x30A1 && u <= 0x30F6) {
+            folded += QChar(u - 0x60);
+        } else if (u < 0x0250 && c.decompositionTag() == QChar::Canonical) {
+            foreach (const QChar &part, c.decomposition()) {
+                if (part.category() != QChar::Mark_NonSpacing)
+                    folded += part;
+            }
+        } else if (c != KeySeparator) {
+            folded += c;
+        }
+    }
+
+    return folded.toCaseFolded();
+}
+
+/*! Returns the pinyin initials of the common Chinese characters in
+ * \a text, e.g. "zs" for 张三. Other characters are left out.
+ */
+QString SearchIndex::pinyinInitials(const QString &text)
+{
+    static QTextCodec *codec = QTextCodec::codecForName("GB2312");
+    if (!codec)
+        return QString();
+
+    static const int boundaryCount = sizeof(PinyinBoundaries) / sizeof(PinyinBoundaries[0]);
+
+    QString initials;
+    foreach (const QChar &c, text) {
+        if (c.unicode() < 0x4E00 || c.unicode() > 0x9FFF)
+            continue;
+
+        QByteArray encoded = codec->fromUnicode(QString(c));
+        if (encoded.size() != 2)
+            continue;
+
+        ushort code = (uchar(encoded.at(0)) << 8) | uchar(encoded.at(1));
+        if (code < PinyinBoundaries[0].firstCode || code >= PinyinLevel1End)
+            continue;
+
+        int i = boundaryCount - 1;
+        while (code < PinyinBoundaries[i].firstCode)
+            i--;
+        initials += QLatin1Char(PinyinBoundaries[i].initial);
+    }
+
+    return initials;
+}
+
+/*! Returns \a text with its hiragana spelled out in Hepburn romaji;
+ * other characters are kept. Expects text from fold().
+ */
+QString SearchIndex::romaji(const QString &text)
+{
+    QString result;
+    bool geminate = false;
+
+    for (int i = 0; i < text.size(); i++) {
+        ushort c = text.at(i).unicode();
+
+        if (c == SmallTsu) {
+            geminate = true;
+            continue;
+        }
+        if (c == ProlongedSoundMark)
+            continue;
+        if (c < HiraganaFirst || c > HiraganaLast) {
+            result += text.at(i);
+            geminate = false;
+            continue;
+        }
+
+        QString syllable = QLatin1String(KanaRomaji[c - HiraganaFirst]);
+
+        // a small ya, yu or yo contracts with the i-row kana before it
+        if (i + 1 < text.size() && syllable.size() > 1 && syllable.endsWith('i')) {
+            ushort next = text.at(i + 1).unicode();
+            if (next == SmallYa || next == SmallYu || next == SmallYo) {
+                syllable.chop(1);
+                if (syllable != "sh" && syllable != "ch" && syllable != "j")
+                    syllable += 'y';
+                syllable += (next == SmallYa ? 'a' : next == SmallYu ? 'u' : 'o');
+                i++;
+            }
+        }
+
+        // a small tsu doubles the next consonant
+        if (geminate && !syllable.isEmpty())
+            syllable.prepend(syllable.startsWith("ch") ? QChar('t') : syllable.at(0));
+        geminate = false;
+
+        result += syllable;
+    }
+
+    return result;
+}
+
+/*! Returns the initial consonant of every Hangul syllable in \a text, as
+ * conjoining jamo, which is also what fold() turns typed jamo into.
+ */
+QString SearchIndex::choseong(const QString &text)
+{
+    QString initials;
+    foreach (const QChar &c, text) {
+        ushort u = c.unicode();
+        if (u >= HangulFirst && u <= HangulLast)
+            initials += QChar(ChoseongFirst + (u - HangulFirst) / HangulSyllablesPerChoseong);
+        else if (u >= ChoseongFirst && u <= ChoseongLast)
+            initials += c;
+    }
+    return initials;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QContact>
+
+QTM_USE_NAMESPACE
+
+/*! Matches search text against contacts held in memory.
+ *
+ * Each contact gets a set of search keys, built once when it is stored:
+ * its folded names, company, email addresses and phone digits, and the
+ * ways CJK users type names: pinyin initials of Chinese characters, a
+ * romaji reading of kana and the initial consonants (choseong) of Hangul
+ * syllables. A query matches a contact if any key contains it.
+ *
+ * Fuzzy matching tolerates typos in names and companies: a contact
+ * matches if some part of them is within a few edits of the query,
+ * computed with Myers' bit-parallel algorithm, one machine word per
+ * query.
+ */
+class SearchIndex
+{
+public:
+    SearchIndex();
+
+    void insert(QContactLocalId id, const QContact &contact);
+    void remove(QContactLocalId id);
+    void clear();
+
+    QString prepareQuery(const QString &text) const;
+    bool matches(QContactLocalId id, const QString &preparedQuery) const;
+    int distance(QContactLocalId id, const QString &preparedQuery) const;
+    QHash<QContactLocalId, int> distances(const QString &preparedQuery) const;
+
+    static int maxErrors(const QString &preparedQuery);
+
+    static QString fold(const QString &text);
+    static QString pinyinInitials(const QString &text);
+    static QString romaji(const QString &text);
+    static QString choseong(const QString &text);
+
+private:
+    // every key of a contact, separated by newlines
+    QHash<QContactLocalId, QString> mKeys;
+    // the folded name and company, searched by fuzzy matching
+    QHash<QContactLocalId, QString> mNames;
+};
+
+#endif // SEARCHINDEX_H
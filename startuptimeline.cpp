@@ -0,0 +1,109 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QDebug>
+
+#include <QElapsedTimer>
+#include <QList>
+
+#include "startuptimeline.h"
+
+namespace {
+
+struct Phase {
+    QString name;
+    qint64 start;
+    qint64 end;
+};
+
+QElapsedTimer startupClock;
+QList<Phase> timeline;
+bool finishing = false;
+bool logged = false;
+
+}
+
+/*! Marks the beginning of \a phase. A phase is only recorded once; later
+ * calls for the same name are ignored.
+ */
+void StartupTimeline::begin(const char *phase)
+{
+    if (!startupClock.isValid())
+        startupClock.start();
+
+    QString name = QLatin1String(phase);
+    foreach (const Phase &recorded, timeline) {
+        if (recorded.name == name)
+            return;
+    }
+
+    Phase started = { name, startupClock.elapsed(), -1 };
+    timeline.append(started);
+}
+
+void StartupTimeline::end(const char *phase)
+{
+    QString name = QLatin1String(phase);
+    bool open = false;
+    for (int i = 0; i < timeline.size(); i++) {
+        Phase &recorded = timeline[i];
+        if (recorded.name == name && recorded.end < 0)
+            recorded.end = startupClock.elapsed();
+        open |= recorded.end < 0;
+    }
+
+    if (!open && finishing && !logged)
+        log();
+}
+
+/*! Declares the startup done once the phases still running have ended,
+ * and logs the timeline then.
+ */
+void StartupTimeline::finish()
+{
+    finishing = true;
+    foreach (const Phase &recorded, timeline) {
+        if (recorded.end < 0)
+            return;
+    }
+
+    if (!logged)
+        log();
+}
+
+/*! Returns one map per phase, in the order they began, with the phase
+ * name, its start and its duration in milliseconds. The duration of a
+ * phase still running is -1.
+ */
+QVariantList StartupTimeline::phases()
+{
+    QVariantList phases;
+    foreach (const Phase &recorded, timeline) {
+        QVariantMap phase;
+        phase.insert("phase", recorded.name);
+        phase.insert("start", recorded.start);
+        phase.insert("duration", recorded.end < 0 ? -1 : recorded.end - recorded.start);
+        phases.append(phase);
+    }
+    return phases;
+}
+
+void StartupTimeline::log()
+{
+    logged = true;
+
+    qint64 total = 0;
+    foreach (const Phase &recorded, timeline)
+        total = qMax(total, recorded.end);
+
+    qDebug() << "[StartupTimeline] startup took" << total << "ms";
+    foreach (const Phase &recorded, timeline) {
+        qDebug() << "[StartupTimeline]" << qPrintable(recorded.name.leftJustified(16))
+                 << "at" << recorded.start << "ms for" << recorded.end - recorded.start << "ms";
+    }
+}
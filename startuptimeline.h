@@ -0,0 +1,35 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef STARTUPTIMELINE_H
+#define STARTUPTIMELINE_H
+
+#include <QVariantList>
+
+/*! Records when each phase of the startup of the process begins and
+ * ends, in milliseconds since the first phase began.
+ *
+ * Phases may overlap; the manager, the me card check, the settings and
+ * the first fetch of the contacts run side by side. The timeline is
+ * logged once per process, after finish() and the end of every phase
+ * that was begun.
+ */
+class StartupTimeline
+{
+public:
+    static void begin(const char *phase);
+    static void end(const char *phase);
+    static void finish();
+
+    static QVariantList phases();
+
+private:
+    static void log();
+};
+
+#endif // STARTUPTIMELINE_H
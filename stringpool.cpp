@@ -0,0 +1,102 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include "stringpool.h"
+
+StringPool::StringPool()
+    : mBytes(0)
+{
+}
+
+/*! Returns the handle of \a str, adding it to the pool if needed, or -1
+ * if it is not pooled because it is too long or the pool is full.
+ */
+int StringPool::handle(const QString &str)
+{
+    QHash<QString, int>::const_iterator it = mHandles.constFind(str);
+    if (it != mHandles.constEnd())
+        return it.value();
+
+    if (str.size() > MaxLength || mStrings.size() >= MaxStrings)
+        return -1;
+
+    int handle = mStrings.size();
+    mStrings.append(str);
+    mHandles.insert(str, handle);
+    mBytes += stringBytes(str);
+    return handle;
+}
+
+const QString &StringPool::string(int handle) const
+{
+    return mStrings.at(handle);
+}
+
+/*! Returns the pooled copy of \a str, or \a str itself if it is not
+ * pooled.
+ */
+QString StringPool::intern(const QString &str)
+{
+    if (str.isEmpty())
+        return str;
+
+    int h = handle(str);
+    return h < 0 ? str : mStrings.at(h);
+}
+
+QStringList StringPool::intern(const QStringList &list)
+{
+    QStringList interned;
+    foreach (const QString &str, list)
+        interned << intern(str);
+    return interned;
+}
+
+QUrl StringPool::intern(const QUrl &url)
+{
+    if (url.isEmpty())
+        return url;
+
+    QString key = url.toString();
+    QHash<QString, QUrl>::const_iterator it = mUrls.constFind(key);
+    if (it != mUrls.constEnd())
+        return it.value();
+
+    if (key.size() > MaxLength || mUrls.size() >= MaxStrings)
+        return url;
+
+    mUrls.insert(key, url);
+    mBytes += stringBytes(key);
+    return url;
+}
+
+/*! Returns true if \a str shares its data with the pooled copy.
+ */
+bool StringPool::isInterned(const QString &str) const
+{
+    QHash<QString, int>::const_iterator it = mHandles.constFind(str);
+    return it != mHandles.constEnd()
+            && mStrings.at(it.value()).constData() == str.constData();
+}
+
+int StringPool::size() const
+{
+    return mStrings.size() + mUrls.size();
+}
+
+/*! Returns the bytes held by the pooled strings.
+ */
+int StringPool::bytes() const
+{
+    return mBytes;
+}
+
+int StringPool::stringBytes(const QString &str)
+{
+    return 16 + 2 * str.size();
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QUrl>
+#include <QVector>
+
+/*! Shares one copy of strings that repeat across many contacts.
+ *
+ * Context labels, service providers, countries, company names and theme
+ * avatar urls take few distinct values in even the largest address book.
+ * Each distinct value is stored once and given a small integer handle;
+ * intern() returns the stored copy, so that every contact holding the
+ * value points at the same implicitly shared data.
+ *
+ * Strings are never released, so only short values are taken, and at
+ * most MaxStrings of them.
+ */
+class StringPool
+{
+public:
+    StringPool();
+
+    int handle(const QString &str);
+    const QString &string(int handle) const;
+
+    QString intern(const QString &str);
+    QStringList intern(const QStringList &list);
+    QUrl intern(const QUrl &url);
+
+    bool isInterned(const QString &str) const;
+
+    int size() const;
+    int bytes() const;
+
+    // byte cost of a string that is not shared
+    static int stringBytes(const QString &str);
+
+    static const int MaxLength = 64;
+    static const int MaxStrings = 8192;
+
+private:
+    QHash<QString, int> mHandles;
+    QVector<QString> mStrings;
+    QHash<QString, QUrl> mUrls;
+    int mBytes;
+};
+
+#endif // STRINGPOOL_H
@@ -0,0 +1,159 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QtTest/QtTest>
+
+#include <QContactManager>
+#include <QContactGuid>
+#include <QContactName>
+
+#include "contactstore.h"
+#include "frecencyindex.h"
+#include "peoplemodel.h"
+
+// how long the store may take to see a change of the backend
+static const int Timeout = 5000;
+
+/*
+ * A contact keeps its groups and its place among the recent contacts
+ * when it is edited, and when the backend gives it a new guid.
+ */
+class tst_ContactIdentity: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void editKeepsIdentity();
+    void newGuidKeepsIdentity();
+
+private:
+    QContactLocalId addContact(const QString& firstName);
+    bool waitFor(QContactLocalId id, const QString& firstName);
+    void edit(const QString& uuid, const QString& firstName);
+
+    ContactStore *mStore;
+    PeopleModel *mModel;
+};
+
+void tst_ContactIdentity::initTestCase()
+{
+    // a throwaway address book, leaving the ranking and groups alone
+    ContactStore::setManagerName("memory");
+    ContactStore::setFrecencyPersistent(false);
+
+    mStore = ContactStore::acquire();
+    mModel = new PeopleModel(this);
+
+    QElapsedTimer timer;
+    timer.start();
+    while (!mStore->isLoaded() && timer.elapsed() < Timeout)
+        QTest::qWait(10);
+    QVERIFY(mStore->isLoaded());
+    QVERIFY(mModel->createGroup("Family"));
+}
+
+void tst_ContactIdentity::cleanupTestCase()
+{
+    delete mModel;
+    mStore->release();
+}
+
+/*! Saves a new contact straight to the backend and returns its id once
+ * the store has it, or 0.
+ */
+QContactLocalId tst_ContactIdentity::addContact(const QString& firstName)
+{
+    QContact contact;
+    QContactGuid guid;
+    guid.setGuid(QUuid::createUuid().toString());
+    contact.saveDetail(&guid);
+    QContactName name;
+    name.setFirstName(firstName);
+    contact.saveDetail(&name);
+
+    if (!mStore->manager()->saveContact(&contact))
+        return 0;
+    return waitFor(contact.localId(), firstName) ? contact.localId() : 0;
+}
+
+// whether the store gets to see contact id with firstName in time
+bool tst_ContactIdentity::waitFor(QContactLocalId id, const QString& firstName)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < Timeout) {
+        const QContact *contact = mStore->contact(id, false);
+        if (contact && contact->detail<QContactName>().firstName() == firstName)
+            return true;
+        QTest::qWait(10);
+    }
+    return false;
+}
+
+void tst_ContactIdentity::edit(const QString& uuid, const QString& firstName)
+{
+    mModel->editPersonModel(uuid, QString(), firstName, QString(), QString(),
+                            QStringList(), QStringList(), false,
+                            QStringList(), QStringList(), QStringList(),
+                            QStringList(), QStringList(), QStringList(), QStringList(),
+                            QStringList(), QStringList(), QStringList(),
+                            QStringList(), QStringList(), QDate(), QString());
+}
+
+void tst_ContactIdentity::editKeepsIdentity()
+{
+    QContactLocalId id = addContact("Alice");
+    QVERIFY(id != 0);
+    QString uuid = mStore->uuidForId(id).toString();
+
+    mModel->addToGroup("Family", QStringList() << uuid);
+    mStore->recordInteraction(uuid, FrecencyIndex::Called);
+    QVERIFY(mStore->isRecent(id));
+
+    edit(uuid, "Alicia");
+    QVERIFY(waitFor(id, "Alicia"));
+
+    QCOMPARE(mStore->uuidForId(id).toString(), uuid);
+    QVERIFY(mStore->isRecent(id));
+    QVERIFY(mModel->groupsOf(uuid).contains("Family"));
+}
+
+void tst_ContactIdentity::newGuidKeepsIdentity()
+{
+    QContactLocalId id = addContact("Bob");
+    QVERIFY(id != 0);
+    QUuid previous = mStore->uuidForId(id);
+
+    mModel->addToGroup("Family", QStringList() << previous.toString());
+    mStore->recordInteraction(previous, FrecencyIndex::Emailed);
+    QVERIFY(mStore->isRecent(id));
+
+    // as another application, or a sync, might
+    QContact contact = mStore->manager()->contact(id);
+    QContactGuid guid = contact.detail<QContactGuid>();
+    guid.setGuid(QUuid::createUuid().toString());
+    contact.saveDetail(&guid);
+    QContactName name = contact.detail<QContactName>();
+    name.setFirstName("Robert");
+    contact.saveDetail(&name);
+    QVERIFY(mStore->manager()->saveContact(&contact));
+    QVERIFY(waitFor(id, "Robert"));
+
+    QUuid uuid = mStore->uuidForId(id);
+    QCOMPARE(uuid.toString(), guid.guid());
+    QVERIFY(mStore->isRecent(id));
+    QVERIFY(mModel->groupsOf(uuid.toString()).contains("Family"));
+    QVERIFY(mModel->groupsOf(previous.toString()).isEmpty());
+    QVERIFY(!mStore->frecency().contains(previous));
+}
+
+QTEST_MAIN(tst_ContactIdentity)
+#include "tst_contactidentity.moc"
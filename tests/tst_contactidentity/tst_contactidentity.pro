@@ -0,0 +1,57 @@
+PROJECT_NAME = tst_contactidentity
+
+TEMPLATE = app
+TARGET = tst_contactidentity
+CONFIG += qt \
+        qtestlib \
+        mobility \
+        link_pkgconfig
+
+PKGCONFIG += QtVersit
+
+MOBILITY = contacts versit
+
+OBJECTS_DIR = .obj
+MOC_DIR = .moc
+
+# tests the same store and model as the application uses
+INCLUDEPATH += ../..
+DEPENDPATH += ../..
+
+HEADERS += \
+    ../../accountindex.h \
+    ../../birthdayindex.h \
+    ../../contactbackup.h \
+    ../../contactbitmap.h \
+    ../../contactquery.h \
+    ../../contactstore.h \
+    ../../contacttrace.h \
+    ../../dialpadindex.h \
+    ../../fieldindex.h \
+    ../../frecencyindex.h \
+    ../../groupindex.h \
+    ../../peoplemodel.h \
+    ../../peoplemodel_p.h \
+    ../../rowtable.h \
+    ../../searchindex.h \
+    ../../startuptimeline.h \
+    ../../stringpool.h
+
+SOURCES += \
+    tst_contactidentity.cpp \
+    ../../accountindex.cpp \
+    ../../birthdayindex.cpp \
+    ../../contactbackup.cpp \
+    ../../contactbitmap.cpp \
+    ../../contactquery.cpp \
+    ../../contactstore.cpp \
+    ../../contacttrace.cpp \
+    ../../dialpadindex.cpp \
+    ../../fieldindex.cpp \
+    ../../frecencyindex.cpp \
+    ../../groupindex.cpp \
+    ../../peoplemodel.cpp \
+    ../../rowtable.cpp \
+    ../../searchindex.cpp \
+    ../../startuptimeline.cpp \
+    ../../stringpool.cpp
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QDebug>
+
+#include <QStringList>
+
+#include "replayapplication.h"
+#include "tracereplayer.h"
+#include "contactstore.h"
+#include "contacttrace.h"
+
+/*
+ * meego-contacts-replay [--speed <factor>] <trace>
+ *
+ * Replays a trace recorded with PeopleModel::startTrace() or with
+ * MEEGO_CONTACTS_TRACE set into the memory backend, and reports what the
+ * model did with it. --speed 2 replays twice as fast as recorded; 0
+ * replays without pauses.
+ */
+int main(int argc, char *argv[])
+{
+    ReplayApplication app(argc, argv);
+
+    double speed = 1.0;
+    QString fileName;
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); i++) {
+        bool ok = true;
+        if (args.at(i) == "--speed" && i + 1 < args.size())
+            speed = args.at(++i).toDouble(&ok);
+        else if (fileName.isEmpty() && !args.at(i).startsWith("--"))
+            fileName = args.at(i);
+        else
+            ok = false;
+
+        if (!ok || speed < 0) {
+            fileName.clear();
+            break;
+        }
+    }
+
+    if (fileName.isEmpty()) {
+        qWarning() << "usage:" << args.at(0) << "[--speed <factor>] <trace>";
+        return 1;
+    }
+
+    // replay into a throwaway address book, leaving the ranking alone
+    ContactStore::setManagerName("memory");
+    ContactStore::setFrecencyPersistent(false);
+
+    bool ok = false;
+    QList<ContactTrace::Event> events = ContactTrace::load(fileName, &ok);
+    if (!ok) {
+        qWarning() << "[TraceReplay] cannot read trace" << fileName;
+        return 1;
+    }
+
+    TraceReplayer replayer(events, speed);
+    QObject::connect(&replayer, SIGNAL(finished()), &app, SLOT(quit()));
+    replayer.start();
+
+    return app.exec();
+}
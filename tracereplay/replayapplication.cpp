@@ -0,0 +1,68 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QElapsedTimer>
+
+#include "replayapplication.h"
+
+ReplayApplication::ReplayApplication(int &argc, char **argv)
+    : QApplication(argc, argv, false), mDepth(0), mBusy(0), mLongest(0), mDiscount(0)
+{
+}
+
+ReplayApplication *ReplayApplication::instance()
+{
+    return static_cast<ReplayApplication *>(QCoreApplication::instance());
+}
+
+/*! Times the delivery of top level events; events sent while one is
+ * being handled are part of it.
+ */
+bool ReplayApplication::notify(QObject *receiver, QEvent *event)
+{
+    if (mDepth > 0)
+        return QApplication::notify(receiver, event);
+
+    QElapsedTimer timer;
+    timer.start();
+    mDepth++;
+    mDiscount = 0;
+    bool result = QApplication::notify(receiver, event);
+    mDepth--;
+
+    qint64 elapsed = qMax(qint64(0), timer.nsecsElapsed() - mDiscount);
+    mBusy += elapsed;
+    mLongest = qMax(mLongest, elapsed);
+    return result;
+}
+
+void ReplayApplication::resetBusyTime()
+{
+    mBusy = 0;
+    mLongest = 0;
+}
+
+/*! Leaves \a nsecs out of the event being delivered.
+ */
+void ReplayApplication::discount(qint64 nsecs)
+{
+    mDiscount += nsecs;
+}
+
+/*! Returns the nanoseconds spent delivering events since
+ * resetBusyTime().
+ */
+qint64 ReplayApplication::busyTime() const
+{
+    return mBusy;
+}
+
+qint64 ReplayApplication::longestEvent() const
+{
+    return mLongest;
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef REPLAYAPPLICATION_H
+#define REPLAYAPPLICATION_H
+
+#include <QApplication>
+
+/*! Measures how long the GUI thread is busy delivering events, and the
+ * longest single event: the stalls the user would see.
+ *
+ * Time spent injecting the trace into the backend is discount()ed, so
+ * that only the application's own work is counted.
+ */
+class ReplayApplication: public QApplication
+{
+public:
+    ReplayApplication(int &argc, char **argv);
+
+    virtual bool notify(QObject *receiver, QEvent *event);
+
+    void resetBusyTime();
+    void discount(qint64 nsecs);
+    qint64 busyTime() const;
+    qint64 longestEvent() const;
+
+    static ReplayApplication *instance();
+
+private:
+    int mDepth;
+    qint64 mBusy;
+    qint64 mLongest;
+    qint64 mDiscount;
+};
+
+#endif // REPLAYAPPLICATION_H
@@ -0,0 +1,64 @@
+PROJECT_NAME = meego-contacts-replay
+
+TEMPLATE = app
+TARGET = meego-contacts-replay
+CONFIG += qt \
+        mobility \
+        link_pkgconfig
+
+PKGCONFIG += QtVersit
+
+MOBILITY = contacts versit
+
+OBJECTS_DIR = .obj
+MOC_DIR = .moc
+
+# replays into the same store and model as the application uses
+INCLUDEPATH += ..
+DEPENDPATH += ..
+
+HEADERS += \
+    replayapplication.h \
+    tracereplayer.h \
+    ../accountindex.h \
+    ../birthdayindex.h \
+    ../contactbackup.h \
+    ../contactbitmap.h \
+    ../contactquery.h \
+    ../contactstore.h \
+    ../contacttrace.h \
+    ../dialpadindex.h \
+    ../fieldindex.h \
+    ../frecencyindex.h \
+    ../groupindex.h \
+    ../peoplemodel.h \
+    ../peoplemodel_p.h \
+    ../rowtable.h \
+    ../searchindex.h \
+    ../startuptimeline.h \
+    ../stringpool.h
+
+SOURCES += \
+    main.cpp \
+    replayapplication.cpp \
+    tracereplayer.cpp \
+    ../accountindex.cpp \
+    ../birthdayindex.cpp \
+    ../contactbackup.cpp \
+    ../contactbitmap.cpp \
+    ../contactquery.cpp \
+    ../contactstore.cpp \
+    ../contacttrace.cpp \
+    ../dialpadindex.cpp \
+    ../fieldindex.cpp \
+    ../frecencyindex.cpp \
+    ../groupindex.cpp \
+    ../peoplemodel.cpp \
+    ../rowtable.cpp \
+    ../searchindex.cpp \
+    ../startuptimeline.cpp \
+    ../stringpool.cpp
+
+target.path += $$INSTALL_ROOT/usr/bin
+
+INSTALLS += target
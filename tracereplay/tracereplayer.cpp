@@ -0,0 +1,344 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QDebug>
+
+#include <QFile>
+#include <QTextStream>
+#include <QContactManager>
+
+#include "tracereplayer.h"
+#include "replayapplication.h"
+#include "contactstore.h"
+#include "peoplemodel.h"
+
+// how long the store must be quiet before loading or draining is over
+static const int QuietInterval = 1000;
+
+static const char *eventName(ContactTrace::EventType type)
+{
+    switch (type) {
+    case ContactTrace::Snapshot:
+        return "snapshot";
+    case ContactTrace::ContactsAdded:
+        return "contactsAdded";
+    case ContactTrace::ContactsChanged:
+        return "contactsChanged";
+    case ContactTrace::ContactsRemoved:
+        return "contactsRemoved";
+    case ContactTrace::DataChanged:
+        return "dataChanged";
+    case ContactTrace::FetchResult:
+        return "fetchResult";
+    }
+    return "unknown";
+}
+
+// peak resident size of this process in kB, or 0 if unknown
+static int peakMemory()
+{
+    QFile file("/proc/self/status");
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return 0;
+
+    QTextStream in(&file);
+    for (QString line = in.readLine(); !line.isNull(); line = in.readLine()) {
+        if (line.startsWith("VmHWM:"))
+            return line.mid(6).trimmed().section(' ', 0, 0).toInt();
+    }
+    return 0;
+}
+
+TraceReplayer::TraceReplayer(const QList<ContactTrace::Event> &events, double speed,
+                             QObject *parent)
+    : QObject(parent), mEvents(events), mSpeed(speed), mPhase(Loading), mNextEvent(0),
+      mStartTime(0),
+      mStore(0), mModel(0), mInjectTime(0),
+      mRowsInserted(0), mRowsRemoved(0), mRowsChanged(0), mPeakMemoryBefore(0)
+{
+    for (int event = 0; event < mEvents.size(); event++) {
+        const ContactTrace::Event &e = mEvents.at(event);
+        if (e.type != ContactTrace::FetchResult && e.type != ContactTrace::Snapshot)
+            continue;
+        for (int i = 0; i < e.contacts.size(); i++)
+            mFetched[e.ids.at(i)] << qMakePair(event, i);
+    }
+
+    mQuietTimer.setSingleShot(true);
+    mQuietTimer.setInterval(QuietInterval);
+    connect(&mQuietTimer, SIGNAL(timeout()), this, SLOT(onQuiet()));
+
+    mEventTimer.setSingleShot(true);
+    connect(&mEventTimer, SIGNAL(timeout()), this, SLOT(replayNextEvent()));
+}
+
+TraceReplayer::~TraceReplayer()
+{
+    delete mModel;
+    if (mStore)
+        mStore->release();
+}
+
+/*! Loads the contacts of the first snapshot into the memory backend.
+ * The replay proper starts once the store has fetched them all.
+ */
+void TraceReplayer::start()
+{
+    mStore = ContactStore::acquire();
+    connect(mStore, SIGNAL(contactsReset()), this, SLOT(onStoreActivity()));
+    connect(mStore, SIGNAL(contactsInserted(QList<QContactLocalId>)),
+            this, SLOT(onStoreActivity()));
+    connect(mStore, SIGNAL(contactsUpdated(QList<QContactLocalId>)),
+            this, SLOT(onStoreActivity()));
+    connect(mStore, SIGNAL(contactsAboutToBeRemoved(QList<QContactLocalId>)),
+            this, SLOT(onStoreActivity()));
+
+    while (mNextEvent < mEvents.size()
+           && mEvents.at(mNextEvent).type != ContactTrace::Snapshot)
+        mNextEvent++;
+
+    if (mNextEvent < mEvents.size()) {
+        const ContactTrace::Event &snapshot = mEvents.at(mNextEvent);
+        mStartTime = snapshot.time;
+        QList<QContact> contacts = snapshot.contacts;
+        for (int i = 0; i < contacts.size(); i++)
+            contacts[i].setId(QContactId());
+
+        if (!mStore->manager()->saveContacts(&contacts, 0))
+            qWarning() << Q_FUNC_INFO << "failed to load the snapshot:"
+                       << mStore->manager()->error();
+        for (int i = 0; i < contacts.size(); i++)
+            mIds.insert(snapshot.ids.at(i), contacts.at(i).localId());
+        mNextEvent++;
+    } else {
+        // no snapshot: replay everything into an empty address book
+        mNextEvent = 0;
+    }
+
+    qDebug() << "[TraceReplayer] loaded" << mIds.size() << "contacts";
+    mPhase = Loading;
+    mQuietTimer.start();
+}
+
+void TraceReplayer::onStoreActivity()
+{
+    if (mPhase != Replaying)
+        mQuietTimer.start();
+}
+
+void TraceReplayer::onQuiet()
+{
+    if (mPhase == Draining) {
+        report();
+        emit finished();
+        return;
+    }
+
+    mModel = new PeopleModel(this);
+    connect(mModel, SIGNAL(modelReset()), this, SLOT(onModelReset()));
+    connect(mModel, SIGNAL(rowsInserted(QModelIndex, int, int)),
+            this, SLOT(onRowsInserted(QModelIndex, int, int)));
+    connect(mModel, SIGNAL(rowsRemoved(QModelIndex, int, int)),
+            this, SLOT(onRowsRemoved(QModelIndex, int, int)));
+    connect(mModel, SIGNAL(dataChanged(QModelIndex, QModelIndex)),
+            this, SLOT(onDataChanged(QModelIndex, QModelIndex)));
+    connect(mModel, SIGNAL(layoutChanged()), this, SLOT(onLayoutChanged()));
+    connect(mModel, SIGNAL(localFilterChanged()), this, SLOT(onLocalFilterChanged()));
+
+    mPeakMemoryBefore = peakMemory();
+    ReplayApplication::instance()->resetBusyTime();
+    mClock.start();
+    mPhase = Replaying;
+    scheduleNextEvent();
+}
+
+/*! Waits until the next notification is due, measured from the start of
+ * the replay and scaled by the speed.
+ */
+void TraceReplayer::scheduleNextEvent()
+{
+    if (mNextEvent >= mEvents.size()) {
+        mPhase = Draining;
+        mQuietTimer.start();
+        return;
+    }
+
+    qint64 delay = 0;
+    if (mSpeed > 0) {
+        qint64 due = qint64((mEvents.at(mNextEvent).time - mStartTime) / 1000 / mSpeed);
+        delay = qMax(qint64(0), due - mClock.elapsed());
+    }
+    mEventTimer.start(int(delay));
+}
+
+void TraceReplayer::replayNextEvent()
+{
+    const ContactTrace::Event &event = mEvents.at(mNextEvent);
+
+    QElapsedTimer timer;
+    timer.start();
+    switch (event.type) {
+    case ContactTrace::ContactsAdded:
+        addContacts(mNextEvent);
+        break;
+    case ContactTrace::ContactsChanged:
+        changeContacts(mNextEvent);
+        break;
+    case ContactTrace::ContactsRemoved:
+        removeContacts(mNextEvent);
+        break;
+    case ContactTrace::DataChanged:
+        QMetaObject::invokeMethod(mStore->manager(), "dataChanged");
+        break;
+    case ContactTrace::Snapshot:
+    case ContactTrace::FetchResult:
+        // answers to the store's fetches, not notifications
+        break;
+    }
+
+    // the store's notification slots run within this, but only queue fetches
+    if (event.type != ContactTrace::Snapshot && event.type != ContactTrace::FetchResult) {
+        qint64 elapsed = timer.nsecsElapsed();
+        mInjectTime += elapsed;
+        ReplayApplication::instance()->discount(elapsed);
+        mEventCounts[eventName(event.type)]++;
+    }
+
+    mNextEvent++;
+    scheduleNextEvent();
+}
+
+/*! Returns the contacts \a ids as the store fetched them after \a event
+ * at recording time, or empty contacts if it never did.
+ */
+QList<QContact> TraceReplayer::recordedContacts(int event,
+                                                const QList<QContactLocalId> &ids) const
+{
+    QList<QContact> contacts;
+    foreach (QContactLocalId id, ids) {
+        QContact contact;
+        foreach (const QPair<int, int> &fetched, mFetched.value(id)) {
+            if (fetched.first > event) {
+                contact = mEvents.at(fetched.first).contacts.at(fetched.second);
+                break;
+            }
+        }
+        contacts << contact;
+    }
+    return contacts;
+}
+
+void TraceReplayer::addContacts(int event)
+{
+    const QList<QContactLocalId> &ids = mEvents.at(event).ids;
+    QList<QContact> contacts = recordedContacts(event, ids);
+    for (int i = 0; i < contacts.size(); i++)
+        contacts[i].setId(QContactId());
+
+    if (!mStore->manager()->saveContacts(&contacts, 0))
+        qWarning() << Q_FUNC_INFO << "failed to add contacts:" << mStore->manager()->error();
+    for (int i = 0; i < contacts.size(); i++)
+        mIds.insert(ids.at(i), contacts.at(i).localId());
+}
+
+void TraceReplayer::changeContacts(int event)
+{
+    QList<QContactLocalId> ids;
+    foreach (QContactLocalId id, mEvents.at(event).ids) {
+        if (mIds.contains(id))
+            ids << id;
+    }
+
+    QList<QContact> contacts = recordedContacts(event, ids);
+    for (int i = 0; i < contacts.size(); i++) {
+        QContactLocalId localId = mIds.value(ids.at(i));
+        // never fetched: save it unchanged, which still notifies
+        if (contacts.at(i).isEmpty())
+            contacts[i] = mStore->manager()->contact(localId);
+
+        QContactId contactId;
+        contactId.setManagerUri(mStore->manager()->managerUri());
+        contactId.setLocalId(localId);
+        contacts[i].setId(contactId);
+    }
+
+    if (!contacts.isEmpty() && !mStore->manager()->saveContacts(&contacts, 0))
+        qWarning() << Q_FUNC_INFO << "failed to change contacts:" << mStore->manager()->error();
+}
+
+void TraceReplayer::removeContacts(int event)
+{
+    QList<QContactLocalId> ids;
+    foreach (QContactLocalId id, mEvents.at(event).ids) {
+        if (mIds.contains(id))
+            ids << mIds.take(id);
+    }
+
+    if (!ids.isEmpty() && !mStore->manager()->removeContacts(ids, 0))
+        qWarning() << Q_FUNC_INFO << "failed to remove contacts:" << mStore->manager()->error();
+}
+
+void TraceReplayer::onModelReset()
+{
+    mSignalCounts["modelReset"]++;
+}
+
+void TraceReplayer::onRowsInserted(const QModelIndex &, int first, int last)
+{
+    mSignalCounts["rowsInserted"]++;
+    mRowsInserted += last - first + 1;
+}
+
+void TraceReplayer::onRowsRemoved(const QModelIndex &, int first, int last)
+{
+    mSignalCounts["rowsRemoved"]++;
+    mRowsRemoved += last - first + 1;
+}
+
+void TraceReplayer::onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    mSignalCounts["dataChanged"]++;
+    mRowsChanged += bottomRight.row() - topLeft.row() + 1;
+}
+
+void TraceReplayer::onLayoutChanged()
+{
+    mSignalCounts["layoutChanged"]++;
+}
+
+void TraceReplayer::onLocalFilterChanged()
+{
+    mSignalCounts["localFilterChanged"]++;
+}
+
+void TraceReplayer::report()
+{
+    ReplayApplication *app = ReplayApplication::instance();
+    QTextStream out(stdout);
+
+    out << "replayed in " << mClock.elapsed() << " ms at speed " << mSpeed << "\n";
+    out << "notifications:\n";
+    for (QMap<QString, int>::const_iterator it = mEventCounts.constBegin();
+         it != mEventCounts.constEnd(); ++it)
+        out << "  " << it.key() << ": " << it.value() << "\n";
+
+    out << "model signals:\n";
+    for (QMap<QString, int>::const_iterator it = mSignalCounts.constBegin();
+         it != mSignalCounts.constEnd(); ++it)
+        out << "  " << it.key() << ": " << it.value() << "\n";
+    out << "  rows inserted " << mRowsInserted << ", removed " << mRowsRemoved
+        << ", changed " << mRowsChanged << "\n";
+
+    out << "rows: " << mModel->rowCount() << "\n";
+    out << "GUI busy: " << app->busyTime() / 1000000 << " ms, longest event "
+        << app->longestEvent() / 1000000 << " ms\n";
+    out << "injecting into the backend: " << mInjectTime / 1000000 << " ms\n";
+    out << "store memory: " << mStore->memoryUsage() << " bytes\n";
+    out << "peak memory: " << mPeakMemoryBefore << " kB before, "
+        << peakMemory() << " kB after\n";
+}
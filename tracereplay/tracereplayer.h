@@ -0,0 +1,107 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef TRACEREPLAYER_H
+#define TRACEREPLAYER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMap>
+#include <QPair>
+#include <QTimer>
+#include <QModelIndex>
+
+#include "contacttrace.h"
+
+class ContactStore;
+class PeopleModel;
+
+/*! Feeds a ContactTrace into a PeopleModel on the memory backend.
+ *
+ * The contacts of the first snapshot are loaded first. The notifications
+ * that follow are then reproduced as real changes to the memory backend,
+ * using the contacts the store fetched in response at recording time,
+ * so the store sees the same bursts of contactsAdded, contactsChanged,
+ * contactsRemoved and dataChanged as on the device. Events are spaced as
+ * recorded, divided by the speed; a speed of 0 replays without pauses.
+ *
+ * Once the store has been quiet for a while, the replay reports the
+ * signals the model emitted, the time the GUI thread was busy, the
+ * longest single event and the peak memory of the process.
+ */
+class TraceReplayer: public QObject
+{
+    Q_OBJECT
+
+public:
+    TraceReplayer(const QList<ContactTrace::Event> &events, double speed, QObject *parent = 0);
+    virtual ~TraceReplayer();
+
+    void start();
+
+signals:
+    void finished();
+
+private slots:
+    void replayNextEvent();
+    void onStoreActivity();
+    void onQuiet();
+
+    void onModelReset();
+    void onRowsInserted(const QModelIndex &parent, int first, int last);
+    void onRowsRemoved(const QModelIndex &parent, int first, int last);
+    void onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+    void onLayoutChanged();
+    void onLocalFilterChanged();
+
+private:
+    enum Phase {
+        Loading,
+        Replaying,
+        Draining
+    };
+
+    QList<QContact> recordedContacts(int event, const QList<QContactLocalId> &ids) const;
+    void addContacts(int event);
+    void changeContacts(int event);
+    void removeContacts(int event);
+    void scheduleNextEvent();
+    void report();
+
+    QList<ContactTrace::Event> mEvents;
+    double mSpeed;
+    Phase mPhase;
+    int mNextEvent;
+    // trace time the replay clock starts from, in microseconds
+    qint64 mStartTime;
+
+    ContactStore *mStore;
+    PeopleModel *mModel;
+
+    // recorded contact id to the id the memory backend gave it
+    QHash<QContactLocalId, QContactLocalId> mIds;
+    // where each recorded contact was fetched: event and position
+    QHash<QContactLocalId, QList<QPair<int, int> > > mFetched;
+
+    QTimer mEventTimer;
+    QTimer mQuietTimer;
+    QElapsedTimer mClock;
+    qint64 mInjectTime;
+
+    QMap<QString, int> mEventCounts;
+    QMap<QString, int> mSignalCounts;
+    int mRowsInserted;
+    int mRowsRemoved;
+    int mRowsChanged;
+    int mPeakMemoryBefore;
+
+    Q_DISABLE_COPY(TraceReplayer);
+};
+
+#endif // TRACEREPLAYER_H
@@ -0,0 +1,289 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QDebug>
+
+#include <QFileInfo>
+#include <QUuid>
+#include <QtConcurrentRun>
+#include <QContactGuid>
+#include <QVersitContactImporter>
+
+#include "vcardimporter.h"
+#include "contactstore.h"
+
+// number of files and payloads waiting to be parsed
+static const int MaxQueuedJobs = 64;
+// bytes of vCard data waiting to be parsed
+static const qint64 MaxQueuedBytes = 4 * 1024 * 1024;
+// contacts parsed or being saved, but not saved yet
+static const int MaxUnsavedContacts = 1000;
+// contacts saved by a single request
+static const int MaxSaveBatch = 100;
+// parsed contacts wait this long for more before they are saved
+static const int SaveDelayMs = 500;
+
+// runs in a worker thread
+static QList<QContact> convertDocuments(QList<QVersitDocument> documents)
+{
+    QVersitContactImporter importer;
+    if (!importer.importDocuments(documents))
+        qWarning() << Q_FUNC_INFO << "some vCards could not be converted";
+
+    QList<QContact> contacts = importer.contacts();
+    for (int i = 0; i < contacts.size(); i++) {
+        // the models find contacts by guid
+        QContactGuid guid = contacts.at(i).detail<QContactGuid>();
+        if (guid.guid().isEmpty()) {
+            guid.setGuid(QUuid::createUuid().toString());
+            contacts[i].saveDetail(&guid);
+        }
+    }
+    return contacts;
+}
+
+VCardImporter::VCardImporter(ContactStore *store, QObject *parent)
+    : QObject(parent), mStore(store), mQueuedBytes(0), mFile(0), mConverting(false),
+      mSaving(0)
+{
+    connect(&mReader, SIGNAL(stateChanged(QVersitReader::State)),
+            this, SLOT(onReaderStateChanged(QVersitReader::State)));
+    connect(&mConverter, SIGNAL(finished()), this, SLOT(onDocumentsConverted()));
+
+    mSaveTimer.setSingleShot(true);
+    mSaveTimer.setInterval(SaveDelayMs);
+    connect(&mSaveTimer, SIGNAL(timeout()), this, SLOT(flushContacts()));
+}
+
+VCardImporter::~VCardImporter()
+{
+    if (mReader.state() == QVersitReader::ActiveState) {
+        mReader.cancel();
+        mReader.waitForFinished();
+    }
+    delete mFile;
+
+    if (mConverting) {
+        mConverter.waitForFinished();
+        mPendingContacts << mConverter.result();
+    }
+    if (mSaveRequest)
+        mSaveRequest->waitForFinished();
+
+    // whatever was parsed already is not lost; the store sees it saved
+    for (int i = 0; i < mPendingContacts.size(); i += MaxSaveBatch)
+        mStore->saveContacts(mPendingContacts.mid(i, MaxSaveBatch));
+}
+
+/*! Queues the vCard file \a fileName. Returns false if the queue is full.
+ */
+bool VCardImporter::importFile(const QString &fileName)
+{
+    QFileInfo info(fileName);
+    if (!info.isFile() || !info.isReadable()) {
+        qWarning() << Q_FUNC_INFO << "cannot read" << fileName;
+        return false;
+    }
+
+    Job job;
+    job.fileName = fileName;
+    job.bytes = info.size();
+    return enqueue(job);
+}
+
+/*! Queues the vCards in \a data. Returns false if the queue is full.
+ */
+bool VCardImporter::importData(const QByteArray &data)
+{
+    if (data.isEmpty())
+        return false;
+
+    Job job;
+    job.data = data;
+    job.bytes = data.size();
+    return enqueue(job);
+}
+
+bool VCardImporter::isFull() const
+{
+    return mJobs.size() >= MaxQueuedJobs || mQueuedBytes >= MaxQueuedBytes
+            || unsavedCount() >= MaxUnsavedContacts;
+}
+
+int VCardImporter::unsavedCount() const
+{
+    return mPendingContacts.size() + mSaving;
+}
+
+int VCardImporter::queueLength() const
+{
+    return mJobs.size();
+}
+
+bool VCardImporter::enqueue(const Job &job)
+{
+    // a single oversized job is still taken when nothing else is waiting
+    if (isFull() || (!mJobs.isEmpty() && mQueuedBytes + job.bytes > MaxQueuedBytes)) {
+        qDebug() << Q_FUNC_INFO << "queue full, refusing" << job.bytes << "bytes";
+        return false;
+    }
+
+    mJobs.enqueue(job);
+    mQueuedBytes += job.bytes;
+    startNextJob();
+    return true;
+}
+
+/*! Hands the job at the head of the queue to the reader, unless it is
+ * busy or the contacts of the previous job are still being converted.
+ * The job stays queued until its contacts are ready to be saved.
+ */
+void VCardImporter::startNextJob()
+{
+    while (!mJobs.isEmpty() && mReader.state() != QVersitReader::ActiveState
+           && !mConverting && unsavedCount() < MaxUnsavedContacts) {
+        const Job &job = mJobs.head();
+
+        if (job.fileName.isEmpty()) {
+            mReader.setData(job.data);
+        } else {
+            mFile = new QFile(job.fileName);
+            if (!mFile->open(QIODevice::ReadOnly)) {
+                qWarning() << Q_FUNC_INFO << "failed to open" << job.fileName;
+                delete mFile;
+                mFile = 0;
+                mQueuedBytes -= mJobs.dequeue().bytes;
+                continue;
+            }
+            mReader.setDevice(mFile);
+        }
+
+        if (!mReader.startReading()) {
+            qWarning() << Q_FUNC_INFO << "failed to start reading:" << mReader.error();
+            delete mFile;
+            mFile = 0;
+            mQueuedBytes -= mJobs.dequeue().bytes;
+        }
+    }
+}
+
+void VCardImporter::onReaderStateChanged(QVersitReader::State state)
+{
+    if (state != QVersitReader::FinishedState && state != QVersitReader::CanceledState)
+        return;
+
+    if (mReader.error() != QVersitReader::NoError)
+        qWarning() << Q_FUNC_INFO << "vCard parsing failed:" << mReader.error();
+
+    delete mFile;
+    mFile = 0;
+
+    QList<QVersitDocument> documents = mReader.results();
+    if (state == QVersitReader::FinishedState && !documents.isEmpty()) {
+        mConverting = true;
+        mConverter.setFuture(QtConcurrent::run(convertDocuments, documents));
+        return;
+    }
+    finishJob();
+}
+
+void VCardImporter::onDocumentsConverted()
+{
+    mConverting = false;
+    mPendingContacts << mConverter.result();
+    finishJob();
+}
+
+/*! Drops the job at the head of the queue, whose contacts are now
+ * waiting to be saved, and moves on to the next one.
+ */
+void VCardImporter::finishJob()
+{
+    bool wasFull = isFull();
+    if (!mJobs.isEmpty())
+        mQueuedBytes -= mJobs.dequeue().bytes;
+
+    if (mPendingContacts.size() >= MaxSaveBatch)
+        flushContacts();
+    else if (!mPendingContacts.isEmpty() && !mSaveTimer.isActive())
+        mSaveTimer.start();
+
+    if (wasFull && !isFull())
+        emit queueAvailable();
+
+    startNextJob();
+}
+
+/*! Saves up to MaxSaveBatch of the contacts parsed so far. The rest
+ * follow as each request finishes, so the backend has one request from
+ * the importer at a time.
+ */
+void VCardImporter::flushContacts()
+{
+    mSaveTimer.stop();
+    if (mPendingContacts.isEmpty() || mSaveRequest)
+        return;
+
+    QList<QContact> contacts = mPendingContacts.mid(0, MaxSaveBatch);
+    qDebug() << Q_FUNC_INFO << "saving" << contacts.size() << "of"
+             << mPendingContacts.size() << "imported contacts";
+
+    QContactSaveRequest *saveRequest = new QContactSaveRequest(this);
+    saveRequest->setManager(mStore->manager());
+    saveRequest->setContacts(contacts);
+    connect(saveRequest, SIGNAL(stateChanged(QContactAbstractRequest::State)),
+            this, SLOT(onSaveStateChanged(QContactAbstractRequest::State)));
+
+    bool wasFull = isFull();
+    mPendingContacts = mPendingContacts.mid(contacts.size());
+    if (!saveRequest->start()) {
+        qWarning() << Q_FUNC_INFO << "Save request failed: " << saveRequest->error()
+                   << "dropping" << contacts.size() << "imported contacts";
+        delete saveRequest;
+        if (!mPendingContacts.isEmpty())
+            mSaveTimer.start();
+        if (wasFull && !isFull())
+            emit queueAvailable();
+        return;
+    }
+
+    mSaveRequest = saveRequest;
+    mSaving = contacts.size();
+}
+
+void VCardImporter::onSaveStateChanged(QContactAbstractRequest::State requestState)
+{
+    QContactSaveRequest *saveRequest = qobject_cast<QContactSaveRequest *>(sender());
+    if (!saveRequest || (requestState != QContactAbstractRequest::FinishedState
+                         && requestState != QContactAbstractRequest::CanceledState))
+        return;
+
+    saveRequest->deleteLater();
+    if (saveRequest != mSaveRequest)
+        return;
+
+    if (saveRequest->error() != QContactManager::NoError)
+        qWarning() << Q_FUNC_INFO << "Error" << saveRequest->error() << "saving"
+                   << saveRequest->errorMap().size() << "of" << mSaving << "imported contacts";
+
+    bool wasFull = isFull();
+    int saved = mSaving;
+    mSaveRequest = 0;
+    mSaving = 0;
+    emit imported(saved);
+
+    if (mPendingContacts.size() >= MaxSaveBatch)
+        flushContacts();
+    else if (!mPendingContacts.isEmpty() && !mSaveTimer.isActive())
+        mSaveTimer.start();
+
+    if (wasFull && !isFull())
+        emit queueAvailable();
+
+    startNextJob();
+}
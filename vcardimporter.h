@@ -0,0 +1,93 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef VCARDIMPORTER_H
+#define VCARDIMPORTER_H
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QPointer>
+#include <QQueue>
+#include <QTimer>
+#include <QFile>
+#include <QVersitReader>
+#include <QContact>
+#include <QContactSaveRequest>
+
+QTM_USE_NAMESPACE
+
+class ContactStore;
+
+/*! Imports vCards received from other applications into a ContactStore.
+ *
+ * Files and in-memory payloads are queued and parsed one after another
+ * by QVersitReader, which reads in a thread of its own; the documents
+ * are then turned into contacts in a worker thread as well. The contacts
+ * are collected and saved in batches, one request at a time, so a burst
+ * of incoming cards costs a few backend writes rather than one per card.
+ *
+ * The queue is bounded, counting both the input waiting to be parsed and
+ * the contacts not saved yet: while it is full, importFile() and
+ * importData() refuse new work and the caller is expected to retry once
+ * queueAvailable() is emitted.
+ */
+class VCardImporter: public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit VCardImporter(ContactStore *store, QObject *parent = 0);
+    virtual ~VCardImporter();
+
+    bool importFile(const QString &fileName);
+    bool importData(const QByteArray &data);
+
+    bool isFull() const;
+    int queueLength() const;
+
+signals:
+    void queueAvailable();
+    void imported(int count);
+
+private slots:
+    void onReaderStateChanged(QVersitReader::State state);
+    void onDocumentsConverted();
+    void onSaveStateChanged(QContactAbstractRequest::State requestState);
+    void flushContacts();
+
+private:
+    struct Job
+    {
+        QString fileName;
+        QByteArray data;
+        qint64 bytes;
+    };
+
+    bool enqueue(const Job &job);
+    void startNextJob();
+    void finishJob();
+    int unsavedCount() const;
+
+    ContactStore *mStore;
+    QQueue<Job> mJobs;
+    qint64 mQueuedBytes;
+    QVersitReader mReader;
+    QFile *mFile;
+    QFutureWatcher<QList<QContact> > mConverter;
+    bool mConverting;
+
+    // parsed and waiting to be saved, and being saved
+    QList<QContact> mPendingContacts;
+    QPointer<QContactSaveRequest> mSaveRequest;
+    int mSaving;
+    QTimer mSaveTimer;
+
+    Q_DISABLE_COPY(VCardImporter);
+};
+
+#endif // VCARDIMPORTER_H